@@ -0,0 +1,49 @@
+/**
+ * \file flag_handle.c
+ *
+ * \brief Flags looked up once, for checks in hot paths.
+ *
+ * See flag_handle.h.
+ */
+
+#include "copyrite.h"
+#include "flag_handle.h"
+
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "flags.h"
+
+/** Handles looked up with a different number than this are stale.
+ * Starts at 1 so a handle that's never been looked up is stale too. */
+unsigned int flag_handle_gen = 1;
+
+/** Look up a flag handle's bit.
+ * This is called by Has_Flag_Handle() when it needs to be, and finds the
+ * flag the same way has_flag_by_name() does.
+ * \param h the handle.
+ * \return 1, always, so it can be used in the macro.
+ */
+int
+flag_handle_resolve(FLAG_HANDLE *h)
+{
+  FLAG *f;
+
+  f = match_flag(h->name);
+  if (f && !(f->perms & F_DISABLED) && (f->type & h->type))
+    h->bitpos = f->bitpos;
+  else
+    h->bitpos = -1;
+  h->gen = flag_handle_gen;
+  return 1;
+}
+
+/** Make every flag handle be looked up again.
+ * Call after @flag changes the flag table.
+ */
+void
+flag_handles_reset(void)
+{
+  if (++flag_handle_gen == 0)
+    flag_handle_gen = 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * \file flag_handle.h
+ *
+ * \brief Flags looked up once, for checks in hot paths.
+ *
+ * \verbatim
+ * has_flag_by_name() looks the flag up in the flag table every time it's
+ * called. A FLAG_HANDLE remembers the flag's bit the first time it's
+ * used, and after that checking it is a bit test:
+ *
+ *  static FLAG_HANDLE generic_flag = FLAG_HANDLE_INIT("GENERIC", TYPE_THING);
+ *  ...
+ *  if (Has_Flag_Handle(thing, &generic_flag)) ...
+ *
+ * which is the same as has_flag_by_name(thing, "GENERIC", TYPE_THING).
+ * Handles are looked up again after flag_handles_reset(), which must be
+ * called whenever @flag adds, deletes, renames or disables a flag.
+ * \endverbatim
+ */
+
+#ifndef __FLAG_HANDLE_H
+#define __FLAG_HANDLE_H
+
+#include "conf.h"
+#include "dbdefs.h"
+
+/** A flag, looked up when first used */
+typedef struct flag_handle {
+  const char *name;   /**< Name of the flag */
+  int type;           /**< Types it has to apply to, as for has_flag_by_name() */
+  int bitpos;         /**< Its bit, or -1 if there's no such flag */
+  unsigned int gen;   /**< flag_handle_gen when it was looked up */
+} FLAG_HANDLE;
+
+#define FLAG_HANDLE_INIT(name, type) { (name), (type), -1, 0 }
+
+/** Does thing have the flag? */
+#define Has_Flag_Handle(thing, h) \
+  ((((h)->gen == flag_handle_gen) || flag_handle_resolve(h)) && \
+   (h)->bitpos >= 0 && has_bit(Flags(thing), (h)->bitpos))
+
+extern unsigned int flag_handle_gen;
+
+extern int flag_handle_resolve(FLAG_HANDLE *h);
+extern void flag_handles_reset(void);
+
+#endif                          /* __FLAG_HANDLE_H */
@@ -0,0 +1,626 @@
+/**
+ * \file generic.c
+ *
+ * \brief Stacks of GENERIC objects held by containers.
+ *
+ * \verbatim
+ * Each container's GENERIC`#<dbref> attributes are read once into a table
+ * of prototype -> count, and from then on the table is used for lookups
+ * and updates, with the attributes written through so they're saved with
+ * the db. Stacks are handed out in the order atr_iter_get_parent() would
+ * visit their attributes: the container's own in attribute name order,
+ * then each parent's that aren't no_inherit or hidden by a child's.
+ *
+ * Working that out means a walk up the parent chain, so each table also
+ * caches the flattened list of stacks its container ends up with. Every
+ * change to a table gives it a new generation number; the flattened list
+ * remembers the chain it was made from and each table's generation, and
+ * is thrown away when any of them changes, or any parent does. Each
+ * flattened list gets a generation number of its own, which is what
+ * generic_generation() hands the match cache.
+ *
+ *  generic_count(container, proto)        - items in a stack, inherited
+ *                                           stacks included
+ *  generic_set(container, proto, count)   - set the container's own stack
+ *  generic_adjust(container, proto, delta) - add to or take from it
+ *  generic_iter(container, inherit, func, data) - visit each stack
+ * \endverbatim
+ */
+
+#include "copyrite.h"
+#include "generic.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "attrib.h"
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "flag_handle.h"
+#include "flags.h"
+#include "function.h"
+#include "intmap.h"
+#include "match.h"
+#include "match_index.h"
+#include "mushdb.h"
+#include "mymalloc.h"
+#include "parse.h"
+#include "strutil.h"
+
+/* One stack of items */
+struct gstack {
+  dbref proto;   /* prototype object */
+  int count;     /* number of items */
+  int inherit;   /* 0 if the attribute is no_inherit */
+  int slot;      /* where we are in gtable->stacks */
+};
+
+/* All the stacks a container holds itself */
+struct gtable {
+  dbref container;
+  int count;               /* stacks in use */
+  int size;                /* stacks allocated */
+  int sorted;              /* stacks are in attribute name order */
+  struct gstack **stacks;
+  intmap *protos;          /* proto -> struct gstack */
+  unsigned int gen;        /* changes whenever the stacks do */
+  struct gflat *flat;      /* cached flattened stacks, or NULL */
+};
+
+/* A stack as seen by generic_iter() */
+struct gview {
+  dbref proto;
+  int count;
+};
+
+/* The stacks a container ends up with, parents included */
+struct gflat {
+  int depth;                          /* length of the parent chain */
+  dbref chain[MAX_PARENTS + 1];       /* the chain, container first */
+  unsigned int gens[MAX_PARENTS + 1]; /* generation of each table */
+  dbref end;                          /* what came after the chain */
+  unsigned int gen;                   /* new for each flattening */
+  int refs;                           /* generic_iter()s using this */
+  int orphan;                         /* free when refs drops to 0 */
+  int count;
+  struct gview *view;
+};
+
+static intmap *gtables = NULL;
+static int generic_writing = 0;
+static unsigned int generic_gen = 0;
+static FLAG_HANDLE generic_flag = FLAG_HANDLE_INIT("GENERIC", TYPE_THING);
+
+static int generic_load_helper(dbref player, dbref thing, dbref parent,
+                               char const *pattern, ATTR *atr, void *args);
+static struct gtable *gtable_get(dbref container);
+static void gtable_put(struct gtable *t, dbref proto, int count, int inherit);
+static void gtable_del(struct gtable *t, dbref proto);
+static void gtable_drop(struct gtable *t);
+static int gstack_cmp(const void *a, const void *b);
+static void gtable_sort(struct gtable *t);
+static int gtable_shows(struct gtable *t, dbref proto, int level);
+static void gflat_release(struct gflat *f);
+static int gflat_valid(struct gflat *f);
+static struct gflat *gflat_build(dbref container);
+static struct gflat *gflat_get(dbref container);
+static int generic_list_helper(dbref container, dbref proto, int count,
+                               void *data);
+
+static int
+generic_load_helper(dbref player __attribute__ ((__unused__)),
+                    dbref thing __attribute__ ((__unused__)),
+                    dbref parent __attribute__ ((__unused__)),
+                    char const *pattern __attribute__ ((__unused__)),
+                    ATTR *atr, void *args)
+{
+  struct gtable *t = args;
+  const char *p;
+  dbref proto;
+
+  p = strchr(AL_NAME(atr), '`');
+  if (!p)
+    return 0;
+  /* Only the name generic_set() would write: one attribute per stack,
+     and stacks sort the way their attributes do. */
+  proto = parse_dbref(p + 1);
+  if (!GoodObject(proto) || strcmp(p + 1, unparse_dbref(proto)))
+    return 0;
+  gtable_put(t, proto, parse_integer(atr_value(atr)),
+             !(AL_FLAGS(atr) & AF_PRIVATE));
+  return 1;
+}
+
+/* Get a container's table, reading it from its attributes if needed */
+static struct gtable *
+gtable_get(dbref container)
+{
+  struct gtable *t;
+
+  if (!gtables)
+    gtables = im_new();
+  t = im_find(gtables, container);
+  if (t)
+    return t;
+
+  t = mush_malloc(sizeof(struct gtable), "generic.table");
+  t->container = container;
+  t->count = 0;
+  t->size = 0;
+  t->sorted = 1;
+  t->stacks = NULL;
+  t->protos = im_new();
+  t->gen = ++generic_gen;
+  t->flat = NULL;
+  im_insert(gtables, container, t);
+  atr_iter_get(GOD, container, GENERIC_ATTR "*", 0, 0, generic_load_helper,
+               t);
+  return t;
+}
+
+static void
+gtable_put(struct gtable *t, dbref proto, int count, int inherit)
+{
+  struct gstack *s;
+
+  t->gen = ++generic_gen;
+  s = im_find(t->protos, proto);
+  if (s) {
+    s->count = count;
+    s->inherit = inherit;
+    return;
+  }
+
+  s = mush_malloc(sizeof(struct gstack), "generic.stack");
+  s->proto = proto;
+  s->count = count;
+  s->inherit = inherit;
+  if (t->count == t->size) {
+    t->size = t->size ? t->size * 2 : 8;
+    t->stacks = mush_realloc(t->stacks, t->size * sizeof(struct gstack *),
+                             "generic.stacks");
+  }
+  s->slot = t->count;
+  t->stacks[t->count++] = s;
+  t->sorted = 0;
+  im_insert(t->protos, proto, s);
+}
+
+static void
+gtable_del(struct gtable *t, dbref proto)
+{
+  struct gstack *s;
+
+  s = im_find(t->protos, proto);
+  if (!s)
+    return;
+  t->gen = ++generic_gen;
+  im_delete(t->protos, proto);
+  t->stacks[s->slot] = t->stacks[--t->count];
+  t->stacks[s->slot]->slot = s->slot;
+  t->sorted = 0;
+  mush_free(s, "generic.stack");
+}
+
+static void
+gtable_drop(struct gtable *t)
+{
+  int i;
+
+  generic_gen++;
+  im_delete(gtables, t->container);
+  if (t->flat)
+    gflat_release(t->flat);
+  for (i = 0; i < t->count; i++)
+    mush_free(t->stacks[i], "generic.stack");
+  if (t->stacks)
+    mush_free(t->stacks, "generic.stacks");
+  im_destroy(t->protos);
+  mush_free(t, "generic.table");
+}
+
+/* Attribute name order of GENERIC`#<proto>, which is what
+   generic_load_helper() takes and generic_set() writes */
+static int
+gstack_cmp(const void *a, const void *b)
+{
+  const struct gstack *sa = *(struct gstack * const *) a;
+  const struct gstack *sb = *(struct gstack * const *) b;
+  char na[32], nb[32];
+
+  snprintf(na, sizeof na, "#%d", sa->proto);
+  snprintf(nb, sizeof nb, "#%d", sb->proto);
+  return strcmp(na, nb);
+}
+
+static void
+gtable_sort(struct gtable *t)
+{
+  int i;
+
+  if (t->sorted)
+    return;
+  qsort(t->stacks, t->count, sizeof(struct gstack *), gstack_cmp);
+  for (i = 0; i < t->count; i++)
+    t->stacks[i]->slot = i;
+  t->sorted = 1;
+}
+
+/* Does the table at this level of the parent chain show a stack of
+ * proto to its children? */
+static int
+gtable_shows(struct gtable *t, dbref proto, int level)
+{
+  struct gstack *s = im_find(t->protos, proto);
+
+  return s && (!level || s->inherit);
+}
+
+/** Count the items in a container's stack of a prototype.
+ * \param container container to look in.
+ * \param proto prototype of the stack.
+ * \return number of items, including inherited ones.
+ */
+int
+generic_count(dbref container, dbref proto)
+{
+  struct gstack *s;
+  dbref p;
+  int level = 0;
+
+  for (p = container; GoodObject(p) && level <= MAX_PARENTS;
+       p = Parent(p), level++) {
+    s = im_find(gtable_get(p)->protos, proto);
+    if (s && (!level || s->inherit))
+      return s->count > 0 ? s->count : 0;
+  }
+  return 0;
+}
+
+/** Set the number of items in a container's own stack of a prototype.
+ * The GENERIC` attribute is updated to match; a count of 0 or less
+ * removes the stack.
+ * \param container container to change.
+ * \param proto prototype of the stack.
+ * \param count new number of items.
+ * \return the new count, or GENERIC_ERR_SET if the attribute couldn't be
+ *  set or cleared; the stack is left as it was.
+ */
+int
+generic_set(dbref container, dbref proto, int count)
+{
+  char atr[BUFFER_LEN];
+  char *bp;
+  struct gtable *t;
+  struct gstack *s;
+
+  if (!RealGoodObject(container) || !GoodObject(proto))
+    return GENERIC_ERR_SET;
+
+  bp = atr;
+  safe_str(GENERIC_ATTR, atr, &bp);
+  safe_dbref(proto, atr, &bp);
+  *bp = '\0';
+
+  t = gtable_get(container);
+  generic_writing = 1;
+  if (count <= 0) {
+    /* The stack is only dropped once its attribute has gone; there's
+       nothing to clear if it was never set. */
+    if (atr_get_noparent(container, atr) &&
+        atr_clr(container, atr, GOD) != AE_OKAY) {
+      count = GENERIC_ERR_SET;
+    } else {
+      gtable_del(t, proto);
+      count = 0;
+    }
+  } else if (atr_add(container, atr, unparse_integer(count), GOD, 0) !=
+             AE_OKAY) {
+    count = GENERIC_ERR_SET;
+  } else {
+    s = im_find(t->protos, proto);
+    gtable_put(t, proto, count, s ? s->inherit : 1);
+  }
+  generic_writing = 0;
+  return count;
+}
+
+/** Add items to, or take them from, a container's own stack.
+ * \param container container to change.
+ * \param proto prototype of the stack.
+ * \param delta number of items to add, or to take if negative.
+ * \return the new count, GENERIC_ERR_SHORT if there weren't enough items
+ *  to take, GENERIC_ERR_FULL if the count would be more than an int
+ *  holds, or GENERIC_ERR_SET if the attribute couldn't be set or cleared.
+ */
+int
+generic_adjust(dbref container, dbref proto, int delta)
+{
+  struct gstack *s;
+  int count = 0;
+
+  if (!RealGoodObject(container) || !GoodObject(proto))
+    return GENERIC_ERR_SET;
+  s = im_find(gtable_get(container)->protos, proto);
+  if (s && s->count > 0)
+    count = s->count;
+  if (delta > 0 && count > INT_MAX - delta)
+    return GENERIC_ERR_FULL;
+  if (count + delta < 0)
+    return GENERIC_ERR_SHORT;
+  return generic_set(container, proto, count + delta);
+}
+
+/* Let go of a flattened list; it's freed once no generic_iter() is
+ * still walking it */
+static void
+gflat_release(struct gflat *f)
+{
+  if (f->refs) {
+    f->orphan = 1;
+    return;
+  }
+  if (f->view)
+    mush_free(f->view, "generic.view");
+  mush_free(f, "generic.flat");
+}
+
+/* Is a flattened list still what its container would get? */
+static int
+gflat_valid(struct gflat *f)
+{
+  dbref p = f->chain[0];
+  int level;
+
+  for (level = 0; level < f->depth; level++, p = Parent(p)) {
+    if (p != f->chain[level] || gtable_get(p)->gen != f->gens[level])
+      return 0;
+  }
+  return p == f->end;
+}
+
+static struct gflat *
+gflat_build(dbref container)
+{
+  struct gtable *tabs[MAX_PARENTS + 1];
+  struct gflat *f;
+  struct gstack *s;
+  dbref p;
+  int total = 0, level, i, j;
+
+  f = mush_malloc(sizeof(struct gflat), "generic.flat");
+  f->gen = ++generic_gen;
+  f->depth = 0;
+  f->refs = 0;
+  f->orphan = 0;
+  f->count = 0;
+  f->view = NULL;
+  for (p = container; GoodObject(p) && f->depth <= MAX_PARENTS;
+       p = Parent(p)) {
+    tabs[f->depth] = gtable_get(p);
+    gtable_sort(tabs[f->depth]);
+    total += tabs[f->depth]->count;
+    f->chain[f->depth] = p;
+    f->gens[f->depth] = tabs[f->depth]->gen;
+    f->depth++;
+  }
+  f->end = p;
+  if (total)
+    f->view = mush_malloc(total * sizeof(struct gview), "generic.view");
+
+  for (level = 0; level < f->depth; level++) {
+    for (i = 0; i < tabs[level]->count; i++) {
+      s = tabs[level]->stacks[i];
+      if (level && !s->inherit)
+        continue;
+      for (j = 0; j < level; j++) {
+        if (gtable_shows(tabs[j], s->proto, j))
+          break;
+      }
+      if (j < level)
+        continue;
+      f->view[f->count].proto = s->proto;
+      f->view[f->count].count = s->count;
+      f->count++;
+    }
+  }
+  return f;
+}
+
+/* Get the flattened stacks of a container, rebuilding them if anything
+ * in its parent chain has changed */
+static struct gflat *
+gflat_get(dbref container)
+{
+  struct gtable *t = gtable_get(container);
+
+  if (t->flat && !gflat_valid(t->flat)) {
+    gflat_release(t->flat);
+    t->flat = NULL;
+  }
+  if (!t->flat)
+    t->flat = gflat_build(container);
+  return t->flat;
+}
+
+/** Visit each stack a container holds.
+ * Stacks are visited in the order atr_iter_get_parent() would visit
+ * their attributes. func may safely change stacks as it goes; it sees
+ * them as they were when the iteration began.
+ * \param container container whose stacks to visit.
+ * \param inherit true to include stacks inherited from parents.
+ * \param func function to call for each stack.
+ * \param data passed on to func.
+ * \return 1 if func stopped the iteration, 0 otherwise.
+ */
+int
+generic_iter(dbref container, int inherit, generic_func func, void *data)
+{
+  struct gflat *f;
+  int i, n, ret = 0;
+
+  if (!GoodObject(container))
+    return 0;
+  f = gflat_get(container);
+  /* The container's own stacks come first */
+  n = inherit ? f->count : gtable_get(container)->count;
+
+  f->refs++;
+  for (i = 0; i < n; i++) {
+    if (func(container, f->view[i].proto, f->view[i].count, data)) {
+      ret = 1;
+      break;
+    }
+  }
+  if (!--f->refs && f->orphan)
+    gflat_release(f);
+  return ret;
+}
+
+/** Get a container's generic generation number.
+ * This changes whenever the stacks the container ends up with might
+ * have: when its own or any parent's stacks change, or its parent chain
+ * does. Other containers' changes leave it alone.
+ * \param container the container.
+ * \return the generation number, or 0 for garbage.
+ */
+unsigned int
+generic_generation(dbref container)
+{
+  if (!RealGoodObject(container))
+    return 0;
+  return gflat_get(container)->gen;
+}
+
+/** Tell the table a container's GENERIC` attributes were changed
+ * directly. It'll be read again next time it's needed.
+ * \param container container whose attributes changed.
+ */
+void
+generic_attr_changed(dbref container)
+{
+  struct gtable *t;
+
+  if (generic_writing || !gtables || !(t = im_find(gtables, container)))
+    return;
+  gtable_drop(t);
+}
+
+/** Forget about an object that's being recycled.
+ * \param thing object being destroyed.
+ */
+void
+generic_destroyed(dbref thing)
+{
+  struct gtable *t;
+
+  if (gtables && (t = im_find(gtables, thing)))
+    gtable_drop(t);
+}
+
+struct generic_list {
+  char *buff;
+  char **bp;
+  int first;
+};
+
+static int
+generic_list_helper(dbref container __attribute__ ((__unused__)),
+                    dbref proto, int count, void *data)
+{
+  struct generic_list *gl = data;
+
+  if (count <= 0)
+    return 0;
+  if (!gl->first)
+    safe_chr(' ', gl->buff, gl->bp);
+  gl->first = 0;
+  safe_dbref(proto, gl->buff, gl->bp);
+  safe_chr(':', gl->buff, gl->bp);
+  safe_integer(count, gl->buff, gl->bp);
+  return 0;
+}
+
+/* generic(<container>[, <prototype>]) */
+FUNCTION(fun_generic)
+{
+  struct generic_list gl;
+  dbref container, proto;
+
+  container = match_thing(executor, args[0]);
+  if (!GoodObject(container)) {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!Can_Examine(executor, container)) {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+
+  if (nargs == 1) {
+    gl.buff = buff;
+    gl.bp = bp;
+    gl.first = 1;
+    generic_iter(container, 1, generic_list_helper, &gl);
+    return;
+  }
+
+  proto = match_thing(executor, args[1]);
+  if (!GoodObject(proto)) {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  safe_integer(generic_count(container, proto), buff, bp);
+}
+
+/* addgeneric(<container>, <prototype>, <amount>) */
+FUNCTION(fun_addgeneric)
+{
+  dbref found[2];
+  dbref container, proto;
+  int count;
+
+  if (!is_strict_integer(args[2])) {
+    safe_str(T(e_int), buff, bp);
+    return;
+  }
+  /* Both names, as match_thing() would, in one pass over the lists */
+  match_result_batch(executor, executor, (const char **) args, 2, NOTYPE,
+                     MAT_EVERYTHING | MAT_NOISY, found);
+  container = found[0];
+  proto = found[1];
+  if (!GoodObject(container) || !GoodObject(proto)) {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!controls(executor, container)) {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  if (!IsThing(proto) || !Has_Flag_Handle(proto, &generic_flag)) {
+    safe_str(T("#-1 NOT A GENERIC OBJECT"), buff, bp);
+    return;
+  }
+
+  count = generic_adjust(container, proto, parse_integer(args[2]));
+  if (count == GENERIC_ERR_SHORT)
+    safe_str(T("#-1 NOT ENOUGH"), buff, bp);
+  else if (count == GENERIC_ERR_FULL)
+    safe_str(T("#-1 TOO MANY"), buff, bp);
+  else if (count < 0)
+    safe_str(T("#-1 UNABLE TO SET"), buff, bp);
+  else
+    safe_integer(count, buff, bp);
+}
+
+/** Add the generic softcode functions. Call from local_startup(). */
+void
+generic_init(void)
+{
+  function_add("GENERIC", fun_generic, 1, 2, FN_REG);
+  function_add("ADDGENERIC", fun_addgeneric, 3, 3, FN_REG);
+}
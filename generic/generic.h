@@ -0,0 +1,54 @@
+/**
+ * \file generic.h
+ *
+ * \brief Stacks of GENERIC objects held by containers.
+ *
+ * \verbatim
+ * A container holds <n> copies of a GENERIC thing (the prototype) by
+ * having the attribute GENERIC`<dbref of prototype> set to <n>. The
+ * attributes are kept as the saved form of a native per-container table,
+ * which is what matching and the functions below work from.
+ *
+ * Code that changes GENERIC` attributes directly, instead of through
+ * generic_set()/generic_adjust(), must call generic_attr_changed() on the
+ * container afterwards, and generic_destroyed() must be called before an
+ * object is recycled; HOOKS lists the places in the server. generic_init() should be called from
+ * local_startup() to add the softcode functions.
+ * \endverbatim
+ */
+
+#ifndef __GENERIC_H
+#define __GENERIC_H
+
+#include "conf.h"
+#include "dbdefs.h"
+
+#define GENERIC_ATTR "GENERIC`"
+
+/* Errors from generic_set() and generic_adjust() */
+#define GENERIC_ERR_SET -1      /* couldn't set or clear the attribute */
+#define GENERIC_ERR_SHORT -2    /* not enough items to take */
+#define GENERIC_ERR_FULL -3     /* more items than a count can hold */
+
+/** Callback for generic_iter().
+ * \param container container holding the stack.
+ * \param proto prototype of the stack.
+ * \param count number of items in the stack; may be 0 or less for a
+ *  stack that only hides an inherited one.
+ * \param data data passed to generic_iter().
+ * \return 1 to stop iterating, 0 to go on.
+ */
+typedef int (*generic_func) (dbref container, dbref proto, int count,
+                             void *data);
+
+extern int generic_count(dbref container, dbref proto);
+extern int generic_set(dbref container, dbref proto, int count);
+extern int generic_adjust(dbref container, dbref proto, int delta);
+extern int generic_iter(dbref container, int inherit, generic_func func,
+                        void *data);
+extern unsigned int generic_generation(dbref container);
+extern void generic_attr_changed(dbref container);
+extern void generic_destroyed(dbref thing);
+extern void generic_init(void);
+
+#endif                          /* __GENERIC_H */
@@ -8,12 +8,23 @@
  *  match_result_relative(who,where,name,type,flags) return match, AMBIGUOUS or
  * NOTHING
  *  match_result(who,name,type,flags) - return match, AMBIGUOUS, or NOTHING
+ *  match_result_batch(who,where,names,n,type,flags,results) - the same as
+ *      match_result_relative() for each of n names, but looking through
+ *      each list only once
  *  noisy_match_result(who,name,type,flags) - return match or NOTHING,
  *      and notify player on failures
  *  last_match_result(who,name,type,flags) - return match or NOTHING,
  *      and return the last match found in ambiguous situations
  *
- *  match_result_internal() does the legwork for all of the above.
+ *  match_result_internal() and match_scopes() do the legwork for all of
+ *  the above.
+ *
+ * Results are remembered for the rest of the command or queue cycle
+ * (see MATCH_CACHE below), so softcode that looks up the same name over
+ * and over only searches once. Whether who may match each object it has
+ * looked at is remembered for one match_result() or match_result_batch()
+ * call, so scopes and batched names that walk the same list only ask
+ * can_interact() once per object.
  *
  * who = dbref of player to match for
  * where = dbref of object to match relative to. For all functions which don't
@@ -55,6 +66,8 @@
 
 #include "copyrite.h"
 #include "match.h"
+#include "match_index.h"
+#include "match_stats.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -65,11 +78,14 @@
 #include "conf.h"
 #include "dbdefs.h"
 #include "externs.h"
+#include "flag_handle.h"
 #include "flags.h"
+#include "generic.h"
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "notify.h"
 #include "parse.h"
+#include "scratch.h"
 #include "strutil.h"
 
 struct match_context
@@ -91,14 +107,54 @@ struct match_context
   int done;        /* set to 1 when we're using final, and have found the Xth object */
   char *name;      /* name contains the object name searched for, 
                       after english matching tokens are stripped from xname */
+  char *sname;     /* scratch copy of xname that name points into */
+  MATCH_KEY key;   /* name, folded for comparing to objects' match names */
+  dbref loc;       /* location of 'where' */
+  int goodwhere;   /* set when 'where' is a valid object */
+  enum match_scope scope; /* scope being searched, for match_stats */
+  int cached;      /* set when a batched name was answered from the cache */
 };
 
+/* The lists searched for names are listed in match_stats.h, in the order
+ * they're searched. See match_scope_applies() for when each is used. */
+
+static FLAG_HANDLE generic_flag = FLAG_HANDLE_INIT("GENERIC", TYPE_THING);
+
+/* Contexts in a batch get looked up on the stack up to this many names */
+#define MATCH_BATCH_LOCAL 16
+
+/* Remembered can_interact() results for a call; must be a power of 2 */
+#define MATCH_INTERACT_SIZE 4096
+
+/** Whether who may match obj, as of the call it was checked in */
+struct match_interact_ent {
+  unsigned int call;      /**< Call it was checked in; 0 if unused */
+  dbref who;
+  dbref obj;
+  int ok;
+};
+
+static struct match_interact_ent match_interact[MATCH_INTERACT_SIZE];
+static unsigned int match_interact_call = 1;
+static unsigned int match_cycle = 1;
+
 static int parse_english(char **name, long *flags);
+static void match_interact_begin(void);
+static int match_can_interact(dbref obj, dbref who);
 static int matched(int full, struct match_context *mc);
-static int match_obj_list(dbref start, struct match_context *mc);
-static int match_attr_list(dbref start, struct match_context *mc);
+static int match_obj(struct match_context *mc);
+static int match_obj_list(dbref start, struct match_context **mcs, int n);
+static int match_obj_index(dbref container, int kind,
+                           struct match_context **mcs, int n);
+static int match_generic_list(dbref container, struct match_context **mcs,
+                              int n);
+static int match_scope_applies(enum match_scope scope,
+                               struct match_context *mc);
+static void match_scopes(struct match_context **mcs, int n);
+static int match_prepare(struct match_context *mc, dbref who, dbref where,
+                         const char *xname, int type, long flags);
+static dbref match_finish(struct match_context *mc);
 static dbref match_player(dbref who, const char *name, int partial);
-extern int check_alias(const char *command, const char *list); /* game.c */
 static dbref choose_thing(const dbref who, const int preferred_type, long flags,
                           dbref thing1, dbref thing2);
 static dbref match_result_internal(dbref who, dbref where, const char *xname,
@@ -181,30 +237,7 @@ match_controlled(dbref player, const char *name)
 
 #define BEST_MATCH choose_thing(mc->who, mc->type, mc->flags, mc->bestmatch, mc->match)
 
-#define MATCH_GENERIC(container)               \
-    {                                          \
-      if (match_attr_list(container, mc))      \
-        break;                                 \
-    }
-
-#define MATCH_LIST(start)                     \
-    {                                         \
-      result = match_obj_list(start, mc);     \
-      if (!result)                            \
-        continue;                             \
-      else if (result == 1)                   \
-        break;                                \
-    }
-
-#define MATCHED(full)                         \
-    {                                         \
-      if (matched(full, mc))                  \
-        break;                                \
-      else                                    \
-        continue;                             \
-    }
-
-/* matched() is called from inside match_obj_list() and match_attr_list(). Full is 1 if the
+/* matched() is called from inside match_obj_list() and match_generic_list(). Full is 1 if the
   match was full/exact, and 0 if it was partial.
   Returns 0 if matching should continue, or returns 1 if we are done. */
 static int matched(int full, struct match_context *mc)
@@ -252,105 +285,334 @@ static int matched(int full, struct match_context *mc)
   return 0;
 }
 
-static int match_attr_helper(dbref player __attribute__((__unused__)) , dbref thing __attribute__((__unused__)), 
-                             dbref parent __attribute__((__unused__)), char const *pattern __attribute__((__unused__)), 
-                             ATTR *atr, void *args)
+/* match_generic_helper() is called by generic_iter() for each stack of
+   GENERIC items held by a container. Returns 1 once we are done. */
+static int match_generic_helper(dbref container __attribute__((__unused__)),
+                                dbref proto, int count, void *args)
 {
-  int num;
-  dbref obj;
-  char *s, *p;
   struct match_context *mc = (struct match_context *) args;
 
   if (!mc || mc->done)
-    return 0;
-
-  s = p = mush_strdup(AL_NAME(atr), "generic.atrname");
-  strsep(&p, "`");
-  obj = parse_dbref(p);
+    return 1;
 
-  mush_free(s, "generic.atrname");
-  
-  if (!RealGoodObject(obj) || !has_flag_by_name(obj, "GENERIC", TYPE_THING))
+  if (!RealGoodObject(proto) || !Has_Flag_Handle(proto, &generic_flag))
     return 0;
   
-  num = parse_integer(atr_value(atr));
-  if (num <= 0) {
+  if (count <= 0) {
     return 0;
   }
   
-  mc->match = obj;
+  mc->match = proto;
+
+  return match_obj(mc);
+}
+
+/* A set of contexts all matching against the same GENERIC stacks */
+struct match_generic_batch {
+  struct match_context **mcs;
+  int n;
+  int left;        /* number of contexts not done yet */
+};
 
+/* Called by generic_iter() for each stack; hands it to every context
+   that's still looking. Returns 1 once they're all done. */
+static int match_generic_batch_helper(dbref container, dbref proto, int count,
+                                      void *args)
+{
+  struct match_generic_batch *mgb = (struct match_generic_batch *) args;
+  int i;
+
+  for (i = 0; i < mgb->n; i++) {
+    if (mgb->mcs[i]->done)
+      continue;
+    if (match_generic_helper(container, proto, count, mgb->mcs[i]))
+      mgb->left--;
+  }
+  return mgb->left <= 0;
+}
+
+/* match_generic_list() matches against the stacks of GENERIC items held by
+   container, its own and those it inherits, in the same order as their
+   GENERIC`<dbref> attributes, for each of the n contexts in mcs. The
+   stacks are only walked once, however many contexts there are. See
+   generic.c.
+   Returns 1 if all the contexts are done, 0 otherwise. */
+static int match_generic_list(dbref container, struct match_context **mcs,
+                              int n)
+{
+  struct match_generic_batch mgb;
+  int i;
+
+  mgb.mcs = mcs;
+  mgb.n = n;
+  mgb.left = 0;
+  for (i = 0; i < n; i++)
+    if (!mcs[i]->done)
+      mgb.left++;
+  if (!mgb.left)
+    return 1;
+
+  generic_iter(container, 1, &match_generic_batch_helper, &mgb);
+
+  return mgb.left <= 0;
+}
+
+/* Forget the remembered can_interact() results. Each match_result*() call
+   that searches starts with this: can_interact() goes through locks and
+   softcode hooks that can change between calls in the same command. */
+static void match_interact_begin(void)
+{
+  if (++match_interact_call == 0) {
+    memset(match_interact, 0, sizeof match_interact);
+    match_interact_call = 1;
+  }
+}
+
+/* match_can_interact() is can_interact(obj, who, INTERACT_MATCH, NULL),
+   remembered for the rest of the call. Matching asks it of every object
+   in every list it walks, for every name in a batch, and it can cost
+   more than the name tests. A slot another pair has taken is just asked
+   again. */
+static int match_can_interact(dbref obj, dbref who)
+{
+  struct match_interact_ent *ent;
+  unsigned int h;
+
+  h = (unsigned int) obj * 2654435761U ^ (unsigned int) who * 40503U;
+  ent = &match_interact[(h ^ (h >> 16)) & (MATCH_INTERACT_SIZE - 1)];
+  if (ent->call == match_interact_call && ent->obj == obj && ent->who == who)
+    return ent->ok;
+
+  MATCH_STAT_INC(interact);
+  ent->call = match_interact_call;
+  ent->obj = obj;
+  ent->who = who;
+  ent->ok = can_interact(obj, who, INTERACT_MATCH, NULL);
+  return ent->ok;
+}
+
+/* match_obj() checks the single object mc->match against the name we're
+   looking for. Returns 0 if matching should continue, or 1 if we are done. */
+static int match_obj(struct match_context *mc)
+{
+  const MATCH_NAME *mn;
+
+  MATCH_STAT_INC(examined[mc->scope]);
   if (!MATCH_TYPE) {
     /* Exact-type match required, but failed */
     return 0;
   } else if (mc->match == mc->abs) {
     /* absolute dbref match in list */
     return matched(1, mc);
-  } else if (!can_interact(mc->match, mc->who, INTERACT_MATCH, NULL)) {
+  } else if (!match_can_interact(mc->match, mc->who)) {
     /* Not allowed to match this object */
     return 0;
-  } else if (match_aliases(mc->match, mc->name) ||
-             (!IsExit(mc->match) && !strcasecmp(Name(mc->match), mc->name))) {
+  }
+
+  /* The name tests below are match_aliases(), strcasecmp() and
+     string_match(), done on the object's cached match name */
+  mn = match_name_get(mc->match);
+  if (match_name_alias(mn, &mc->key) ||
+      (!IsExit(mc->match) && match_name_exact(mn, &mc->key))) {
     /* exact name match */
     return matched(1, mc);
   } else if (!(mc->flags & MAT_EXACT) && (!mc->exact || !GoodObject(mc->bestmatch)) &&
-             !IsExit(mc->match) && string_match(Name(mc->match), mc->name)) {
+             !IsExit(mc->match) && match_name_partial(mn, &mc->key)) {
     /* partial name match */
     return matched(0, mc);
   }
 
-  return 1;
+  return 0;
 }
 
-static int match_attr_list(dbref obj, struct match_context *mc)
+/* match_obj_list() checks each object in a list against the names of the n
+   contexts in mcs. start is the dbref to begin matching at (we loop through
+   using DOLIST()). The list is walked once for all the contexts, each of
+   which sees the objects in list order, just as if it had been alone.
+   Returns 1 if all the contexts are done, 0 otherwise. */
+static int match_obj_list(dbref start, struct match_context **mcs, int n)
 {
-  void *args = (void *) mc;
-  
-  if (!mc)
-    return 0;
-  
-  if (mc->done)
-    return 1;
-  
-  atr_iter_get_parent(GOD, obj, "GENERIC`*", 0, 0, &match_attr_helper, args);
-  
-  if (mc->done)
-    return 1;
+  dbref thing;
+  int i, left = 0;
+
+  for (i = 0; i < n; i++)
+    if (!mcs[i]->done)
+      left++;
+  if (!left)
+    return 1; /* already found the Nth object we needed */
+
+  DOLIST(thing, start)
+  {
+    for (i = 0; i < n; i++) {
+      if (mcs[i]->done)
+        continue;
+      mcs[i]->match = thing;
+      if (match_obj(mcs[i]))
+        left--;
+    }
+    if (!left)
+      break;
+  }
   
-  return 0;
+  return !left;
 }
 
-/* match_obj_list() is called from inside the match_result() function. start is the
-   dbref to begin matching at (we loop through using DOLIST()).
-   Returns 0 if we should continue matching, or returns 1 if we are done. */
-static int match_obj_list(dbref start, struct match_context *mc)
+/* match_obj_index() does the same as match_obj_list() for the Contents() or
+   Exits() of container, but each context only looks at the objects the
+   container's name index says could match its name, in the same order.
+   Objects that aren't candidates would fall through every test in
+   match_obj(), so skipping them changes nothing: ambiguity, type and lock
+   preferences, and the Nth match with english matching all come out the
+   same. Contexts the index can't help are matched with one walk of the
+   whole list.
+   Returns 1 if all the contexts are done, 0 otherwise. */
+static int match_obj_index(dbref container, int kind,
+                           struct match_context **mcs, int n)
 {
-  if (mc->done)
-    return 1; /* already found the Nth object we needed */
-  mc->match = start;
-  DOLIST(mc->match, mc->match)
-  {
-    if (!MATCH_TYPE) {
-      /* Exact-type match required, but failed */
+  MATCH_CANDIDATES mcands;
+  struct match_context *mc, *tmp;
+  int i, j, partial, scan = 0, left = 0;
+
+  for (i = 0; i < n; i++) {
+    mc = mcs[i];
+    if (mc->done)
       continue;
-    } else if (mc->match == mc->abs) {
-      /* absolute dbref match in list */
-      MATCHED(1);
-    } else if (!can_interact(mc->match, mc->who, INTERACT_MATCH, NULL)) {
-      /* Not allowed to match this object */
+
+    /* Exits never match partially; see match_obj() */
+    partial = (!(kind & MIDX_EXITS) && !(mc->flags & MAT_EXACT) &&
+               (!mc->exact || !GoodObject(mc->bestmatch)));
+
+    if (match_index_lookup(container, kind, mc->name, partial, mc->abs,
+                           &mcands) < 0) {
+      /* Move it to the front, with the others needing the full list */
+      tmp = mcs[scan];
+      mcs[scan++] = mc;
+      mcs[i] = tmp;
       continue;
-    } else if (match_aliases(mc->match, mc->name) ||
-               (!IsExit(mc->match) && !strcasecmp(Name(mc->match), mc->name))) {
-      /* exact name match */
-      MATCHED(1);
-    } else if (!(mc->flags & MAT_EXACT) && (!mc->exact || !GoodObject(mc->bestmatch)) &&
-               !IsExit(mc->match) && string_match(Name(mc->match), mc->name)) {
-      /* partial name match */
-      MATCHED(0);
+    }
+
+    MATCH_STAT_INC(indexed[mc->scope]);
+    for (j = 0; j < mcands.count; j++) {
+      mc->match = mcands.list[j].obj;
+      if (match_obj(mc))
+        break;
+    }
+    match_candidates_free(&mcands);
+    if (!mc->done)
+      left++;
+  }
+
+  if (scan && !match_obj_list((kind & MIDX_EXITS) ? Exits(container) :
+                              Contents(container), mcs, scan))
+    left++;
+
+  return !left;
+}
+
+/* Does the context mc search the given scope? */
+static int
+match_scope_applies(enum match_scope scope, struct match_context *mc)
+{
+  long flags = mc->flags;
+  dbref where = mc->where;
+  dbref loc = mc->loc;
+  int exits;
+
+  if (mc->done)
+    return 0;
+
+  exits = ((mc->type & TYPE_EXIT) || !(flags & MAT_TYPE));
+
+  switch (scope) {
+  case MSCOPE_POSSESSION:
+  case MSCOPE_POSSESSION_GENERIC:
+    return mc->goodwhere && (flags & (MAT_POSSESSION | MAT_REMOTE_CONTENTS));
+  case MSCOPE_NEIGHBOR:
+  case MSCOPE_NEIGHBOR_GENERIC:
+    return GoodObject(loc) && (flags & MAT_NEIGHBOR) &&
+      !(flags & MAT_CONTENTS) && loc != where;
+  case MSCOPE_ZONE_EXITS:
+    return exits && GoodObject(loc) && IsRoom(loc) && (flags & MAT_EXIT) &&
+      (flags & MAT_REMOTES) && !(flags & (MAT_NEAR | MAT_CONTENTS)) &&
+      GoodObject(Zone(loc)) && IsRoom(Zone(loc));
+  case MSCOPE_GLOBAL_EXITS:
+    return exits && GoodObject(loc) && IsRoom(loc) && (flags & MAT_EXIT) &&
+      (flags & MAT_GLOBAL) && !(flags & (MAT_NEAR | MAT_CONTENTS));
+  case MSCOPE_EXITS:
+    return exits && GoodObject(loc) && IsRoom(loc) && (flags & MAT_EXIT);
+  case MSCOPE_CONTAINER:
+    return (flags & MAT_CONTAINER) && !(flags & MAT_CONTENTS) &&
+      mc->goodwhere;
+  case MSCOPE_CARRIED_EXITS:
+    return exits && (flags & MAT_CARRIED_EXIT) && mc->goodwhere &&
+      IsRoom(where) && ((loc != where) || !(flags & MAT_EXIT));
+  default:
+    return 0;
+  }
+}
+
+/* Search each scope in turn for the n contexts in mcs, which must all have
+   the same who and where. A context that uses english matching may have
+   had some scopes taken out of its flags, so which contexts search a
+   scope is decided for each one. */
+static void
+match_scopes(struct match_context **mcs, int n)
+{
+  struct match_context *local[MATCH_BATCH_LOCAL];
+  struct match_context **group;
+  enum match_scope scope;
+  dbref where = mcs[0]->where;
+  dbref loc = mcs[0]->loc;
+  int i, m;
+
+  if (n <= MATCH_BATCH_LOCAL)
+    group = local;
+  else
+    group = scratch_alloc(n * sizeof(struct match_context *));
+
+  for (scope = 0; scope < MSCOPE_COUNT; scope++) {
+    for (i = m = 0; i < n; i++) {
+      if (match_scope_applies(scope, mcs[i])) {
+        mcs[i]->scope = scope;
+        MATCH_STAT_INC(searched[scope]);
+        group[m++] = mcs[i];
+      }
+    }
+    if (!m)
+      continue;
+
+    switch (scope) {
+    case MSCOPE_POSSESSION:
+      match_obj_index(where, MIDX_CONTENTS, group, m);
+      break;
+    case MSCOPE_POSSESSION_GENERIC:
+      match_generic_list(where, group, m);
+      break;
+    case MSCOPE_NEIGHBOR:
+      match_obj_index(loc, MIDX_CONTENTS, group, m);
+      break;
+    case MSCOPE_NEIGHBOR_GENERIC:
+      match_generic_list(loc, group, m);
+      break;
+    case MSCOPE_ZONE_EXITS:
+      match_obj_index(Zone(loc), MIDX_EXITS | MIDX_ALWAYS, group, m);
+      break;
+    case MSCOPE_GLOBAL_EXITS:
+      match_obj_index(MASTER_ROOM, MIDX_EXITS | MIDX_ALWAYS, group, m);
+      break;
+    case MSCOPE_EXITS:
+      match_obj_index(loc, MIDX_EXITS, group, m);
+      break;
+    case MSCOPE_CONTAINER:
+      match_obj_list(loc, group, m);
+      break;
+    case MSCOPE_CARRIED_EXITS:
+      match_obj_index(where, MIDX_EXITS, group, m);
+      break;
+    default:
+      break;
     }
   }
-  
-  return 2;
 }
 
 static dbref
@@ -385,10 +647,11 @@ choose_thing(const dbref who, const int preferred_type, long flags,
   }
 
   if (flags & MAT_CHECK_KEYS) {
+    MATCH_STAT_INC(locks);
     key = could_doit(who, thing1, NULL);
-    if (!key && could_doit(who, thing2, NULL)) {
+    if (!key && (MATCH_STAT_INC(locks), could_doit(who, thing2, NULL))) {
       return thing2;
-    } else if (key && !could_doit(who, thing2, NULL)) {
+    } else if (key && (MATCH_STAT_INC(locks), !could_doit(who, thing2, NULL))) {
       return thing1;
     }
   }
@@ -416,6 +679,9 @@ match_player(dbref who, const char *name, int partial)
   return (GoodObject(who) && partial ? visible_short_page(who, name) : NOTHING);
 }
 
+/* Exits match on any part of their name or ALIAS attribute, players on
+ * their ALIAS attribute. Both are parsed once into a cached alias set;
+ * see match_index.c. */
 int
 match_aliases(dbref match, const char *name)
 {
@@ -424,15 +690,185 @@ match_aliases(dbref match, const char *name)
     return 0;
   }
 
-  if (IsExit(match) && check_alias(name, Name(match)))
-    return 1;
-  else {
-    char tbuf1[BUFFER_LEN];
-    ATTR *a = atr_get_noparent(match, "ALIAS");
-    if (!a)
-      return 0;
-    mush_strncpy(tbuf1, atr_value(a), BUFFER_LEN);
-    return check_alias(name, tbuf1);
+  return match_alias_set(match, name);
+}
+
+/* Cache of recent match results. A result is only reused within the
+ * same command or queue cycle (match_cycle_end() starts a new one, and
+ * match_cache_clear() throws the cache away when a flag, lock, parent
+ * or owner changes), and only while every list it could have been found
+ * in is unchanged, as told by the containers' generation numbers, and
+ * the GENERIC stacks of where and its location are too. Nothing is
+ * cached until the server has called match_cycle_end() once, so a
+ * server without the hook just goes without. Matches whose result hangs
+ * on control or locks aren't cached at all. Comment out MATCH_CACHE to
+ * turn it off. */
+#define MATCH_CACHE
+#define MATCH_CACHE_SIZE 256    /* Must be a power of 2 */
+#define MATCH_CACHE_NAMELEN 48  /* Longer names aren't cached */
+#define MATCH_CACHE_DEPS 7
+
+#ifdef MATCH_CACHE
+/** A remembered match result */
+struct match_cache_ent {
+  unsigned int cycle;     /**< Cycle it was found in; 0 if unused */
+  dbref who;
+  dbref where;
+  int type;
+  long flags;
+  char name[MATCH_CACHE_NAMELEN];
+  dbref deps[MATCH_CACHE_DEPS]; /**< Containers searched */
+  unsigned int gens[MATCH_CACHE_DEPS]; /**< Their generation numbers */
+  unsigned int player_gen;
+  unsigned int generic_gens[2]; /**< Of deps[0] and deps[1] */
+  dbref result;
+};
+
+static struct match_cache_ent match_cache[MATCH_CACHE_SIZE];
+static int match_cycles_seen = 0;       /* match_cycle_end() is called */
+
+/* Fill in the containers a match from where could search, and the
+ * generation numbers they have now */
+static void
+match_cache_deps(dbref who, dbref where, long flags, dbref *deps,
+                 unsigned int *gens, unsigned int *generic_gens)
+{
+  dbref loc = NOTHING;
+  int n;
+
+  if (RealGoodObject(where)) {
+    if (IsRoom(where))
+      loc = where;
+    else if (IsExit(where))
+      loc = Source(where);
+    else
+      loc = Location(where);
+  }
+  for (n = 0; n < MATCH_CACHE_DEPS; n++)
+    deps[n] = NOTHING;
+  deps[0] = where;
+  deps[1] = loc;
+  if (GoodObject(loc)) {
+    if (flags & MAT_REMOTES)
+      deps[2] = Zone(loc);
+    if (flags & MAT_CONTAINER)
+      deps[3] = Location(loc);
+  }
+  if (flags & MAT_GLOBAL)
+    deps[4] = MASTER_ROOM;
+  /* A player found by name has to be near who */
+  if ((flags & MAT_NEAR) && GoodObject(who)) {
+    deps[5] = who;
+    deps[6] = Location(who);
+  }
+  for (n = 0; n < MATCH_CACHE_DEPS; n++)
+    gens[n] = GoodObject(deps[n]) ? match_generation(deps[n]) : 0;
+  /* GENERIC stacks are matched in where and its location */
+  generic_gens[0] = generic_gens[1] = 0;
+  if (flags & (MAT_POSSESSION | MAT_REMOTE_CONTENTS))
+    generic_gens[0] = generic_generation(where);
+  if (flags & MAT_NEIGHBOR)
+    generic_gens[1] = generic_generation(loc);
+}
+
+static struct match_cache_ent *
+match_cache_slot(dbref who, dbref where, const char *name, int type,
+                 long flags)
+{
+  unsigned int h = 2166136261U;
+  const unsigned char *p;
+
+  for (p = (const unsigned char *) name; *p; p++)
+    h = (h ^ *p) * 16777619U;
+  h ^= (unsigned int) who * 2654435761U;
+  h ^= (unsigned int) where * 40503U;
+  h ^= (unsigned int) type ^ (unsigned int) flags;
+  return &match_cache[(h ^ (h >> 16)) & (MATCH_CACHE_SIZE - 1)];
+}
+
+/* Look for a cached result. Returns the entry the result belongs in, with
+ * *hit set if it's already there, or NULL if the match can't be cached. */
+static struct match_cache_ent *
+match_cache_find(dbref who, dbref where, const char *xname, int type,
+                 long flags, int *hit)
+{
+  struct match_cache_ent *ent;
+  dbref deps[MATCH_CACHE_DEPS];
+  unsigned int gens[MATCH_CACHE_DEPS], generic_gens[2];
+  int n;
+
+  *hit = 0;
+  /* Noisy matches have to complain every time, dbrefs are cheap anyway,
+   * locks can do anything when they're checked, and control changes
+   * with owners and flags, which no generation number follows. */
+  if (!match_cycles_seen ||
+      (flags & (MAT_NOISY | MAT_CHECK_KEYS | MAT_CONTROL)) ||
+      *xname == NUMBER_TOKEN || strlen(xname) >= MATCH_CACHE_NAMELEN)
+    return NULL;
+
+  ent = match_cache_slot(who, where, xname, type, flags);
+  if (ent->cycle != match_cycle || ent->who != who || ent->where != where ||
+      ent->type != type || ent->flags != flags ||
+      ent->player_gen != match_generation(NOTHING) || strcmp(ent->name, xname))
+    return ent;
+
+  match_cache_deps(who, where, flags, deps, gens, generic_gens);
+  for (n = 0; n < MATCH_CACHE_DEPS; n++)
+    if (ent->deps[n] != deps[n] || ent->gens[n] != gens[n])
+      return ent;
+  if (ent->generic_gens[0] != generic_gens[0] ||
+      ent->generic_gens[1] != generic_gens[1])
+    return ent;
+  *hit = 1;
+  return ent;
+}
+
+/* Remember a result in the entry match_cache_find() gave */
+static void
+match_cache_store(struct match_cache_ent *ent, dbref who, dbref where,
+                  const char *xname, int type, long flags, dbref result)
+{
+  ent->cycle = match_cycle;
+  ent->who = who;
+  ent->where = where;
+  ent->type = type;
+  ent->flags = flags;
+  strcpy(ent->name, xname);
+  match_cache_deps(who, where, flags, ent->deps, ent->gens,
+                   ent->generic_gens);
+  ent->player_gen = match_generation(NOTHING);
+  ent->result = result;
+}
+#endif                          /* MATCH_CACHE */
+
+/** Start a new matching cycle.
+ * Cached match results are forgotten. This should be called at the end
+ * of each command or queue entry.
+ */
+void
+match_cycle_end(void)
+{
+#ifdef MATCH_CACHE
+  match_cycles_seen = 1;
+#endif
+  match_cache_clear();
+}
+
+/** Forget cached match results.
+ * This has to be called as soon as anything changes what matches without
+ * moving or renaming an object: flags, locks, parents or ownership. The
+ * end of the command is too late, since the rest of it would still see
+ * the old results. Any object's change can matter to any match, through
+ * control or what who can see, so the whole cache goes.
+ */
+void
+match_cache_clear(void)
+{
+  if (++match_cycle == 0) {
+#ifdef MATCH_CACHE
+    memset(match_cache, 0, sizeof match_cache);
+#endif
+    match_cycle = 1;
   }
 }
 
@@ -449,6 +885,90 @@ match_result_relative(dbref who, dbref where, const char *xname, int type,
   return match_result_internal(who, where, xname, type, flags);
 }
 
+/** Match a list of names relative to an object.
+ * This gives the same results as calling match_result_relative() for each
+ * name in turn, and with MAT_NOISY the same complaints in the same order,
+ * but walks each list searched only once for all of them.
+ * \param who the object doing the matching.
+ * \param where the object to match relative to.
+ * \param names the names to match.
+ * \param n the number of names.
+ * \param type preferred type(s) of match.
+ * \param flags MAT_* flags.
+ * \param results array of n dbrefs to fill with the match, AMBIGUOUS or
+ *  NOTHING for each name.
+ */
+void
+match_result_batch(dbref who, dbref where, const char **names, int n,
+                   int type, long flags, dbref *results)
+{
+  struct match_context local[MATCH_BATCH_LOCAL];
+  struct match_context *lptrs[MATCH_BATCH_LOCAL];
+  struct match_context *contexts, **mcs;
+  SCRATCH_MARK mark;
+#ifdef MATCH_CACHE
+  struct match_cache_ent *ent;
+  int hit;
+#endif
+  int i, m;
+
+  if (n <= 0)
+    return;
+  if (match_stats_on) {
+    match_stats.batches++;
+    match_stats.names += n;
+  }
+  scratch_mark(&mark);
+  if (n <= MATCH_BATCH_LOCAL) {
+    contexts = local;
+    mcs = lptrs;
+  } else {
+    contexts = scratch_alloc(n * sizeof(struct match_context));
+    mcs = scratch_alloc(n * sizeof(struct match_context *));
+  }
+
+  for (i = m = 0; i < n; i++) {
+    contexts[i].cached = 0;
+#ifdef MATCH_CACHE
+    ent = match_cache_find(who, where, names[i], type, flags, &hit);
+    if (hit) {
+      results[i] = ent->result;
+      contexts[i].cached = 1;
+      MATCH_STAT_INC(cached);
+      continue;
+    }
+#endif
+    if (match_prepare(&contexts[i], who, where, names[i], type, flags))
+      MATCH_STAT_INC(early);
+    else
+      mcs[m++] = &contexts[i];
+  }
+
+  if (m) {
+    match_interact_begin();
+    match_scopes(mcs, m);
+  }
+
+  /* In the order of the names, so noisy complaints come out as they would
+     from a match_result() for each */
+  for (i = 0; i < n; i++) {
+    if (contexts[i].cached)
+      continue;
+    results[i] = match_finish(&contexts[i]);
+#ifdef MATCH_CACHE
+    ent = match_cache_find(who, where, names[i], type, flags, &hit);
+    if (ent)
+      match_cache_store(ent, who, where, names[i], type, flags, results[i]);
+#endif
+  }
+
+  if (match_stats_on) {
+    for (i = 0; i < n; i++)
+      match_stats_result(results[i]);
+  }
+  scratch_release(&mark);
+}
+
 /* The object 'who' is trying to find something called 'xname' relative to the
  * object 'where'.
  * In most cases, 'who' and 'where' will be the same object. */
@@ -458,8 +978,60 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
 {
   struct match_context context;
   struct match_context *mc = &context;
-  
-  int result;
+  SCRATCH_MARK mark;
+  dbref result = NOTHING;
+  uint64_t start = 0;
+  int hit = 0;
+#ifdef MATCH_CACHE
+  struct match_cache_ent *ent;
+#endif
+
+  if (match_stats_on) {
+    start = match_stats_clock();
+    match_stats.calls++;
+    match_stats.names++;
+  }
+
+#ifdef MATCH_CACHE
+  ent = match_cache_find(who, where, xname, type, flags, &hit);
+  if (hit) {
+    result = ent->result;
+    MATCH_STAT_INC(cached);
+  }
+#endif
+
+  if (!hit) {
+    scratch_mark(&mark);
+    if (match_prepare(mc, who, where, xname, type, flags)) {
+      MATCH_STAT_INC(early);
+    } else {
+      match_interact_begin();
+      match_scopes(&mc, 1);
+    }
+    result = match_finish(mc);
+    scratch_release(&mark);
+#ifdef MATCH_CACHE
+    if (ent)
+      match_cache_store(ent, who, where, xname, type, flags, result);
+#endif
+  }
+
+  if (match_stats_on) {
+    match_stats_result(result);
+    match_stats_latency(flags, match_stats_clock() - start);
+  }
+  return result;
+}
+
+/* Set up a context to match xname, and try the matches that don't need
+ * to search any lists: "me", "here", players and dbrefs.
+ * Returns 1 if that settled it, with the result in mc->bestmatch, or 0 if
+ * the lists need to be searched with match_scopes(). Either way the
+ * result is then got from match_finish(). */
+static int
+match_prepare(struct match_context *mc, dbref who, dbref where,
+              const char *xname, int type, long flags)
+{
   dbref loc;       /* location of 'where' */
   int goodwhere = RealGoodObject(where);
   char *name, *sname; /* name contains the object name searched for, after
@@ -477,6 +1049,8 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
   mc->right_type = 0;
   mc->exact = 0;
   mc->done = 0;
+  mc->name = mc->sname = NULL;
+  mc->scope = MSCOPE_POSSESSION;
 
   if (!goodwhere)
     loc = NOTHING;
@@ -486,14 +1060,15 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
     loc = Source(where);
   else
     loc = Location(where);
+  mc->loc = loc;
+  mc->goodwhere = goodwhere;
 
   if (((flags & MAT_NEAR) && !goodwhere) ||
       ((flags & MAT_CONTENTS) && !goodwhere)) {
-    /* It can't be nearby/in where's contents if where is invalid */
-    if ((flags & MAT_NOISY) && GoodObject(who)) {
-      notify(who, T("I can't see that here."));
-    }
-    return NOTHING;
+    /* It can't be nearby/in where's contents if where is invalid;
+       match_finish() complains */
+    mc->bestmatch = NOTHING;
+    return 1;
   }
 
   /* match "me" */
@@ -501,7 +1076,8 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
   if (goodwhere && MATCH_TYPE && (flags & MAT_ME) && !(flags & MAT_CONTENTS) &&
       !strcasecmp(xname, "me")) {
     if (MATCH_CONTROLS) {
-      return mc->match;
+      mc->bestmatch = mc->match;
+      return 1;
     } else {
       mc->nocontrol = 1;
     }
@@ -512,7 +1088,8 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
   if ((flags & MAT_HERE) && !(flags & MAT_CONTENTS) &&
       !strcasecmp(xname, "here") && GoodObject(mc->match) && MATCH_TYPE) {
     if (MATCH_CONTROLS) {
-      return mc->match;
+      mc->bestmatch = mc->match;
+      return 1;
     } else {
       mc->nocontrol = 1;
     }
@@ -528,7 +1105,8 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
         if (!(flags & MAT_NEAR) || Long_Fingers(who) ||
             (nearby(who, mc->match) || controls(who, mc->match))) {
           if (MATCH_CONTROLS) {
-            return mc->match;
+            mc->bestmatch = mc->match;
+            return 1;
           } else {
             mc->nocontrol = 1;
           }
@@ -547,56 +1125,35 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
         (nearby(who, mc->match) || controls(who, mc->match))) {
       /* valid dbref match */
       if (MATCH_CONTROLS) {
-        return mc->match;
+        mc->bestmatch = mc->match;
+        return 1;
       } else {
         mc->nocontrol = 1;
       }
     }
   }
 
-  sname = name = mush_strdup(xname, "mri.string");
+  sname = name = scratch_strdup(xname);
   if (flags & MAT_ENGLISH) {
     /* English-style matching */
     mc->final = parse_english(&name, &flags);
   }
   mc->name = name;
+  mc->sname = sname;
   mc->flags = flags;
+  match_key_init(&mc->key, name, scratch_alloc(strlen(name) + 1));
 
-  while (1) {
-    if (goodwhere && ((flags & (MAT_POSSESSION | MAT_REMOTE_CONTENTS)))) {
-      MATCH_LIST(Contents(where));
-      MATCH_GENERIC(where);
-    }
-    if (GoodObject(loc) && (flags & MAT_NEIGHBOR) && !(flags & MAT_CONTENTS) &&
-        loc != where) {
-      MATCH_LIST(Contents(loc));
-      MATCH_GENERIC(loc);
-    }
-    if ((type & TYPE_EXIT) || !(flags & MAT_TYPE)) {
-      if (GoodObject(loc) && IsRoom(loc) && (flags & MAT_EXIT)) {
-        if ((flags & MAT_REMOTES) && !(flags & (MAT_NEAR | MAT_CONTENTS)) &&
-            GoodObject(Zone(loc)) && IsRoom(Zone(loc))) {
-          MATCH_LIST(Exits(Zone(loc)));
-        }
-        if ((flags & MAT_GLOBAL) && !(flags & (MAT_NEAR | MAT_CONTENTS))) {
-          MATCH_LIST(Exits(MASTER_ROOM));
-        }
-        if (GoodObject(loc) && IsRoom(loc)) {
-          MATCH_LIST(Exits(loc));
-        }
-      }
-    }
-    if ((flags & MAT_CONTAINER) && !(flags & MAT_CONTENTS) && goodwhere) {
-      MATCH_LIST(loc);
-    }
-    if ((type & TYPE_EXIT) || !(flags & MAT_TYPE)) {
-      if ((flags & MAT_CARRIED_EXIT) && goodwhere && IsRoom(where) &&
-          ((loc != where) || !(flags & MAT_EXIT))) {
-        MATCH_LIST(Exits(where));
-      }
-    }
-    break;
-  }
+  return 0;
+}
+
+/* Decide the result of a match, and complain about it if the match is
+ * noisy. A context match_prepare() settled has nothing left to decide.
+ * The caller gives back the context's scratch memory. */
+static dbref
+match_finish(struct match_context *mc)
+{
+  long flags = mc->flags;
+  dbref who = mc->who;
 
   if (!GoodObject(mc->bestmatch) && mc->final) {
     /* we never found the Nth item */
@@ -620,8 +1177,6 @@ match_result_internal(dbref who, dbref where, const char *xname, int type,
     }
   }
 
-  mush_free(sname, "mri.string");
-
   return mc->bestmatch;
 }
 
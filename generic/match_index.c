@@ -0,0 +1,1100 @@
+/**
+ * \file match_index.c
+ *
+ * \brief Per-container name indexes and alias sets for the matcher.
+ *
+ * \verbatim
+ * Matching a name against Contents() or Exits() costs a can_interact()
+ * and a couple of string compares for every object in the list. Once a
+ * list holds MATCH_INDEX_MIN objects, we keep a hash of its folded names
+ * and aliases, and a sorted array of every word-start suffix of its
+ * folded names (so "sw" finds "long sword" by a binary search for the
+ * entries beginning with "sw"), and match.c only has to look at the
+ * objects that could possibly match.
+ *
+ * Every object matched against also gets a cached match name: its name
+ * case-folded, the places in it string_match() would try, and, for exits
+ * and players, the aliases from the exit name and ALIAS attribute, parsed
+ * once and case-folded, each with a hash of its trimmed form. The name
+ * being looked for is folded once into a MATCH_KEY, and then exact,
+ * partial and alias tests are all length checks and memcmp()s instead of
+ * strcasecmp(), string_match() and re-parsing alias lists.
+ *
+ * Each container also has a generation number, bumped whenever an object
+ * enters or leaves one of its lists or one of them is renamed, so cached
+ * match results can tell when they've gone stale.
+ *
+ * The index never decides a match by itself. It hands back a superset of
+ * the objects that can match, in list order, and match.c runs its usual
+ * checks on each of them; a stale entry costs a wasted check and nothing
+ * else. Objects arriving in a list are noticed even without the hooks,
+ * since PUSH() always puts them at the head, but renames and ALIAS
+ * changes are only seen through match_index_renamed().
+ * \endverbatim
+ */
+
+#include "copyrite.h"
+#include "match_index.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "attrib.h"
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "htab.h"
+#include "intmap.h"
+#include "mymalloc.h"
+#include "strutil.h"
+
+/* One object in an indexed list */
+struct midx_entry {
+  dbref obj;          /* the object */
+  unsigned int seq;   /* list position, higher is nearer the head */
+  int slot;           /* where we are in midx->entries */
+  char *name;         /* copy of Name(obj) when the keys were made */
+  size_t len;         /* its length */
+  int nkeys;          /* number of keys */
+  char **keys;        /* folded name and aliases */
+  char *fold;         /* folded Name(), for partial matches, or NULL */
+};
+
+/* A place in a folded name where string_match() could start matching */
+struct midx_word {
+  const char *text;   /* points into the owning entry's fold */
+  dbref obj;
+};
+
+/* All the objects in a list that share a key */
+struct midx_bucket {
+  int count;
+  int size;
+  dbref *objs;
+};
+
+/* The index of one container's Contents() or Exits() */
+struct midx {
+  dbref container;
+  int kind;           /* MIDX_CONTENTS or MIDX_EXITS */
+  dbref head;         /* list head when we last synced */
+  int small;          /* list was too short to be worth indexing */
+  unsigned int top;   /* seq of the newest entry */
+  int count;          /* entries in use */
+  int size;           /* entries allocated */
+  struct midx_entry **entries;
+  intmap *members;    /* dbref -> struct midx_entry */
+  HASHTAB names;      /* key -> struct midx_bucket */
+  int nwords;         /* words in use */
+  int wsize;          /* words allocated */
+  int wsorted;        /* words are in strcmp() order */
+  struct midx_word *words;
+};
+
+/* One alias in an alias set */
+struct alias_ent {
+  unsigned int hash;  /* hash of the alias, folded and right-trimmed */
+  unsigned int len;   /* length of the alias, right-trimmed */
+  unsigned int full;  /* length of the alias including trailing spaces */
+  unsigned int off;   /* where the folded alias starts in text */
+};
+
+/* The cached match name of an object. Allocated as a single block. */
+struct match_name {
+  char *name;         /* copy of Name() when this was built */
+  size_t len;         /* length of Name() */
+  char *fold;         /* Name(), folded */
+  int nwords;         /* places in Name() string_match() tries */
+  unsigned int *words;
+  int count;          /* number of aliases, 0 unless an exit or player */
+  struct alias_ent *ents;
+  char *text;         /* folded aliases, each NUL-terminated */
+};
+
+/* Match names, by dbref */
+static MATCH_NAME **mnames = NULL;
+static int mnames_size = 0;
+
+/* Generation numbers; see match_generation() */
+struct match_gen {
+  unsigned int gen;
+};
+
+static intmap *match_gens = NULL;
+static unsigned int match_gen_last = 0;
+static unsigned int match_player_gen = 0;
+
+static intmap *midx_tables[MIDX_KINDS] = { NULL, NULL };
+
+#define MIDX_HEAD(c, k) ((k) == MIDX_EXITS ? Exits(c) : Contents(c))
+
+/* Could string_match() try to match a word starting at s[i]? It really
+ * only tries alphanumerics that follow a non-alphanumeric, but anything
+ * following a non-alphanumeric will do for us. */
+#define MIDX_WORD_START(s, i) ((i) == 0 || !isalnum((unsigned char) (s)[(i) - 1]))
+
+/* Alphanumeric, tested exactly the way string_match() tests it */
+#define MNAME_ALNUM(c) (isalpha((int) (c)) || isdigit((int) (c)))
+
+static int name_same(const char *name, size_t len, const char *now);
+static int midx_in_list(dbref obj, dbref container, int kind);
+static size_t midx_fold(const char *src, size_t len, char *dst);
+static void midx_bucket_free(void *data);
+static void midx_add_key(struct midx_entry *e, const char *src, size_t len);
+static unsigned int alias_hash(const char *s, size_t len);
+static int alias_split(const char *list, struct alias_ent *ents, char *text,
+                       size_t *textlen);
+static MATCH_NAME *mname_build(dbref thing);
+static void mname_forget(dbref thing);
+static void midx_make_keys(struct midx_entry *e);
+static void midx_free_keys(struct midx_entry *e);
+static int midx_word_lower(struct midx *idx, const char *text);
+static int midx_word_cmp(const void *a, const void *b);
+static void midx_words_add(struct midx *idx, struct midx_entry *e);
+static void midx_words_del(struct midx *idx, struct midx_entry *e);
+static void midx_link(struct midx *idx, struct midx_entry *e);
+static void midx_unlink(struct midx *idx, struct midx_entry *e);
+static void midx_insert(struct midx *idx, dbref obj, unsigned int seq);
+static void midx_remove(struct midx *idx, dbref obj);
+static struct midx *midx_find(dbref container, int kind);
+static void midx_drop(struct midx *idx);
+static struct midx *midx_build(dbref container, int kind, int always);
+static int midx_sync(struct midx *idx);
+static struct midx *midx_get(dbref container, int kind, int always);
+static void midx_candidate(struct midx *idx, MATCH_CANDIDATES *mcands,
+                           dbref obj);
+static int midx_cand_cmp(const void *a, const void *b);
+static void match_touch(dbref container);
+
+/* Is a name we kept a copy of still the object's name? The server may
+ * give a new name the old one's memory, so the pointer can't tell us. */
+static int
+name_same(const char *name, size_t len, const char *now)
+{
+  return strlen(now) == len && !memcmp(name, now, len);
+}
+
+/* Is obj really in container's list right now? */
+static int
+midx_in_list(dbref obj, dbref container, int kind)
+{
+  if (!RealGoodObject(obj))
+    return 0;
+  if (kind == MIDX_EXITS)
+    return IsExit(obj) && Source(obj) == container;
+  return !IsExit(obj) && Location(obj) == container;
+}
+
+/* Fold a name or alias into a key: lowercased, with surrounding
+ * whitespace removed. Everything that strcasecmp() or check_alias()
+ * could match to the same string folds to the same key. dst must hold
+ * BUFFER_LEN chars. */
+static size_t
+midx_fold(const char *src, size_t len, char *dst)
+{
+  size_t n = 0;
+
+  while (len && isspace((unsigned char) *src)) {
+    src++;
+    len--;
+  }
+  while (len && isspace((unsigned char) src[len - 1]))
+    len--;
+  if (len >= BUFFER_LEN)
+    len = BUFFER_LEN - 1;
+  for (n = 0; n < len; n++)
+    dst[n] = DOWNCASE(src[n]);
+  dst[n] = '\0';
+  return n;
+}
+
+static void
+midx_bucket_free(void *data)
+{
+  struct midx_bucket *b = data;
+
+  mush_free(b->objs, "midx.bucket.objs");
+  mush_free(b, "midx.bucket");
+}
+
+static void
+midx_add_key(struct midx_entry *e, const char *src, size_t len)
+{
+  char key[BUFFER_LEN];
+  int i;
+
+  midx_fold(src, len, key);
+  for (i = 0; i < e->nkeys; i++) {
+    if (!strcmp(e->keys[i], key))
+      return;
+  }
+  e->keys = mush_realloc(e->keys, (e->nkeys + 1) * sizeof(char *),
+                         "midx.keys");
+  e->keys[e->nkeys++] = mush_strdup(key, "midx.key");
+}
+
+/* The keys an object can be matched by: its full name for anything but
+ * an exit, and the alias set of exits and players. This mirrors
+ * match_obj() and match_aliases() in match.c. */
+static void
+midx_make_keys(struct midx_entry *e)
+{
+  dbref obj = e->obj;
+  const MATCH_NAME *mn;
+  int i;
+
+  mn = match_name_get(obj);
+  e->name = mush_strdup(mn->name, "midx.name");
+  e->len = mn->len;
+  if (!IsExit(obj)) {
+    midx_add_key(e, mn->name, mn->len);
+    e->fold = mush_strdup(mn->fold, "midx.fold");
+  }
+  for (i = 0; i < mn->count; i++)
+    midx_add_key(e, mn->text + mn->ents[i].off, mn->ents[i].len);
+}
+
+static void
+midx_free_keys(struct midx_entry *e)
+{
+  int i;
+
+  for (i = 0; i < e->nkeys; i++)
+    mush_free(e->keys[i], "midx.key");
+  if (e->keys)
+    mush_free(e->keys, "midx.keys");
+  if (e->fold)
+    mush_free(e->fold, "midx.fold");
+  if (e->name)
+    mush_free(e->name, "midx.name");
+  e->keys = NULL;
+  e->nkeys = 0;
+  e->fold = NULL;
+  e->name = NULL;
+}
+
+/* Find the first word that sorts at or after text */
+static int
+midx_word_lower(struct midx *idx, const char *text)
+{
+  int lo = 0, hi = idx->nwords, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (strcmp(idx->words[mid].text, text) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int
+midx_word_cmp(const void *a, const void *b)
+{
+  const struct midx_word *wa = a, *wb = b;
+
+  return strcmp(wa->text, wb->text);
+}
+
+/* Add each word of e's name. While the index is being built, words are
+ * just appended, and sorted all at once at the end. */
+static void
+midx_words_add(struct midx *idx, struct midx_entry *e)
+{
+  int i, pos;
+
+  if (!e->fold)
+    return;
+  for (i = 0; e->fold[i]; i++) {
+    if (!MIDX_WORD_START(e->fold, i))
+      continue;
+    if (idx->nwords == idx->wsize) {
+      idx->wsize = idx->wsize ? idx->wsize * 2 : MATCH_INDEX_MIN * 2;
+      idx->words = mush_realloc(idx->words,
+                                idx->wsize * sizeof(struct midx_word),
+                                "midx.words");
+    }
+    pos = idx->wsorted ? midx_word_lower(idx, e->fold + i) : idx->nwords;
+    memmove(idx->words + pos + 1, idx->words + pos,
+            (idx->nwords - pos) * sizeof(struct midx_word));
+    idx->words[pos].text = e->fold + i;
+    idx->words[pos].obj = e->obj;
+    idx->nwords++;
+  }
+}
+
+static void
+midx_words_del(struct midx *idx, struct midx_entry *e)
+{
+  int i, pos;
+
+  if (!e->fold)
+    return;
+  for (i = 0; e->fold[i]; i++) {
+    if (!MIDX_WORD_START(e->fold, i))
+      continue;
+    for (pos = idx->wsorted ? midx_word_lower(idx, e->fold + i) : 0;
+         pos < idx->nwords; pos++) {
+      if (idx->words[pos].text == e->fold + i) {
+        memmove(idx->words + pos, idx->words + pos + 1,
+                (idx->nwords - pos - 1) * sizeof(struct midx_word));
+        idx->nwords--;
+        break;
+      }
+    }
+  }
+}
+
+static void
+midx_link(struct midx *idx, struct midx_entry *e)
+{
+  struct midx_bucket *b;
+  int i;
+
+  for (i = 0; i < e->nkeys; i++) {
+    b = hashfind(e->keys[i], &idx->names);
+    if (!b) {
+      b = mush_malloc(sizeof(struct midx_bucket), "midx.bucket");
+      b->count = 0;
+      b->size = 2;
+      b->objs = mush_malloc(b->size * sizeof(dbref), "midx.bucket.objs");
+      hashadd(e->keys[i], b, &idx->names);
+    } else if (b->count == b->size) {
+      b->size *= 2;
+      b->objs = mush_realloc(b->objs, b->size * sizeof(dbref),
+                             "midx.bucket.objs");
+    }
+    b->objs[b->count++] = e->obj;
+  }
+  midx_words_add(idx, e);
+}
+
+static void
+midx_unlink(struct midx *idx, struct midx_entry *e)
+{
+  struct midx_bucket *b;
+  int i, j;
+
+  midx_words_del(idx, e);
+  for (i = 0; i < e->nkeys; i++) {
+    b = hashfind(e->keys[i], &idx->names);
+    if (!b)
+      continue;
+    for (j = 0; j < b->count; j++) {
+      if (b->objs[j] == e->obj) {
+        b->objs[j] = b->objs[--b->count];
+        break;
+      }
+    }
+    if (!b->count)
+      hashdelete(e->keys[i], &idx->names);
+  }
+}
+
+/* Add obj to the index, or move it to a new list position */
+static void
+midx_insert(struct midx *idx, dbref obj, unsigned int seq)
+{
+  struct midx_entry *e;
+
+  e = im_find(idx->members, obj);
+  if (e) {
+    e->seq = seq;
+    if (!name_same(e->name, e->len, Name(obj))) {
+      /* Renamed behind our back */
+      midx_unlink(idx, e);
+      midx_free_keys(e);
+      midx_make_keys(e);
+      midx_link(idx, e);
+    }
+    return;
+  }
+
+  e = mush_malloc(sizeof(struct midx_entry), "midx.entry");
+  e->obj = obj;
+  e->seq = seq;
+  e->nkeys = 0;
+  e->keys = NULL;
+  e->fold = NULL;
+  e->name = NULL;
+  midx_make_keys(e);
+
+  if (idx->count == idx->size) {
+    idx->size = idx->size ? idx->size * 2 : MATCH_INDEX_MIN;
+    idx->entries = mush_realloc(idx->entries,
+                                idx->size * sizeof(struct midx_entry *),
+                                "midx.entries");
+  }
+  e->slot = idx->count;
+  idx->entries[idx->count++] = e;
+  im_insert(idx->members, obj, e);
+  midx_link(idx, e);
+}
+
+static void
+midx_remove(struct midx *idx, dbref obj)
+{
+  struct midx_entry *e;
+
+  e = im_find(idx->members, obj);
+  if (!e)
+    return;
+  midx_unlink(idx, e);
+  im_delete(idx->members, obj);
+  idx->entries[e->slot] = idx->entries[--idx->count];
+  idx->entries[e->slot]->slot = e->slot;
+  midx_free_keys(e);
+  mush_free(e, "midx.entry");
+}
+
+static struct midx *
+midx_find(dbref container, int kind)
+{
+  if (!midx_tables[kind])
+    return NULL;
+  return im_find(midx_tables[kind], container);
+}
+
+/* Throw away an index. It'll be rebuilt next time it's needed. */
+static void
+midx_drop(struct midx *idx)
+{
+  int i;
+
+  im_delete(midx_tables[idx->kind], idx->container);
+  if (!idx->small) {
+    for (i = 0; i < idx->count; i++) {
+      midx_free_keys(idx->entries[i]);
+      mush_free(idx->entries[i], "midx.entry");
+    }
+    if (idx->entries)
+      mush_free(idx->entries, "midx.entries");
+    if (idx->words)
+      mush_free(idx->words, "midx.words");
+    im_destroy(idx->members);
+    hashfree(&idx->names);
+  }
+  mush_free(idx, "midx");
+}
+
+static struct midx *
+midx_build(dbref container, int kind, int always)
+{
+  struct midx *idx;
+  dbref thing;
+  int n = 0;
+
+  if (!midx_tables[kind])
+    midx_tables[kind] = im_new();
+
+  idx = mush_malloc(sizeof(struct midx), "midx");
+  idx->container = container;
+  idx->kind = kind;
+  idx->head = MIDX_HEAD(container, kind);
+  idx->count = 0;
+  idx->size = 0;
+  idx->entries = NULL;
+  idx->members = NULL;
+  idx->nwords = 0;
+  idx->wsize = 0;
+  idx->wsorted = 0;
+  idx->words = NULL;
+
+  if (!always) {
+    DOLIST(thing, idx->head) {
+      if (++n >= MATCH_INDEX_MIN || n > db_top)
+        break;
+    }
+  }
+  idx->small = !always && (n < MATCH_INDEX_MIN);
+  im_insert(midx_tables[kind], container, idx);
+  if (idx->small)
+    return idx;
+
+  idx->members = im_new();
+  hash_init(&idx->names, 64, midx_bucket_free);
+
+  /* Number the list from the top down, so later arrivals at the head can
+   * simply count up from idx->top. */
+  n = 0;
+  DOLIST(thing, idx->head) {
+    if (++n > db_top)
+      break;
+  }
+  idx->top = (unsigned int) n;
+  DOLIST(thing, idx->head) {
+    if (n <= 0)
+      break;
+    midx_insert(idx, thing, (unsigned int) n--);
+  }
+  qsort(idx->words, idx->nwords, sizeof(struct midx_word), midx_word_cmp);
+  idx->wsorted = 1;
+  return idx;
+}
+
+/* Catch up with objects pushed onto the head of the list since we last
+ * looked. Returns 0 if the list changed in a way we can't follow, and
+ * the index should be rebuilt. */
+static int
+midx_sync(struct midx *idx)
+{
+  dbref head = MIDX_HEAD(idx->container, idx->kind);
+  dbref thing;
+  int arrived = 0, n;
+
+  if (head == idx->head)
+    return 1;
+  if (idx->small)
+    return 0;
+
+  for (thing = head; GoodObject(thing) && thing != idx->head;
+       thing = Next(thing)) {
+    if (++arrived > db_top)
+      return 0;
+  }
+  if (thing != idx->head)
+    return 0;
+
+  for (thing = head, n = arrived; n > 0; thing = Next(thing), n--)
+    midx_insert(idx, thing, idx->top + n);
+  idx->top += arrived;
+  idx->head = head;
+  return 1;
+}
+
+/* Get an up to date index for a list, or NULL if it isn't indexed.
+ * With always, the list is indexed however short it is. */
+static struct midx *
+midx_get(dbref container, int kind, int always)
+{
+  struct midx *idx;
+
+  idx = midx_find(container, kind);
+  if (idx && ((always && idx->small) || !midx_sync(idx))) {
+    midx_drop(idx);
+    idx = NULL;
+  }
+  if (!idx)
+    idx = midx_build(container, kind, always);
+  return idx->small ? NULL : idx;
+}
+
+static void
+midx_candidate(struct midx *idx, MATCH_CANDIDATES *mcands, dbref obj)
+{
+  struct midx_entry *e;
+
+  e = im_find(idx->members, obj);
+  if (!e || !midx_in_list(obj, idx->container, idx->kind))
+    return;
+  if (mcands->count == mcands->size) {
+    mcands->size *= 2;
+    if (mcands->list == mcands->local) {
+      mcands->list = mush_malloc(mcands->size * sizeof(struct match_cand),
+                                 "midx.candidates");
+      memcpy(mcands->list, mcands->local, sizeof mcands->local);
+    } else {
+      mcands->list = mush_realloc(mcands->list,
+                                  mcands->size * sizeof(struct match_cand),
+                                  "midx.candidates");
+    }
+  }
+  mcands->list[mcands->count].obj = obj;
+  mcands->list[mcands->count].seq = e->seq;
+  mcands->count++;
+}
+
+static int
+midx_cand_cmp(const void *a, const void *b)
+{
+  const struct match_cand *ca = a, *cb = b;
+
+  if (ca->seq == cb->seq)
+    return 0;
+  return ca->seq > cb->seq ? -1 : 1;
+}
+
+/* FNV-1a */
+static unsigned int
+alias_hash(const char *s, size_t len)
+{
+  unsigned int h = 2166136261U;
+
+  while (len--) {
+    h ^= (unsigned char) *s++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+/* Split a semicolon-separated list exactly the way check_alias() does:
+ * whitespace is skipped after each delimiter, but not at the very start,
+ * and there's no empty alias after a trailing delimiter. If ents is
+ * given, fill in the aliases and their folded text; either way, return
+ * the number of aliases and add the text they need to *textlen. */
+static int
+alias_split(const char *list, struct alias_ent *ents, char *text,
+            size_t *textlen)
+{
+  const char *s;
+  size_t full, len, i;
+  int n = 0;
+
+  while (*list) {
+    for (s = list; *s && *s != EXIT_DELIMITER; s++) ;
+    full = s - list;
+    if (ents) {
+      for (len = full; len && isspace((unsigned char) list[len - 1]); len--) ;
+      for (i = 0; i < full; i++)
+        text[*textlen + i] = DOWNCASE(list[i]);
+      text[*textlen + full] = '\0';
+      ents[n].off = *textlen;
+      ents[n].full = full;
+      ents[n].len = len;
+      ents[n].hash = alias_hash(text + *textlen, len);
+    }
+    *textlen += full + 1;
+    n++;
+    if (*s)
+      s++;
+    while (isspace((unsigned char) *s))
+      s++;
+    list = s;
+  }
+  return n;
+}
+
+/* Build thing's match name. Aliases come from an exit's name and the
+ * ALIAS attribute of exits and players, as in match_aliases(). */
+static MATCH_NAME *
+mname_build(dbref thing)
+{
+  char alias[BUFFER_LEN];
+  MATCH_NAME *mn;
+  const char *name = Name(thing);
+  size_t len, textlen = 0, i;
+  int count = 0, nwords = 0;
+  ATTR *a;
+
+  alias[0] = '\0';
+  if (IsExit(thing) || IsPlayer(thing)) {
+    a = atr_get_noparent(thing, "ALIAS");
+    if (a)
+      mush_strncpy(alias, atr_value(a), BUFFER_LEN);
+    if (IsExit(thing))
+      count += alias_split(name, NULL, NULL, &textlen);
+    count += alias_split(alias, NULL, NULL, &textlen);
+  }
+
+  /* string_match() tries the start, and then every alphanumeric that
+   * follows something else */
+  len = strlen(name);
+  for (i = 0; i < len; i++)
+    if (!i || (MNAME_ALNUM(name[i]) && !MNAME_ALNUM(name[i - 1])))
+      nwords++;
+
+  mn = mush_malloc(sizeof(MATCH_NAME) + count * sizeof(struct alias_ent) +
+                   nwords * sizeof(unsigned int) + textlen + 2 * (len + 1),
+                   "match_name");
+  mn->len = len;
+  mn->ents = (struct alias_ent *) (mn + 1);
+  mn->words = (unsigned int *) (mn->ents + count);
+  mn->text = (char *) (mn->words + nwords);
+  mn->fold = mn->text + textlen;
+  mn->name = mn->fold + len + 1;
+  memcpy(mn->name, name, len + 1);
+
+  for (i = 0; i <= len; i++)
+    mn->fold[i] = DOWNCASE(name[i]);
+  mn->nwords = 0;
+  for (i = 0; i < len; i++)
+    if (!i || (MNAME_ALNUM(name[i]) && !MNAME_ALNUM(name[i - 1])))
+      mn->words[mn->nwords++] = i;
+
+  textlen = 0;
+  mn->count = 0;
+  if (IsExit(thing))
+    mn->count += alias_split(name, mn->ents, mn->text, &textlen);
+  if (IsExit(thing) || IsPlayer(thing))
+    mn->count += alias_split(alias, mn->ents + mn->count, mn->text, &textlen);
+  return mn;
+}
+
+/** Get an object's match name, building it if needed.
+ * It stays good until the object is renamed or its ALIAS changes, as
+ * told by match_index_renamed(), or Name() changes.
+ * \param thing object to get the match name of.
+ * \return its match name, or NULL for a garbage dbref.
+ */
+const MATCH_NAME *
+match_name_get(dbref thing)
+{
+  MATCH_NAME *mn;
+  int n;
+
+  if (!GoodObject(thing))
+    return NULL;
+  if (thing >= mnames_size) {
+    n = mnames_size ? mnames_size : 1024;
+    while (n <= thing)
+      n *= 2;
+    mnames = mush_realloc(mnames, n * sizeof(MATCH_NAME *), "match_name.table");
+    memset(mnames + mnames_size, 0, (n - mnames_size) * sizeof(MATCH_NAME *));
+    mnames_size = n;
+  }
+  mn = mnames[thing];
+  if (mn && !name_same(mn->name, mn->len, Name(thing))) {
+    mname_forget(thing);
+    mn = NULL;
+  }
+  if (!mn)
+    mn = mnames[thing] = mname_build(thing);
+  return mn;
+}
+
+static void
+mname_forget(dbref thing)
+{
+  if (thing < 0 || thing >= mnames_size || !mnames[thing])
+    return;
+  mush_free(mnames[thing], "match_name");
+  mnames[thing] = NULL;
+}
+
+/** Fold a name for matching.
+ * \param key the key to fill in.
+ * \param name the name being looked for.
+ * \param buff where to put the folded name; at least strlen(name) + 1
+ *  chars. The key uses it, and name, until it's done with.
+ */
+void
+match_key_init(MATCH_KEY *key, const char *name, char *buff)
+{
+  size_t i;
+
+  key->name = name;
+  for (i = 0; name[i]; i++)
+    buff[i] = DOWNCASE(name[i]);
+  buff[i] = '\0';
+  key->fold = buff;
+  key->len = i;
+  for (i = key->len; i && isspace((unsigned char) name[i - 1]); i--) ;
+  key->tlen = i;
+  key->hash = alias_hash(buff, key->tlen);
+}
+
+/** Is a name the whole name of an object, apart from case?
+ * \param mn the object's match name.
+ * \param key the name.
+ * \return the same as !strcasecmp(Name(thing), name).
+ */
+int
+match_name_exact(const MATCH_NAME *mn, const MATCH_KEY *key)
+{
+  return mn && mn->len == key->len && !memcmp(mn->fold, key->fold, key->len);
+}
+
+/** Does a name start a word of an object's name, apart from case?
+ * \param mn the object's match name.
+ * \param key the name.
+ * \return the same as string_match(Name(thing), name) != NULL.
+ */
+int
+match_name_partial(const MATCH_NAME *mn, const MATCH_KEY *key)
+{
+  int i;
+
+  if (!mn || !key->len || key->len > mn->len)
+    return 0;
+  for (i = 0; i < mn->nwords && mn->words[i] + key->len <= mn->len; i++) {
+    if (mn->fold[mn->words[i]] == key->fold[0] &&
+        !memcmp(mn->fold + mn->words[i], key->fold, key->len))
+      return 1;
+  }
+  return 0;
+}
+
+/** Is a name one of an object's aliases?
+ * This gives the same answer as check_alias() on an exit's name or on
+ * an exit or player's ALIAS attribute.
+ * \param mn the object's match name.
+ * \param key the name.
+ * \retval 1 name is one of the aliases.
+ * \retval 0 it isn't, or the object can't have aliases.
+ */
+int
+match_name_alias(const MATCH_NAME *mn, const MATCH_KEY *key)
+{
+  const struct alias_ent *ent;
+  int n;
+
+  if (!mn)
+    return 0;
+
+  /* check_alias() wants name to be a prefix of the alias, followed only
+   * by whitespace. Equal trimmed lengths and hashes narrow it down to
+   * the right alias; the compare covers name's own trailing spaces. */
+  for (n = 0, ent = mn->ents; n < mn->count; n++, ent++) {
+    if (ent->hash != key->hash || ent->len != key->tlen ||
+        ent->full < key->len)
+      continue;
+    if (!memcmp(mn->text + ent->off, key->fold, key->len))
+      return 1;
+  }
+  return 0;
+}
+
+/** Does a name match one of an object's aliases?
+ * \param thing exit or player to check.
+ * \param name name to look for.
+ * \retval 1 name is one of thing's aliases.
+ * \retval 0 it isn't, or thing can't have aliases.
+ */
+int
+match_alias_set(dbref thing, const char *name)
+{
+  char buff[BUFFER_LEN];
+  MATCH_KEY key;
+
+  if (!IsExit(thing) && !IsPlayer(thing))
+    return 0;
+  if (strlen(name) >= BUFFER_LEN)
+    return 0;
+  match_key_init(&key, name, buff);
+  return match_name_alias(match_name_get(thing), &key);
+}
+
+/** Find the objects in a list that could match a name.
+ * Any object in the list whose name or alias matches name exactly, or
+ * that string_match() would match when partial is set, plus abs if it's
+ * in the list, ends up in mcands, in the order DOLIST() would visit them.
+ * Objects that can't match are left out; objects that only look like
+ * they could (stale entries) may be left in.
+ * \param container object whose list to search.
+ * \param kind MIDX_CONTENTS or MIDX_EXITS, optionally with MIDX_ALWAYS.
+ * \param name name being matched.
+ * \param partial true to include partial name matches.
+ * \param abs dbref being matched, or NOTHING.
+ * \param mcands where to put the candidates. Free with
+ *  match_candidates_free().
+ * \return number of candidates, or -1 if the list isn't indexed and must
+ *  be scanned.
+ */
+int
+match_index_lookup(dbref container, int kind, const char *name, int partial,
+                   dbref abs, MATCH_CANDIDATES *mcands)
+{
+  char key[BUFFER_LEN];
+  struct midx *idx;
+  struct midx_bucket *b;
+  size_t len;
+  int i, j, always;
+
+  always = kind & MIDX_ALWAYS;
+  kind &= ~MIDX_ALWAYS;
+  mcands->list = mcands->local;
+  mcands->count = 0;
+  mcands->size = MATCH_CANDIDATES_LOCAL;
+
+  if (!RealGoodObject(container) || kind < 0 || kind >= MIDX_KINDS)
+    return -1;
+  idx = midx_get(container, kind, always);
+  if (!idx)
+    return -1;
+
+  midx_fold(name, strlen(name), key);
+  b = hashfind(key, &idx->names);
+  if (b) {
+    for (i = 0; i < b->count; i++)
+      midx_candidate(idx, mcands, b->objs[i]);
+  }
+  if (partial && idx->nwords) {
+    /* string_match() is a prefix match on some word, so fold without
+     * trimming anything */
+    for (len = 0; name[len] && len < BUFFER_LEN - 1; len++)
+      key[len] = DOWNCASE(name[len]);
+    key[len] = '\0';
+    for (i = midx_word_lower(idx, key);
+         i < idx->nwords && !strncmp(idx->words[i].text, key, len); i++)
+      midx_candidate(idx, mcands, idx->words[i].obj);
+  }
+  if (GoodObject(abs))
+    midx_candidate(idx, mcands, abs);
+
+  if (mcands->count > 1) {
+    qsort(mcands->list, mcands->count, sizeof(struct match_cand),
+          midx_cand_cmp);
+    for (i = j = 1; i < mcands->count; i++) {
+      if (mcands->list[i].obj != mcands->list[j - 1].obj)
+        mcands->list[j++] = mcands->list[i];
+    }
+    mcands->count = j;
+  }
+  return mcands->count;
+}
+
+/** Free the memory used by a candidate list.
+ * \param mcands list filled in by match_index_lookup().
+ */
+void
+match_candidates_free(MATCH_CANDIDATES *mcands)
+{
+  if (mcands->list != mcands->local)
+    mush_free(mcands->list, "midx.candidates");
+  mcands->list = mcands->local;
+  mcands->count = 0;
+}
+
+/* Something changed in container's lists */
+static void
+match_touch(dbref container)
+{
+  struct match_gen *g;
+
+  if (!GoodObject(container))
+    return;
+  if (!match_gens)
+    match_gens = im_new();
+  g = im_find(match_gens, container);
+  if (!g) {
+    g = mush_malloc(sizeof(struct match_gen), "match.gen");
+    im_insert(match_gens, container, g);
+  }
+  g->gen = ++match_gen_last;
+}
+
+/** Get the generation number of a container.
+ * This changes whenever an object enters or leaves the container's
+ * contents or exits, or one of them, or the container itself, is
+ * renamed.
+ * \param container object to check, or NOTHING for the generation of
+ *  player names.
+ * \return the generation number.
+ */
+unsigned int
+match_generation(dbref container)
+{
+  struct match_gen *g;
+
+  if (container == NOTHING)
+    return match_player_gen;
+  if (!match_gens || !(g = im_find(match_gens, container)))
+    return 0;
+  return g->gen;
+}
+
+/** Tell the index an object has moved.
+ * Call after thing has been unlinked from from's list and pushed onto
+ * to's. For exits, from and to are the old and new source rooms.
+ * \param thing object that moved.
+ * \param from old location, or NOTHING.
+ * \param to new location, or NOTHING.
+ */
+void
+match_index_moved(dbref thing, dbref from, dbref to)
+{
+  struct midx *idx;
+  dbref head;
+  int kind;
+
+  if (!GoodObject(thing))
+    return;
+  kind = IsExit(thing) ? MIDX_EXITS : MIDX_CONTENTS;
+  match_touch(from);
+  match_touch(to);
+  if (IsPlayer(thing) && !GoodObject(from))
+    match_player_gen = ++match_gen_last;     /* a new player */
+
+  if (GoodObject(from) && (idx = midx_find(from, kind))) {
+    if (idx->small) {
+      midx_drop(idx);
+    } else {
+      midx_remove(idx, thing);
+      if (idx->head == thing) {
+        head = MIDX_HEAD(from, kind);
+        if (from == to && head == thing)
+          idx->head = Next(thing);
+        else if (!GoodObject(head) || im_exists(idx->members, head))
+          idx->head = head;
+        else
+          midx_drop(idx);
+      }
+    }
+  }
+
+  if (GoodObject(to) && (idx = midx_find(to, kind))) {
+    if (idx->small) {
+      midx_drop(idx);
+    } else if (MIDX_HEAD(to, kind) == thing && Next(thing) == idx->head) {
+      midx_insert(idx, thing, ++idx->top);
+      idx->head = thing;
+    }
+    /* Otherwise midx_sync() will pick it up */
+  }
+}
+
+/** Tell the index an object's name or ALIAS attribute has changed.
+ * \param thing object that was renamed.
+ */
+void
+match_index_renamed(dbref thing)
+{
+  struct midx *idx;
+  struct midx_entry *e;
+  dbref container;
+  int kind;
+
+  if (!GoodObject(thing))
+    return;
+  mname_forget(thing);
+  if (IsExit(thing)) {
+    kind = MIDX_EXITS;
+    container = Source(thing);
+  } else {
+    kind = MIDX_CONTENTS;
+    container = Location(thing);
+  }
+  match_touch(thing);
+  match_touch(container);
+  if (IsPlayer(thing))
+    match_player_gen = ++match_gen_last;
+  if (!GoodObject(container) || !(idx = midx_find(container, kind)) ||
+      idx->small)
+    return;
+  e = im_find(idx->members, thing);
+  if (!e)
+    return;
+  midx_unlink(idx, e);
+  midx_free_keys(e);
+  midx_make_keys(e);
+  midx_link(idx, e);
+}
+
+/** Tell the index an object is going away.
+ * Drops any indexes of thing's own lists, and thing from the index of
+ * the list it's in.
+ * \param thing object being destroyed.
+ */
+void
+match_index_destroyed(dbref thing)
+{
+  struct midx *idx;
+  int kind;
+
+  if (!GoodObject(thing))
+    return;
+  mname_forget(thing);
+  match_touch(thing);
+  if (IsPlayer(thing))
+    match_player_gen = ++match_gen_last;
+  for (kind = 0; kind < MIDX_KINDS; kind++) {
+    if ((idx = midx_find(thing, kind)))
+      midx_drop(idx);
+  }
+  if (IsExit(thing))
+    match_index_moved(thing, Source(thing), NOTHING);
+  else
+    match_index_moved(thing, Location(thing), NOTHING);
+}
@@ -0,0 +1,96 @@
+/**
+ * \file match_index.h
+ *
+ * \brief Per-container name indexes and alias sets for the matcher.
+ *
+ * \verbatim
+ * The server must tell the index about changes it can't see for itself:
+ *
+ *  match_index_moved(thing, from, to)  - after moveto() and friends
+ *                                        have relinked thing, and after
+ *                                        an exit is opened (from is
+ *                                        NOTHING) or re-sourced
+ *  match_index_renamed(thing)          - after set_name(), and after
+ *                                        the ALIAS attribute changes
+ *  match_index_destroyed(thing)        - before an object is recycled
+ *  match_cycle_end()                   - at the end of each command or
+ *                                        queue entry
+ *  match_cache_clear()                 - as soon as flags, locks,
+ *                                        parents or owners change
+ *
+ * HOOKS at the top of the tree has the server call sites.
+ * \endverbatim
+ */
+
+#ifndef __MATCH_INDEX_H
+#define __MATCH_INDEX_H
+
+#include <stddef.h>
+
+#include "conf.h"
+#include "dbdefs.h"
+
+/* Lists with fewer objects than this are cheaper to scan than to index */
+#define MATCH_INDEX_MIN 32
+
+/* Which list of a container is indexed */
+#define MIDX_CONTENTS 0
+#define MIDX_EXITS 1
+#define MIDX_KINDS 2
+/* Or'd with the kind: index the list however short it is. For lists that
+ * are searched on every command, like the master room's exits. */
+#define MIDX_ALWAYS 0x100
+
+#define MATCH_CANDIDATES_LOCAL 16
+
+/** One possible match, as handed back by match_index_lookup() */
+struct match_cand {
+  dbref obj;        /**< The object */
+  unsigned int seq; /**< Its position; higher is closer to the list head */
+};
+
+/** The objects in a list that might match a name, in list order */
+typedef struct match_candidates {
+  struct match_cand *list; /**< Candidates, head of the list first */
+  int count;               /**< Number of candidates */
+  int size;                /**< Allocated size of list */
+  struct match_cand local[MATCH_CANDIDATES_LOCAL];
+} MATCH_CANDIDATES;
+
+extern int match_index_lookup(dbref container, int kind, const char *name,
+                              int partial, dbref abs,
+                              MATCH_CANDIDATES *mcands);
+extern void match_candidates_free(MATCH_CANDIDATES *mcands);
+extern int match_alias_set(dbref thing, const char *name);
+
+/** An object's name and aliases, folded for matching; see match_index.c */
+typedef struct match_name MATCH_NAME;
+
+/** A name being looked for, folded once for the match_name_*() tests */
+typedef struct match_key {
+  const char *name;   /**< The name */
+  const char *fold;   /**< The name, folded */
+  size_t len;         /**< Its length */
+  size_t tlen;        /**< Its length without trailing whitespace */
+  unsigned int hash;  /**< Hash of the first tlen folded chars */
+} MATCH_KEY;
+
+extern const MATCH_NAME *match_name_get(dbref thing);
+extern void match_key_init(MATCH_KEY *key, const char *name, char *buff);
+extern int match_name_exact(const MATCH_NAME *mn, const MATCH_KEY *key);
+extern int match_name_partial(const MATCH_NAME *mn, const MATCH_KEY *key);
+extern int match_name_alias(const MATCH_NAME *mn, const MATCH_KEY *key);
+
+extern unsigned int match_generation(dbref container);
+
+/* In match.c, alongside match_result_relative() */
+extern void match_result_batch(dbref who, dbref where, const char **names,
+                               int n, int type, long flags, dbref *results);
+
+extern void match_index_moved(dbref thing, dbref from, dbref to);
+extern void match_index_renamed(dbref thing);
+extern void match_index_destroyed(dbref thing);
+extern void match_cycle_end(void);
+extern void match_cache_clear(void);
+
+#endif                          /* __MATCH_INDEX_H */
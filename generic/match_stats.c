@@ -0,0 +1,267 @@
+/**
+ * \file match_stats.c
+ *
+ * \brief Counters and latency histograms for the matcher.
+ *
+ * \verbatim
+ * match.c counts the objects it tests in each scope, can_interact() and
+ * lock checks, and how each name came out, and times each match, with a
+ * histogram for each set of MAT_* flags it's called with. The flag sets
+ * get MATCH_STATS_FLAGSETS histograms between them; any more share the
+ * last one. Batches count their names and outcomes but aren't timed.
+ *
+ *  matchstats()          - general counters
+ *  matchstats(scopes)    - <scope>:<searched>/<indexed>/<objects tested>
+ *  matchstats(latency)   - <flags>:<calls>:<p50>:<p90>:<p99>:<max>, in ns
+ *  matchstats(on|off)    - start or stop counting
+ *  matchstats(reset)     - zero everything
+ *
+ * match_bench_report() formats a histogram of timings the same way
+ * for test/bench.c, which times matches against synthetic worlds:
+ *
+ *  calls:<n> ns:<total> per_sec:<n> p50:<ns> p90:<ns> p99:<ns> max:<ns>
+ * \endverbatim
+ */
+
+#include "copyrite.h"
+#include "match_stats.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "function.h"
+#include "match.h"
+#include "match_index.h"
+#include "scratch.h"
+#include "mushdb.h"
+#include "parse.h"
+#include "strutil.h"
+
+#define MATCH_STATS_FLAGSETS 32
+
+/** Are we counting? */
+int match_stats_on = 0;
+/** The counters */
+struct match_stats match_stats;
+
+/* Latency for one set of flags */
+struct match_latency {
+  int used;
+  long flags;
+  struct match_hist hist;
+};
+
+static struct match_latency match_latency[MATCH_STATS_FLAGSETS];
+
+static const char *match_scope_names[MSCOPE_COUNT] = {
+  "possession", "possession_generic", "neighbor", "neighbor_generic",
+  "zone_exits", "global_exits", "exits", "container", "carried_exits"
+};
+
+/** Read the clock for timing matches.
+ * \return monotonic time in nanoseconds.
+ */
+uint64_t
+match_stats_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** Add a sample to a histogram.
+ * \param h the histogram.
+ * \param ns the sample, in nanoseconds.
+ */
+void
+match_hist_add(struct match_hist *h, uint64_t ns)
+{
+  int b = 0;
+
+  while (b < MATCH_HIST_BUCKETS - 1 && (ns >> (b + 1)))
+    b++;
+  h->counts[b]++;
+  h->n++;
+  h->total += ns;
+  if (ns > h->max)
+    h->max = ns;
+}
+
+/** Estimate a percentile from a histogram.
+ * \param h the histogram.
+ * \param pct the percentile, 0 to 100.
+ * \return the top of the bucket the percentile falls in, or the largest
+ *  sample if that's smaller.
+ */
+uint64_t
+match_hist_pct(const struct match_hist *h, int pct)
+{
+  unsigned long want, seen = 0;
+  uint64_t top;
+  int b;
+
+  if (!h->n)
+    return 0;
+  want = (h->n * (unsigned long) pct + 99) / 100;
+  if (!want)
+    want = 1;
+  for (b = 0; b < MATCH_HIST_BUCKETS; b++) {
+    seen += h->counts[b];
+    if (seen >= want)
+      break;
+  }
+  top = ((uint64_t) 2 << b) - 1;
+  return top < h->max ? top : h->max;
+}
+
+/** Record how long a match took.
+ * \param flags the MAT_* flags it was called with.
+ * \param ns how long it took.
+ */
+void
+match_stats_latency(long flags, uint64_t ns)
+{
+  struct match_latency *ml;
+  unsigned int i, n;
+
+  n = (unsigned int) flags * 2654435761U % MATCH_STATS_FLAGSETS;
+  for (i = 0; i < MATCH_STATS_FLAGSETS - 1; i++) {
+    ml = &match_latency[(n + i) % (MATCH_STATS_FLAGSETS - 1)];
+    if (!ml->used) {
+      ml->used = 1;
+      ml->flags = flags;
+    }
+    if (ml->flags == flags) {
+      match_hist_add(&ml->hist, ns);
+      return;
+    }
+  }
+  /* Out of room; they all share the last one */
+  ml = &match_latency[MATCH_STATS_FLAGSETS - 1];
+  ml->used = 1;
+  ml->flags = -1;
+  match_hist_add(&ml->hist, ns);
+}
+
+/** Count how a name came out.
+ * \param result the match, AMBIGUOUS or NOTHING.
+ */
+void
+match_stats_result(dbref result)
+{
+  if (GoodObject(result))
+    match_stats.found++;
+  else if (result == AMBIGUOUS)
+    match_stats.ambiguous++;
+  else
+    match_stats.nothing++;
+}
+
+static void
+match_stats_reset(void)
+{
+  memset(&match_stats, 0, sizeof match_stats);
+  memset(match_latency, 0, sizeof match_latency);
+}
+
+#define STAT(name, value)                     \
+  do {                                        \
+    safe_chr(' ', buff, bp);                  \
+    safe_str(name, buff, bp);                 \
+    safe_chr(':', buff, bp);                  \
+    safe_format(buff, bp, "%lu", (value));    \
+  } while (0)
+
+/* matchstats([on|off|reset|scopes|latency]) */
+FUNCTION(fun_matchstats)
+{
+  struct match_latency *ml;
+  char *start = *bp;
+  int i;
+
+  if (!Wizard(executor)) {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+
+  if (nargs == 0 || !*args[0]) {
+    safe_str(match_stats_on ? "on" : "off", buff, bp);
+    STAT("calls", match_stats.calls);
+    STAT("batches", match_stats.batches);
+    STAT("names", match_stats.names);
+    STAT("cached", match_stats.cached);
+    STAT("early", match_stats.early);
+    STAT("found", match_stats.found);
+    STAT("ambiguous", match_stats.ambiguous);
+    STAT("nothing", match_stats.nothing);
+    STAT("interact", match_stats.interact);
+    STAT("locks", match_stats.locks);
+  } else if (!strcasecmp(args[0], "on")) {
+    match_stats_on = 1;
+  } else if (!strcasecmp(args[0], "off")) {
+    match_stats_on = 0;
+  } else if (!strcasecmp(args[0], "reset")) {
+    match_stats_reset();
+  } else if (!strcasecmp(args[0], "scopes")) {
+    for (i = 0; i < MSCOPE_COUNT; i++) {
+      if (*bp != start)
+        safe_chr(' ', buff, bp);
+      safe_str(match_scope_names[i], buff, bp);
+      safe_format(buff, bp, ":%lu/%lu/%lu", match_stats.searched[i],
+                  match_stats.indexed[i], match_stats.examined[i]);
+    }
+  } else if (!strcasecmp(args[0], "latency")) {
+    for (i = 0; i < MATCH_STATS_FLAGSETS; i++) {
+      ml = &match_latency[i];
+      if (!ml->used || !ml->hist.n)
+        continue;
+      if (*bp != start)
+        safe_chr(' ', buff, bp);
+      if (ml->flags == -1)
+        safe_str("other", buff, bp);
+      else
+        safe_format(buff, bp, "%lx", (unsigned long) ml->flags);
+      safe_format(buff, bp, ":%lu:%llu:%llu:%llu:%llu", ml->hist.n,
+                  (unsigned long long) match_hist_pct(&ml->hist, 50),
+                  (unsigned long long) match_hist_pct(&ml->hist, 90),
+                  (unsigned long long) match_hist_pct(&ml->hist, 99),
+                  (unsigned long long) ml->hist.max);
+    }
+  } else {
+    safe_str(T("#-1 INVALID ARGUMENT"), buff, bp);
+  }
+}
+
+#undef STAT
+
+/** Report the results of a benchmark.
+ * \param h histogram of the time each call took.
+ * \param buff buffer to write the report to.
+ * \param bp pointer into buff.
+ */
+void
+match_bench_report(const struct match_hist *h, char *buff, char **bp)
+{
+  unsigned long per_sec = 0;
+
+  if (h->total)
+    per_sec = (unsigned long) ((double) h->n * 1e9 / (double) h->total);
+  safe_format(buff, bp,
+              "calls:%lu ns:%llu per_sec:%lu p50:%llu p90:%llu p99:%llu max:%llu",
+              h->n, (unsigned long long) h->total, per_sec,
+              (unsigned long long) match_hist_pct(h, 50),
+              (unsigned long long) match_hist_pct(h, 90),
+              (unsigned long long) match_hist_pct(h, 99),
+              (unsigned long long) h->max);
+}
+
+/** Add the matchstats() function. Call from local_startup(). */
+void
+match_stats_init(void)
+{
+  function_add("MATCHSTATS", fun_matchstats, 0, 1, FN_REG);
+}
@@ -0,0 +1,79 @@
+/**
+ * \file match_stats.h
+ *
+ * \brief Counters and latency histograms for the matcher.
+ *
+ * \verbatim
+ * Off by default. When off, each place that counts something costs one
+ * test of match_stats_on. Wizards turn them on and read them with
+ * matchstats(); see match_stats.c. match_stats_init() should be
+ * called from local_startup() to add the function.
+ * \endverbatim
+ */
+
+#ifndef __MATCH_STATS_H
+#define __MATCH_STATS_H
+
+#include <stdint.h>
+
+#include "conf.h"
+#include "dbdefs.h"
+
+/* The lists match.c searches for names, in the order they're searched */
+enum match_scope {
+  MSCOPE_POSSESSION,            /* where's contents */
+  MSCOPE_POSSESSION_GENERIC,    /* where's GENERIC stacks */
+  MSCOPE_NEIGHBOR,              /* loc's contents */
+  MSCOPE_NEIGHBOR_GENERIC,      /* loc's GENERIC stacks */
+  MSCOPE_ZONE_EXITS,            /* exits in loc's zone master room */
+  MSCOPE_GLOBAL_EXITS,          /* exits in the master room */
+  MSCOPE_EXITS,                 /* loc's exits */
+  MSCOPE_CONTAINER,             /* loc and the objects after it */
+  MSCOPE_CARRIED_EXITS,         /* where's exits */
+  MSCOPE_COUNT
+};
+
+/* Histogram bucket b holds times from 2^b to 2^(b+1)-1 nanoseconds */
+#define MATCH_HIST_BUCKETS 40
+
+/** A latency histogram */
+struct match_hist {
+  unsigned long n;              /**< Number of samples */
+  uint64_t total;               /**< Sum of the samples, in ns */
+  uint64_t max;                 /**< Largest sample */
+  unsigned long counts[MATCH_HIST_BUCKETS];
+};
+
+/** What the matcher counts */
+struct match_stats {
+  unsigned long calls;          /**< Single matches */
+  unsigned long batches;        /**< match_result_batch() calls */
+  unsigned long names;          /**< Names looked up, single or batched */
+  unsigned long cached;         /**< Names answered from the result cache */
+  unsigned long early;          /**< Settled without searching lists */
+  unsigned long found;          /**< Names that matched an object */
+  unsigned long ambiguous;      /**< ... that were ambiguous */
+  unsigned long nothing;        /**< ... that matched nothing */
+  unsigned long interact;       /**< can_interact() checks */
+  unsigned long locks;          /**< could_doit() checks in choose_thing() */
+  unsigned long searched[MSCOPE_COUNT]; /**< Times a scope was searched */
+  unsigned long indexed[MSCOPE_COUNT];  /**< ... through the name index */
+  unsigned long examined[MSCOPE_COUNT]; /**< Objects tested in a scope */
+};
+
+extern int match_stats_on;
+extern struct match_stats match_stats;
+
+/* Count one of something, if the stats are on. Usable as an expression. */
+#define MATCH_STAT_INC(field) ((void) (match_stats_on && match_stats.field++))
+
+extern uint64_t match_stats_clock(void);
+extern void match_stats_latency(long flags, uint64_t ns);
+extern void match_stats_result(dbref result);
+extern void match_hist_add(struct match_hist *h, uint64_t ns);
+extern uint64_t match_hist_pct(const struct match_hist *h, int pct);
+extern void match_bench_report(const struct match_hist *h, char *buff,
+                               char **bp);
+extern void match_stats_init(void);
+
+#endif                          /* __MATCH_STATS_H */
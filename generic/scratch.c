@@ -0,0 +1,163 @@
+/**
+ * \file scratch.c
+ *
+ * \brief Scratch memory that lasts until the end of the command.
+ *
+ * \verbatim
+ * The arena is a list of chunks. Allocations come from the current chunk
+ * until it's full, and then from the next one, which is made if there
+ * isn't one big enough. Chunks are kept around between commands, up to
+ * SCRATCH_KEEP of them, so a server that's warmed up doesn't allocate
+ * at all.
+ * \endverbatim
+ */
+
+#include "copyrite.h"
+#include "scratch.h"
+
+#include <string.h>
+
+#include "conf.h"
+#include "mymalloc.h"
+
+#define SCRATCH_CHUNK 65536     /* Usual size of a chunk */
+#define SCRATCH_KEEP 4          /* Chunks kept by scratch_reset() */
+#define SCRATCH_ALIGN 16        /* Alignment of allocations */
+
+#define SCRATCH_ROUND(n) (((n) + SCRATCH_ALIGN - 1) & ~((size_t) SCRATCH_ALIGN - 1))
+
+/* One chunk of the arena */
+struct scratch_chunk {
+  struct scratch_chunk *next;
+  size_t size;                  /* bytes in data */
+  size_t used;                  /* bytes handed out */
+  char *data;
+};
+
+static struct scratch_chunk *scratch_head = NULL;
+static struct scratch_chunk *scratch_cur = NULL;
+
+static struct scratch_chunk *scratch_new_chunk(size_t size);
+
+static struct scratch_chunk *
+scratch_new_chunk(size_t size)
+{
+  struct scratch_chunk *c;
+  size_t head = SCRATCH_ROUND(sizeof(struct scratch_chunk));
+
+  c = mush_malloc(head + size, "scratch.chunk");
+  c->next = NULL;
+  c->size = size;
+  c->used = 0;
+  c->data = (char *) c + head;
+  return c;
+}
+
+/** Allocate scratch memory.
+ * The memory is good until the end of the command, or until a
+ * scratch_release() to a mark made before it.
+ * \param len number of bytes wanted.
+ * \return pointer to the memory, aligned for any type.
+ */
+void *
+scratch_alloc(size_t len)
+{
+  struct scratch_chunk *c, *n;
+  void *p;
+
+  len = SCRATCH_ROUND(len ? len : 1);
+
+  if (!scratch_head)
+    scratch_head = scratch_cur = scratch_new_chunk(SCRATCH_CHUNK);
+
+  c = scratch_cur;
+  if (c->size - c->used < len) {
+    /* Move on to the next chunk, or put a big enough one in front of it */
+    n = c->next;
+    if (!n || n->size < len) {
+      n = scratch_new_chunk(len > SCRATCH_CHUNK ? len : SCRATCH_CHUNK);
+      n->next = c->next;
+      c->next = n;
+    }
+    n->used = 0;
+    scratch_cur = c = n;
+  }
+
+  p = c->data + c->used;
+  c->used += len;
+  return p;
+}
+
+/** Copy a string into scratch memory.
+ * \param s string to copy.
+ * \return the copy.
+ */
+char *
+scratch_strdup(const char *s)
+{
+  size_t len = strlen(s) + 1;
+  char *p;
+
+  p = scratch_alloc(len);
+  memcpy(p, s, len);
+  return p;
+}
+
+/** Remember the current point in the arena.
+ * \param mark where to remember it.
+ */
+void
+scratch_mark(SCRATCH_MARK *mark)
+{
+  mark->chunk = scratch_cur;
+  mark->used = scratch_cur ? scratch_cur->used : 0;
+}
+
+/** Give back everything allocated since a mark was made.
+ * \param mark the mark, from scratch_mark().
+ */
+void
+scratch_release(const SCRATCH_MARK *mark)
+{
+  struct scratch_chunk *c = mark->chunk;
+
+  if (!c) {
+    /* Nothing had been allocated yet */
+    c = scratch_head;
+    if (!c)
+      return;
+    c->used = 0;
+  } else {
+    c->used = mark->used;
+  }
+  scratch_cur = c;
+}
+
+/** Give back all scratch memory.
+ * Call at the end of each command or queue entry.
+ */
+void
+scratch_reset(void)
+{
+  struct scratch_chunk *c, *next;
+  int kept;
+
+  if (!scratch_head)
+    return;
+
+  /* Keep the first few chunks of the usual size, drop the rest */
+  kept = 1;
+  for (c = scratch_head; c->next; ) {
+    next = c->next;
+    if (kept < SCRATCH_KEEP && next->size == SCRATCH_CHUNK) {
+      kept++;
+      c = next;
+    } else {
+      c->next = next->next;
+      mush_free(next, "scratch.chunk");
+    }
+  }
+
+  scratch_head->used = 0;
+  scratch_cur = scratch_head;
+}
@@ -0,0 +1,36 @@
+/**
+ * \file scratch.h
+ *
+ * \brief Scratch memory that lasts until the end of the command.
+ *
+ * \verbatim
+ * A bump-pointer arena for temporary strings and arrays. Allocating is a
+ * pointer bump and there's no freeing: everything is given back at once
+ * by scratch_reset(), which the server must call at the end of each
+ * command or queue entry. Code that allocates a lot in a loop can give
+ * back what it used with scratch_mark()/scratch_release().
+ *
+ * Scratch memory is for results that only need to last as long as the
+ * command that asked for them; never keep a pointer to it anywhere that
+ * outlives that.
+ * \endverbatim
+ */
+
+#ifndef __SCRATCH_H
+#define __SCRATCH_H
+
+#include <stddef.h>
+
+/** A point in the arena to go back to; see scratch_mark() */
+typedef struct scratch_mark {
+  void *chunk;   /**< Chunk in use when the mark was made */
+  size_t used;   /**< How much of it was used */
+} SCRATCH_MARK;
+
+extern void *scratch_alloc(size_t len);
+extern char *scratch_strdup(const char *s);
+extern void scratch_mark(SCRATCH_MARK *mark);
+extern void scratch_release(const SCRATCH_MARK *mark);
+extern void scratch_reset(void);
+
+#endif                          /* __SCRATCH_H */
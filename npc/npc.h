@@ -1,12 +1,15 @@
 #ifndef __NPC_H
 #define __NPC_H
 
+#include <stdint.h>
+
 #include "conf.h"
 #include "externs.h"
 #include "strutil.h"
 #include "attrib.h"
 #include "parse.h"
 #include "notify.h"
+#include "flag_handle.h"
 
 
 #define NPC_TIMEOUT		300
@@ -14,14 +17,96 @@
 #define NPC_NODE_DEFAULT	"0"
 
 #define NPC_MAX_NODES		512
+#define NPC_MAX_REPLIES		64	/* replies compiled for one node */
+#define NPC_REPLY_MATCH_LIMIT	100000	/* pcre2 match limit for replies */
+#define NPC_DIALOG_ATTRS	4096	/* _DIALOG`#n names kept built */
 
-#define IsNPC(x) (has_flag_by_name(x, "NPC", NOTYPE))
+extern FLAG_HANDLE npc_flag;
+#define IsNPC(x) (Has_Flag_Handle(x, &npc_flag))
 
 /* NPC Dialog */
 extern const char *npc_get_player_node(dbref, dbref);
 extern void npc_set_player_node(dbref, dbref, const char *);
+extern const char *npc_dialog_attr(dbref);
+extern void npc_dialog_forget(dbref);
+extern void npc_dialog_changed(dbref);
+extern int npc_match_reply(dbref, dbref, const char *);
+extern void npc_node_text(dbref, dbref, const char *, char *, char **);
 
 /* NPC Action Sequencing */
 extern const char *npc_findpath(dbref, dbref, dbref);
+extern const char *npc_findpath_unbudgeted(dbref, dbref, dbref);
+
+/* NPC Room Graph */
+#define NPC_GRAPH_FILE		"data/npcgraph.bin"
+#define NPC_GRAPH_COSTS		0x1	/* exit costs, from NPC`COST */
+#define NPC_GRAPH_COORDS	0x2	/* room coordinates, from NPC`COORD */
+
+typedef struct npc_edge NPC_EDGE;
+
+/* int32_t rather than dbref, since the graph file is laid out the same */
+struct npc_edge {
+  int32_t exit;
+  int32_t dest;
+};
+
+extern void npc_graph_timer(void);
+extern void npc_graph_changed(dbref);
+extern void npc_graph_moved(dbref, dbref, dbref);
+extern void npc_graph_begin(void);
+extern int npc_graph_visit(dbref);
+extern int npc_graph_visited(dbref);
+extern int npc_exit_visible(dbref, dbref, dbref);
+extern int npc_graph_edges(dbref, const NPC_EDGE **, const unsigned int **);
+extern int npc_graph_dump(const char *, int);
+extern int npc_graph_load(const char *);
+extern void npc_graph_stats(char *, char **);
+
+/* NPC Budgets */
+#define NPC_BUDGET_INTERVAL	1	/* seconds */
+#define NPC_BUDGET_ROOMS	4096	/* rooms an npc can expand per interval */
+#define NPC_BUDGET_QUERIES	20	/* path searches per npc per interval */
+#define NPC_BUDGET_DIALOG_NS	5000000	/* dialog matching per npc per interval */
+#define NPC_BUDGET_OWNER	4	/* an owner's budget, in npcs */
+
+/* what npc_budget_report() sorts by */
+#define NPC_USAGE_ROOMS		0
+#define NPC_USAGE_QUERIES	1
+#define NPC_USAGE_DIALOG	2
+#define NPC_USAGE_DENIED	3
+
+typedef struct npc_budget NPC_BUDGET;
+
+/* a path search's budget, see npc_budget_begin() */
+struct npc_budget {
+  struct npc_usage *npc;
+  struct npc_usage *owner;
+  long rooms_left;
+  long rooms_start;
+};
+
+/* count a room expanded, true if the search is over budget */
+#define NPC_BUDGET_ROOM(b)	(--(b)->rooms_left < 0)
+
+extern int npc_budget_begin(NPC_BUDGET *, dbref);
+extern void npc_budget_end(NPC_BUDGET *);
+extern int npc_budget_dialog_ok(dbref);
+extern void npc_budget_dialog(dbref, uint64_t);
+extern void npc_budget_report(int, int, char *, char **);
+extern void npc_budget_reset(void);
+extern void npc_budget_forget(dbref);
+
+/* NPC Crowd Routing */
+#define NPC_CROWD_STEPS		32	/* time steps planned ahead */
+#define NPC_CROWD_STEP		1	/* seconds per step */
+#define NPC_CROWD_WEIGHT	2	/* cost of each npc already in a room */
+#define NPC_CROWD_NODES		(NPC_MAX_NODES * 4)
+
+extern const char *npc_findpath_crowd(dbref, dbref, dbref);
+extern void npc_crowd_release(dbref);
+
+/* NPC Functions */
+extern void npc_init(void);
+extern void npc_destroyed(dbref);
 
 #endif /* __NPC_H */
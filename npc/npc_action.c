@@ -3,6 +3,7 @@
  * sequence actions for npcs, including movement and pathfinding */
 
 #include "npc.h"
+#include "scratch.h"
 
 typedef struct DB_NODE dbnode;
 
@@ -12,57 +13,102 @@ struct DB_NODE {
   dbref loc;
 };
 
+static const char *npc_path_result(const SCRATCH_MARK *mark, const char *buff);
+static const char *npc_search(dbref player, dbref start, dbref stop,
+                              NPC_BUDGET *budget);
+
+/* give back the search's scratch memory and return the result in a new copy */
+static const char *npc_path_result(const SCRATCH_MARK *mark, const char *buff)
+{
+  scratch_release(mark);
+  return scratch_strdup(buff);
+}
+
+/*
+ * find a path for an npc, charged to its budget and its owner's
+ * the result is returned in scratch memory, good until the end of the command
+ */
+
+const char *npc_findpath(dbref player, dbref start, dbref stop)
+{
+  NPC_BUDGET budget;
+  const char *path;
+  
+  if (!npc_budget_begin(&budget, player))
+    return scratch_strdup("#-1 BUDGET EXCEEDED");
+  
+  path = npc_search(player, start, stop, &budget);
+  npc_budget_end(&budget);
+  return path;
+}
+
+/* find a path without charging anyone, for benchmarks */
+const char *npc_findpath_unbudgeted(dbref player, dbref start, dbref stop)
+{
+  return npc_search(player, start, stop, NULL);
+}
+
 /* 
  * implement pathfinding algorithm, return list of exits from start to dest
  * while there are rooms on the frontier
  *   visit the next item from the frontier
  *   if this is our destination, stop and build the path string
  *   else go through each of the exits and add the destination to the frontier
+ * the result is returned in scratch memory, good until the end of the command
  */
  
-const char *npc_findpath(dbref player, dbref start, dbref stop)
+static const char *npc_search(dbref player, dbref start, dbref stop,
+                              NPC_BUDGET *budget)
 {
-  static char buff[BUFFER_LEN];
+  char buff[BUFFER_LEN];
   char *bp;
   int i;
   int num_visited, num_frontier, cur_frontier;
-  dbnode frontier[NPC_MAX_NODES];
-  dbnode visited[NPC_MAX_NODES];
+  SCRATCH_MARK mark;
+  dbnode *frontier;
+  dbnode *visited;
   dbnode *vp, *fp, *cur, *last;
   dbref dest, thing;
-  int num_skips, has_visited, found_path;
+  const NPC_EDGE *edges;
+  int num_edges, e;
+  int num_skips, found_path;
   
   bp = buff;
+  scratch_mark(&mark);
   
   /* make sure we have a valid start and stop */
   if (!RealGoodObject(start) || !IsRoom(start))
   {
     safe_str("#-1 INVALID START", buff, &bp);
     *bp = '\0';
-    return buff;
+    return npc_path_result(&mark, buff);
   }
   
   if (!RealGoodObject(stop) || !IsRoom(stop))
   {
     safe_str("#-1 INVALID STOP", buff, &bp);
     *bp = '\0';
-    return buff;
+    return npc_path_result(&mark, buff);
   }
   
   if (start == stop)
   {
     safe_str("#-1 SAME LOCATION", buff, &bp);
     *bp = '\0';
-    return buff;
+    return npc_path_result(&mark, buff);
   }
   
   if (!RealGoodObject(player))
   {
     safe_str("#-1 INVALID PLAYER", buff, &bp);
     *bp = '\0';
-    return buff;
+    return npc_path_result(&mark, buff);
   }
   
+  npc_graph_begin();
+  frontier = scratch_alloc(NPC_MAX_NODES * sizeof(dbnode));
+  visited = scratch_alloc(NPC_MAX_NODES * sizeof(dbnode));
+  
   fp = frontier;
   num_frontier = 1;
   cur_frontier = 0;
@@ -73,6 +119,7 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
   fp->ptr = NULL;
   fp->dir = NOTHING;
   fp->loc = start;
+  npc_graph_visit(start);
   
   found_path = 0;
   last = NULL;
@@ -86,12 +133,20 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
     if (!RealGoodObject(cur->loc) || !IsRoom(cur->loc))
       continue;
     
+    /* stop if the npc has used up the rooms it may expand */
+    if (budget && NPC_BUDGET_ROOM(budget))
+    {
+      safe_str("#-1 BUDGET EXCEEDED", buff, &bp);
+      *bp = '\0';
+      return npc_path_result(&mark, buff);
+    }
+    
     /* add it to the list of visited rooms */
     if (num_visited >= NPC_MAX_NODES)
     {
       safe_str("#-1 VISIT MEMORY EXHAUSTED", buff, &bp);
       *bp = '\0';
-      return buff;
+      return npc_path_result(&mark, buff);
     }
     vp = &(visited[num_visited++]);
     vp->loc = cur->loc;
@@ -99,35 +154,22 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
     vp->dir = cur->dir;
     
     /* iterate list of exits and add destinations to frontier */
-    DOLIST_VISIBLE(thing, Exits(vp->loc), player)
+    num_edges = npc_graph_edges(vp->loc, &edges, NULL);
+    for (e = 0; e < num_edges; ++e)
     {
-      dest = Destination(thing);
+      thing = edges[e].exit;
+      dest = edges[e].dest;
       if (!RealGoodObject(dest) || !IsRoom(dest))
         continue;
       
-      /* make sure player can go through the exit */
+      /* make sure player can see and go through the exit */
+      if (!npc_exit_visible(player, thing, vp->loc))
+        continue;
       if (!could_doit(player, thing, NULL))
         continue;
       
       /* check if we have already visited this room, skip it if so */
-      has_visited = 0;
-      for (i = 0; i < num_visited; ++i)
-      {
-        if (dest == visited[i].loc)
-        {
-          has_visited = 1;
-          break;
-        }
-      }
-      for (i = cur_frontier; i < num_frontier; ++i)
-      {
-        if (dest == frontier[i].loc)
-        {
-          has_visited = 1;
-          break;
-        }
-      }
-      if (has_visited)
+      if (!npc_graph_visit(dest))
       {
         continue;
       }
@@ -141,7 +183,7 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
         {
           safe_str("#-1 LAST MEMORY EXHAUSTED", buff, &bp);
           *bp = '\0';
-          return buff;
+          return npc_path_result(&mark, buff);
         }
         last = &(visited[num_visited++]);
         last->loc = dest;
@@ -157,7 +199,7 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
       {
         safe_str("#-1 FRONTIER MEMORY EXHAUSTED", buff, &bp);
         *bp = '\0';
-        return buff;
+        return npc_path_result(&mark, buff);
       }
       fp = &(frontier[num_frontier++]);
       fp->loc = dest;
@@ -196,11 +238,11 @@ const char *npc_findpath(dbref player, dbref start, dbref stop)
   {
     safe_str("#-1 PATH NOT FOUND", buff, &bp);
     *bp = '\0';
-    return buff;
+    return npc_path_result(&mark, buff);
   }
   
   *bp = '\0';
-  return buff;
+  return npc_path_result(&mark, buff);
 
 }
 
@@ -0,0 +1,291 @@
+
+/* npc_budget.c
+ * limits on how much pathfinding and dialog matching npcs can do */
+
+#include "npc.h"
+#include "intmap.h"
+#include "mymalloc.h"
+
+#include <limits.h>
+#include <string.h>
+
+/*
+ * each npc, and each owner of npcs, has a record of what it has used in
+ * the current interval and in total. a path search charges a query to
+ * the npc and its owner when it starts, and the rooms it expanded when
+ * it ends; in between, the rooms it may still expand are a counter in
+ * the NPC_BUDGET, so the check in the search loop is a decrement.
+ * dialog matching is charged by the nanosecond, after the fact, and an
+ * npc that has used up its time is refused until the next interval.
+ * owners get NPC_BUDGET_OWNER npcs' worth, shared between their npcs
+ */
+
+struct npc_usage {
+  struct npc_usage *next;
+  struct npc_usage *prev;
+  dbref who;
+  time_t window;                /* start of the current interval */
+  long rooms;                   /* used in the current interval */
+  long queries;
+  uint64_t dialog_ns;
+  unsigned long total_rooms;    /* used since startup or npcbudget(reset) */
+  unsigned long total_queries;
+  uint64_t total_dialog_ns;
+  unsigned long denied;         /* requests refused */
+};
+
+static intmap *npc_usages = NULL;
+static struct npc_usage *npc_usage_list = NULL;
+
+static struct npc_usage *npc_usage_get(dbref who);
+static int npc_usage_cmp(const void *a, const void *b);
+
+/* find or make the record for an npc or owner, rolled into this interval */
+static struct npc_usage *npc_usage_get(dbref who)
+{
+  struct npc_usage *u;
+  
+  if (!npc_usages)
+    npc_usages = im_new();
+  
+  u = im_find(npc_usages, who);
+  if (!u)
+  {
+    u = mush_malloc(sizeof(struct npc_usage), "npc.usage");
+    memset(u, 0, sizeof(struct npc_usage));
+    u->who = who;
+    u->window = mudtime;
+    u->next = npc_usage_list;
+    if (npc_usage_list)
+      npc_usage_list->prev = u;
+    npc_usage_list = u;
+    im_insert(npc_usages, who, u);
+  }
+  
+  if (mudtime - u->window >= NPC_BUDGET_INTERVAL)
+  {
+    u->window = mudtime;
+    u->rooms = 0;
+    u->queries = 0;
+    u->dialog_ns = 0;
+  }
+  return u;
+}
+
+/*
+ * start a path search for an npc. returns 0, and charges nothing, if
+ * the npc or its owner has used up its queries or rooms for this
+ * interval. otherwise the search must call npc_budget_end() when done
+ */
+int npc_budget_begin(NPC_BUDGET *b, dbref npc)
+{
+  long left, owner_left;
+  
+  b->npc = b->owner = NULL;
+  b->rooms_left = b->rooms_start = LONG_MAX;
+  if (!RealGoodObject(npc))
+    return 1;
+  
+  b->npc = npc_usage_get(npc);
+  if (Owner(npc) != npc)
+    b->owner = npc_usage_get(Owner(npc));
+  
+  left = NPC_BUDGET_ROOMS - b->npc->rooms;
+  if (b->npc->queries >= NPC_BUDGET_QUERIES || left <= 0)
+  {
+    b->npc->denied++;
+    return 0;
+  }
+  if (b->owner)
+  {
+    owner_left = NPC_BUDGET_OWNER * NPC_BUDGET_ROOMS - b->owner->rooms;
+    if (b->owner->queries >= NPC_BUDGET_OWNER * NPC_BUDGET_QUERIES ||
+        owner_left <= 0)
+    {
+      b->npc->denied++;
+      b->owner->denied++;
+      return 0;
+    }
+    if (owner_left < left)
+      left = owner_left;
+  }
+  
+  b->npc->queries++;
+  b->npc->total_queries++;
+  if (b->owner)
+  {
+    b->owner->queries++;
+    b->owner->total_queries++;
+  }
+  b->rooms_left = b->rooms_start = left;
+  return 1;
+}
+
+/* charge the rooms a search expanded, and note if it ran out */
+void npc_budget_end(NPC_BUDGET *b)
+{
+  long used;
+  
+  if (!b->npc)
+    return;
+  
+  used = b->rooms_start - (b->rooms_left < 0 ? 0 : b->rooms_left);
+  b->npc->rooms += used;
+  b->npc->total_rooms += used;
+  if (b->rooms_left < 0)
+    b->npc->denied++;
+  if (b->owner)
+  {
+    b->owner->rooms += used;
+    b->owner->total_rooms += used;
+    if (b->rooms_left < 0)
+      b->owner->denied++;
+  }
+  b->npc = b->owner = NULL;
+}
+
+/* can an npc do any more dialog matching this interval */
+int npc_budget_dialog_ok(dbref npc)
+{
+  struct npc_usage *u;
+  
+  if (!RealGoodObject(npc))
+    return 1;
+  
+  u = npc_usage_get(npc);
+  if (u->dialog_ns >= NPC_BUDGET_DIALOG_NS)
+  {
+    u->denied++;
+    return 0;
+  }
+  if (Owner(npc) != npc)
+  {
+    u = npc_usage_get(Owner(npc));
+    if (u->dialog_ns >= NPC_BUDGET_OWNER * NPC_BUDGET_DIALOG_NS)
+    {
+      u->denied++;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* charge an npc for time spent matching dialog */
+void npc_budget_dialog(dbref npc, uint64_t ns)
+{
+  struct npc_usage *u;
+  
+  if (!RealGoodObject(npc))
+    return;
+  
+  u = npc_usage_get(npc);
+  u->dialog_ns += ns;
+  u->total_dialog_ns += ns;
+  if (Owner(npc) != npc)
+  {
+    u = npc_usage_get(Owner(npc));
+    u->dialog_ns += ns;
+    u->total_dialog_ns += ns;
+  }
+}
+
+/* what npc_budget_report() sorts by */
+static int npc_usage_sort = NPC_USAGE_ROOMS;
+
+static int npc_usage_cmp(const void *a, const void *b)
+{
+  const struct npc_usage *ua = *(const struct npc_usage * const *) a;
+  const struct npc_usage *ub = *(const struct npc_usage * const *) b;
+  uint64_t va, vb;
+  
+  switch (npc_usage_sort)
+  {
+  case NPC_USAGE_QUERIES:
+    va = ua->total_queries;
+    vb = ub->total_queries;
+    break;
+  case NPC_USAGE_DIALOG:
+    va = ua->total_dialog_ns;
+    vb = ub->total_dialog_ns;
+    break;
+  case NPC_USAGE_DENIED:
+    va = ua->denied;
+    vb = ub->denied;
+    break;
+  default:
+    va = ua->total_rooms;
+    vb = ub->total_rooms;
+    break;
+  }
+  if (va != vb)
+    return va > vb ? -1 : 1;
+  return ua->who - ub->who;
+}
+
+/*
+ * list the top count users, by the given NPC_USAGE_ total, as
+ * #dbref:rooms:queries:dialog_ns:denied separated by spaces
+ */
+void npc_budget_report(int count, int sort, char *buff, char **bp)
+{
+  struct npc_usage **list;
+  struct npc_usage *u;
+  int n, i;
+  
+  n = 0;
+  for (u = npc_usage_list; u; u = u->next)
+    n++;
+  if (!n || count < 1)
+    return;
+  
+  list = mush_malloc(n * sizeof(struct npc_usage *), "npc.usage_list");
+  n = 0;
+  for (u = npc_usage_list; u; u = u->next)
+    list[n++] = u;
+  npc_usage_sort = sort;
+  qsort(list, n, sizeof(struct npc_usage *), npc_usage_cmp);
+  
+  for (i = 0; i < n && i < count; ++i)
+  {
+    u = list[i];
+    if (i)
+      safe_chr(' ', buff, bp);
+    safe_format(buff, bp, "#%d:%lu:%lu:%llu:%lu", u->who, u->total_rooms,
+                u->total_queries, (unsigned long long) u->total_dialog_ns,
+                u->denied);
+  }
+  mush_free(list, "npc.usage_list");
+}
+
+/* forget everything used so far */
+void npc_budget_reset(void)
+{
+  struct npc_usage *u, *next;
+  
+  for (u = npc_usage_list; u; u = next)
+  {
+    next = u->next;
+    im_delete(npc_usages, u->who);
+    mush_free(u, "npc.usage");
+  }
+  npc_usage_list = NULL;
+}
+
+/* forget what an npc or owner has used, for when it's destroyed, so
+ * the dbref doesn't inherit it when it's recycled */
+void npc_budget_forget(dbref who)
+{
+  struct npc_usage *u;
+  
+  if (!npc_usages || !(u = im_find(npc_usages, who)))
+    return;
+  
+  if (u->prev)
+    u->prev->next = u->next;
+  else
+    npc_usage_list = u->next;
+  if (u->next)
+    u->next->prev = u->prev;
+  im_delete(npc_usages, who);
+  mush_free(u, "npc.usage");
+}
@@ -0,0 +1,338 @@
+
+/* npc_crowd.c
+ * routing crowds of npcs around each other */
+
+#include "npc.h"
+#include "scratch.h"
+#include "intmap.h"
+#include "mymalloc.h"
+
+#include <string.h>
+
+/*
+ * crowd routing plans a path with dijkstra instead of a breadth first
+ * search, and charges for each room the number of npcs that have already
+ * planned to be there when this one would be, so a crowd spreads out
+ * over the other ways round instead of piling into one room.
+ *
+ * plans are kept as reservations of a room at a time step, an npc being
+ * taken to move one room per step. the table is a ring of
+ * NPC_CROWD_STEPS slots, one per step, each counting npcs by room; a
+ * slot is cleared when it's reused for a later step, so old plans
+ * expire on their own. a search for an npc first gives back what its
+ * last plan still holds, so it isn't routed around itself and a search
+ * that fails leaves nothing behind; replanning every tick only touches
+ * the rooms on the two paths
+ */
+
+typedef struct crowd_node cnode;
+
+struct crowd_node {
+  int parent;                   /* index of the node we came from, or -1 */
+  dbref dir;                    /* exit taken to get here */
+  dbref loc;
+  unsigned long cost;
+  int hops;
+};
+
+struct crowd_plan {
+  long step;                    /* the step the first room is for */
+  int count;
+  dbref rooms[NPC_CROWD_STEPS];
+};
+
+static uint16_t *crowd_counts[NPC_CROWD_STEPS];
+static long crowd_steps[NPC_CROWD_STEPS];    /* which step each slot holds */
+static size_t crowd_size = 0;
+static intmap *crowd_plans = NULL;
+
+static long npc_crowd_now(void);
+static unsigned int npc_crowd_count(dbref room, long step);
+static void npc_crowd_reserve(dbref room, long step, int delta);
+static void npc_crowd_plan(dbref npc, const cnode *pool, int last);
+static void npc_heap_push(int *heap, int *n, const cnode *pool, int node);
+static int npc_heap_pop(int *heap, int *n, const cnode *pool);
+
+static long npc_crowd_now(void)
+{
+  return (long) (mudtime / NPC_CROWD_STEP);
+}
+
+/* how many npcs plan to be in a room at a step */
+static unsigned int npc_crowd_count(dbref room, long step)
+{
+  int slot = step % NPC_CROWD_STEPS;
+  
+  if (crowd_steps[slot] != step || (size_t) room >= crowd_size)
+    return 0;
+  return crowd_counts[slot][room];
+}
+
+/* add or take away an npc's reservation of a room at a step */
+static void npc_crowd_reserve(dbref room, long step, int delta)
+{
+  long now = npc_crowd_now();
+  size_t want;
+  int slot, i;
+  
+  if (step < now || step >= now + NPC_CROWD_STEPS)
+    return;
+  slot = step % NPC_CROWD_STEPS;
+  
+  if ((size_t) room >= crowd_size)
+  {
+    if (delta < 0)
+      return;
+    want = db_top > room ? db_top : room + 1;
+    for (i = 0; i < NPC_CROWD_STEPS; ++i)
+    {
+      crowd_counts[i] = mush_realloc(crowd_counts[i], want * sizeof(uint16_t),
+                                     "npc.crowd_counts");
+      memset(crowd_counts[i] + crowd_size, 0,
+             (want - crowd_size) * sizeof(uint16_t));
+    }
+    crowd_size = want;
+  }
+  
+  if (crowd_steps[slot] != step)
+  {
+    /* the slot still holds an old step, nothing in it counts any more */
+    if (delta < 0)
+      return;
+    memset(crowd_counts[slot], 0, crowd_size * sizeof(uint16_t));
+    crowd_steps[slot] = step;
+  }
+  
+  if (delta < 0)
+  {
+    if (crowd_counts[slot][room])
+      crowd_counts[slot][room]--;
+  }
+  else if (crowd_counts[slot][room] < UINT16_MAX)
+    crowd_counts[slot][room]++;
+}
+
+/* give back what an npc's plan still holds */
+void npc_crowd_release(dbref npc)
+{
+  struct crowd_plan *plan;
+  int i;
+  
+  if (!crowd_plans)
+    return;
+  plan = im_find(crowd_plans, npc);
+  if (!plan)
+    return;
+  
+  for (i = 0; i < plan->count; ++i)
+    npc_crowd_reserve(plan->rooms[i], plan->step + i, -1);
+  im_delete(crowd_plans, npc);
+  mush_free(plan, "npc.crowd_plan");
+}
+
+/* reserve the rooms on a path for an npc, from the node it ends at */
+static void npc_crowd_plan(dbref npc, const cnode *pool, int last)
+{
+  struct crowd_plan *plan;
+  int i, n;
+  
+  npc_crowd_release(npc);
+  if (!crowd_plans)
+    crowd_plans = im_new();
+  
+  plan = mush_malloc(sizeof(struct crowd_plan), "npc.crowd_plan");
+  plan->step = npc_crowd_now();
+  
+  /* the path is found backwards, rooms past the end of the ring aren't kept */
+  n = pool[last].hops + 1;
+  plan->count = n < NPC_CROWD_STEPS ? n : NPC_CROWD_STEPS;
+  for (i = last; i >= 0; i = pool[i].parent)
+  {
+    if (pool[i].hops < plan->count)
+      plan->rooms[pool[i].hops] = pool[i].loc;
+  }
+  
+  for (i = 0; i < plan->count; ++i)
+    npc_crowd_reserve(plan->rooms[i], plan->step + i, 1);
+  im_insert(crowd_plans, npc, plan);
+}
+
+static void npc_heap_push(int *heap, int *n, const cnode *pool, int node)
+{
+  int i, up;
+  
+  for (i = (*n)++; i > 0; i = up)
+  {
+    up = (i - 1) / 2;
+    if (pool[heap[up]].cost <= pool[node].cost)
+      break;
+    heap[i] = heap[up];
+  }
+  heap[i] = node;
+}
+
+static int npc_heap_pop(int *heap, int *n, const cnode *pool)
+{
+  int top, node, i, child;
+  
+  top = heap[0];
+  node = heap[--(*n)];
+  for (i = 0; (child = 2 * i + 1) < *n; i = child)
+  {
+    if (child + 1 < *n && pool[heap[child + 1]].cost < pool[heap[child]].cost)
+      child++;
+    if (pool[node].cost <= pool[heap[child]].cost)
+      break;
+    heap[i] = heap[child];
+  }
+  heap[i] = node;
+  return top;
+}
+
+/*
+ * find a path for an npc around the paths other npcs have planned, and
+ * plan it, charged to the npc's budget like npc_findpath(). going
+ * through an exit costs its NPC`COST, plus NPC_CROWD_WEIGHT for each npc
+ * planning to be in the room it leads to when this one would get there.
+ * the result is returned in scratch memory, good until the end of the command
+ */
+
+const char *npc_findpath_crowd(dbref player, dbref start, dbref stop)
+{
+  char buff[BUFFER_LEN];
+  char *bp;
+  SCRATCH_MARK mark;
+  NPC_BUDGET budget;
+  cnode *pool, *cur, *np;
+  int *heap;
+  int num_pool, num_heap, num_visited, node, last, i, e, num_edges;
+  const NPC_EDGE *edges;
+  const unsigned int *costs;
+  dbref dest, thing;
+  long now;
+  
+  bp = buff;
+  scratch_mark(&mark);
+  
+  /* the old plan goes whether or not there's a new one */
+  npc_crowd_release(player);
+  
+  if (!RealGoodObject(start) || !IsRoom(start))
+    safe_str("#-1 INVALID START", buff, &bp);
+  else if (!RealGoodObject(stop) || !IsRoom(stop))
+    safe_str("#-1 INVALID STOP", buff, &bp);
+  else if (start == stop)
+    safe_str("#-1 SAME LOCATION", buff, &bp);
+  else if (!RealGoodObject(player))
+    safe_str("#-1 INVALID PLAYER", buff, &bp);
+  else if (!npc_budget_begin(&budget, player))
+    safe_str("#-1 BUDGET EXCEEDED", buff, &bp);
+  if (bp != buff)
+  {
+    *bp = '\0';
+    scratch_release(&mark);
+    return scratch_strdup(buff);
+  }
+  
+  npc_graph_begin();
+  pool = scratch_alloc(NPC_CROWD_NODES * sizeof(cnode));
+  heap = scratch_alloc(NPC_CROWD_NODES * sizeof(int));
+  now = npc_crowd_now();
+  
+  pool[0].parent = -1;
+  pool[0].dir = NOTHING;
+  pool[0].loc = start;
+  pool[0].cost = 0;
+  pool[0].hops = 0;
+  num_pool = 1;
+  num_heap = 0;
+  npc_heap_push(heap, &num_heap, pool, 0);
+  num_visited = 0;
+  last = -1;
+  
+  /* take the cheapest room off the heap until it's the one we want */
+  while (num_heap > 0)
+  {
+    node = npc_heap_pop(heap, &num_heap, pool);
+    cur = &(pool[node]);
+    
+    /* a room can be on the heap more than once, the first is cheapest */
+    if (!npc_graph_visit(cur->loc))
+      continue;
+    
+    if (cur->loc == stop)
+    {
+      last = node;
+      break;
+    }
+    
+    if (++num_visited > NPC_MAX_NODES)
+    {
+      safe_str("#-1 VISIT MEMORY EXHAUSTED", buff, &bp);
+      break;
+    }
+    if (NPC_BUDGET_ROOM(&budget))
+    {
+      safe_str("#-1 BUDGET EXCEEDED", buff, &bp);
+      break;
+    }
+    
+    num_edges = npc_graph_edges(cur->loc, &edges, &costs);
+    for (e = 0; e < num_edges; ++e)
+    {
+      thing = edges[e].exit;
+      dest = edges[e].dest;
+      if (!RealGoodObject(dest) || !IsRoom(dest) || npc_graph_visited(dest))
+        continue;
+      
+      /* make sure player can see and go through the exit */
+      if (!npc_exit_visible(player, thing, cur->loc))
+        continue;
+      if (!could_doit(player, thing, NULL))
+        continue;
+      
+      if (num_pool >= NPC_CROWD_NODES)
+      {
+        safe_str("#-1 FRONTIER MEMORY EXHAUSTED", buff, &bp);
+        break;
+      }
+      np = &(pool[num_pool]);
+      np->parent = node;
+      np->dir = thing;
+      np->loc = dest;
+      np->hops = cur->hops + 1;
+      np->cost = cur->cost + costs[e] +
+        NPC_CROWD_WEIGHT * npc_crowd_count(dest, now + np->hops);
+      npc_heap_push(heap, &num_heap, pool, num_pool++);
+    }
+    if (bp != buff)
+      break;
+  }
+  npc_budget_end(&budget);
+  
+  if (bp == buff && last < 0)
+    safe_str("#-1 PATH NOT FOUND", buff, &bp);
+  if (bp != buff)
+  {
+    *bp = '\0';
+    scratch_release(&mark);
+    return scratch_strdup(buff);
+  }
+  
+  npc_crowd_plan(player, pool, last);
+  
+  /* walk the path backwards, cache exits reusing heap, write them forwards */
+  i = pool[last].hops;
+  for (node = last; pool[node].parent >= 0; node = pool[node].parent)
+    heap[--i] = pool[node].dir;
+  for (i = 0; i < pool[last].hops; ++i)
+  {
+    if (i)
+      safe_chr(' ', buff, &bp);
+    safe_str(unparse_dbref(heap[i]), buff, &bp);
+  }
+  *bp = '\0';
+  
+  scratch_release(&mark);
+  return scratch_strdup(buff);
+}
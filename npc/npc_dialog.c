@@ -3,19 +3,637 @@
  * Code for npc dialog and activities */
 
 #include "npc.h"
+#include "scratch.h"
+#include "intmap.h"
+#include "mymalloc.h"
+#include "match_stats.h"
+#include "htab.h"
 
-int npc_match_reply(dbref npc, dbref player, const char *reply)
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#ifndef PCRE2_CODE_UNIT_WIDTH
+#define PCRE2_CODE_UNIT_WIDTH 8
+#endif
+#include <pcre2.h>
+
+FLAG_HANDLE npc_flag = FLAG_HANDLE_INIT("NPC", NOTYPE);
+
+/* _DIALOG`#n attribute names, by player */
+static intmap *npc_dialog_attrs = NULL;
+
+/* get the name of the attribute holding a player's dialog state
+ * the name only depends on the dbref, so it's built once and kept, for
+ * up to NPC_DIALOG_ATTRS players; past that it's built every time in
+ * scratch memory, and only good until the end of the command */
+const char *npc_dialog_attr(dbref player)
 {
-  char node[BUFFER_LEN];
   char buff[BUFFER_LEN];
-  char list[BUFFER_LEN];
-  char *bp, *np, *lp, *rp;
+  char *bp, *name;
+  
+  if (!npc_dialog_attrs)
+    npc_dialog_attrs = im_new();
+  
+  name = im_find(npc_dialog_attrs, player);
+  if (name)
+    return name;
+  
+  bp = buff;
+  safe_str("_DIALOG`", buff, &bp);
+  safe_dbref(player, buff, &bp);
+  *bp = '\0';
+  
+  if (im_count(npc_dialog_attrs) >= NPC_DIALOG_ATTRS)
+    return scratch_strdup(buff);
+  name = mush_strdup(buff, "npc.dialog_attr");
+  im_insert(npc_dialog_attrs, player, name);
+  return name;
+}
+
+/*
+ * replies a player can make at a dialog node are the attributes
+ * DIALOG`<node>`REPLY`<next>, each holding a pattern for the reply. it is
+ * a wildcard pattern like a $-command's, or a regular expression if the
+ * attribute is set REGEXP, case sensitive only if it's also set CASE.
+ * the first one that matches, in attribute name order, moves the player
+ * on to node <next> and queues DIALOG`<next>`ACTION on the npc, with the
+ * wildcard's matches in %0-%9, or the regular expression's match in %0
+ * and its captures in %1-%9.
+ *
+ * all of a node's patterns are compiled into one regular expression,
+ *   ^(?|(*MARK:0)wild0\z|(*MARK:1).*?\K(?:regexp1)|...)
+ * so a reply is matched against all of them at once. the branch reset
+ * group numbers each pattern's captures from 1, and the mark says which
+ * one matched. a node whose patterns won't go together, because the
+ * whole is too long, or their named groups clash, or a regexp sets a
+ * mark of its own that would be taken for ours, has each pattern
+ * compiled on its own instead, and tried in turn.
+ *
+ * a player reaching a node is shown its DIALOG`<node>`TEXT, as the npc
+ * would have evaluated it with the player as enactor. most of it doesn't
+ * need the evaluator, so the text is sorted into one of
+ *   NPC_TEXT_STATIC    nothing the evaluator would change, shown as is
+ *   NPC_TEXT_TEMPLATE  the same, but for %n, %N and %#, which are
+ *                      filled in from a list of parts
+ *   NPC_TEXT_DYNAMIC   anything else, evaluated every time
+ * text is only static if it has none of % [ \ { } ( and no spaces the
+ * evaluator would squeeze out: doubled, leading or trailing.
+ *
+ * compiled replies and text are kept by npc and node. when one of an
+ * npc's DIALOG` attributes changes, npc_dialog_changed() marks all its
+ * nodes stale, and they're thrown away the next time one is looked up,
+ * so nodes that @wipe or a rewrite has removed don't stay behind. an
+ * npc that's destroyed has its nodes freed straight away
+ */
+
+#define NPC_TEXT_STATIC		0
+#define NPC_TEXT_TEMPLATE	1
+#define NPC_TEXT_DYNAMIC	2
+
+/* one piece of template text: a literal, or a substitution */
+struct npc_text_part {
+  const char *lit;              /* points into the node's text */
+  int len;
+  char sub;                     /* 'n', 'N' or '#', or 0 for a literal */
+};
+
+struct npc_node {
+  int compiled;                 /* NPC_COMPILED_ parts done */
+  pcre2_code *re;               /* all the patterns, or NULL */
+  pcre2_code **res;             /* each pattern, if they aren't in re */
+  pcre2_match_data *md;
+  int count;
+  char **next;                  /* the node each reply moves on to */
+  char *wild;                   /* set for replies that are wildcards */
+  char *text;                   /* the TEXT attribute, or NULL */
+  int kind;                     /* NPC_TEXT_ */
+  int nparts;
+  struct npc_text_part *parts;  /* for NPC_TEXT_TEMPLATE */
+};
+
+#define NPC_COMPILED_REPLIES	0x1
+#define NPC_COMPILED_TEXT	0x2
+
+/* an npc's compiled nodes */
+struct npc_dialog {
+  int stale;                    /* set when its DIALOG` attributes change */
+  HASHTAB nodes;                /* node name -> struct npc_node */
+};
+
+/* one REPLY attribute, as collected by npc_reply_helper() */
+struct npc_reply_attr {
+  const char *next;
+  const char *pattern;
+  int regexp;
+  int nocase;
+};
+
+struct npc_reply_list {
+  int prefix;                   /* length of DIALOG`<node>`REPLY` */
+  int count;
+  struct npc_reply_attr attrs[NPC_MAX_REPLIES];
+};
+
+static intmap *npc_dialogs = NULL;
+static pcre2_match_context *npc_reply_ctx = NULL;
+
+static struct npc_node *npc_node_find(dbref npc, const char *node);
+static void npc_node_free(void *data);
+static int npc_reply_helper(dbref player, dbref thing, dbref parent,
+                            const char *pattern, ATTR *atr, void *args);
+static void npc_reply_wild(const char *wild, char *buff, char **bp);
+static int npc_reply_marks(const char *re);
+static void npc_reply_clear(struct npc_node *nd);
+static void npc_reply_compile(struct npc_node *nd,
+                              const struct npc_reply_list *list);
+static void npc_reply_compile_each(struct npc_node *nd, char **bodies);
+static int npc_reply_match(struct npc_node *nd, const char *reply, int *rc);
+static struct npc_node *npc_node_replies(dbref npc, const char *node);
+static void npc_text_clear(struct npc_node *nd);
+static void npc_text_compile(struct npc_node *nd, const char *text);
+
+/* find the cache entry for a node, making an empty one if there isn't
+ * one, and throwing away the npc's nodes first if they're stale */
+static struct npc_node *npc_node_find(dbref npc, const char *node)
+{
+  struct npc_dialog *dl;
+  struct npc_node *nd;
   
-  lp = list;
-  rp = reply;
+  if (!npc_dialogs) {
+    npc_dialogs = im_new();
+    npc_reply_ctx = pcre2_match_context_create(NULL);
+    pcre2_set_match_limit(npc_reply_ctx, NPC_REPLY_MATCH_LIMIT);
+  }
   
-  /* run through reply and copy words to list */
+  dl = im_find(npc_dialogs, npc);
+  if (!dl) {
+    dl = mush_malloc(sizeof(struct npc_dialog), "npc.dialog");
+    dl->stale = 0;
+    hash_init(&dl->nodes, 16, npc_node_free);
+    im_insert(npc_dialogs, npc, dl);
+  } else if (dl->stale) {
+    hashfree(&dl->nodes);
+    hash_init(&dl->nodes, 16, npc_node_free);
+    dl->stale = 0;
+  }
   
+  nd = hashfind(node, &dl->nodes);
+  if (!nd) {
+    nd = mush_malloc(sizeof(struct npc_node), "npc.node");
+    memset(nd, 0, sizeof(struct npc_node));
+    hashadd(node, nd, &dl->nodes);
+  }
+  return nd;
+}
+
+static void npc_node_free(void *data)
+{
+  struct npc_node *nd = data;
+  
+  npc_reply_clear(nd);
+  npc_text_clear(nd);
+  mush_free(nd, "npc.node");
+}
+
+/* an npc's DIALOG` attributes have changed, compile its nodes again
+ * when they're next used. they aren't freed here, since this can be
+ * called while one of them is in use, by softcode in a node's TEXT */
+void npc_dialog_changed(dbref npc)
+{
+  struct npc_dialog *dl;
+  
+  if (npc_dialogs && (dl = im_find(npc_dialogs, npc)))
+    dl->stale = 1;
+}
+
+/* forget what's kept for dialog with an object that's being destroyed */
+void npc_dialog_forget(dbref thing)
+{
+  struct npc_dialog *dl;
+  char *name;
+  
+  if (npc_dialogs && (dl = im_find(npc_dialogs, thing))) {
+    im_delete(npc_dialogs, thing);
+    hashfree(&dl->nodes);
+    mush_free(dl, "npc.dialog");
+  }
+  if (!npc_dialog_attrs)
+    return;
+  name = im_find(npc_dialog_attrs, thing);
+  if (name) {
+    im_delete(npc_dialog_attrs, thing);
+    mush_free(name, "npc.dialog_attr");
+  }
+}
+
+/* collect the REPLY attributes of a node */
+static int npc_reply_helper(dbref player __attribute__ ((__unused__)),
+                            dbref thing __attribute__ ((__unused__)),
+                            dbref parent __attribute__ ((__unused__)),
+                            const char *pattern __attribute__ ((__unused__)),
+                            ATTR *atr, void *args)
+{
+  struct npc_reply_list *list = args;
+  struct npc_reply_attr *ra;
+  
+  if (list->count >= NPC_MAX_REPLIES)
+    return 0;
+  
+  ra = &(list->attrs[list->count++]);
+  ra->next = AL_NAME(atr) + list->prefix;
+  ra->pattern = scratch_strdup(atr_value(atr));
+  ra->regexp = (AL_FLAGS(atr) & AF_REGEXP) != 0;
+  ra->nocase = !ra->regexp || !(AL_FLAGS(atr) & AF_CASE);
+  return 1;
+}
+
+/* turn a wildcard pattern into a regular expression, each * and ? capturing */
+static void npc_reply_wild(const char *wild, char *buff, char **bp)
+{
+  const char *p;
+  
+  for (p = wild; *p; p++) {
+    if (*p == '*')
+      safe_str("(.*?)", buff, bp);
+    else if (*p == '?')
+      safe_str("(.)", buff, bp);
+    else {
+      if (*p == '\\' && p[1])
+        p++;
+      if (!isalnum((unsigned char) *p) && *p != ' ')
+        safe_chr('\\', buff, bp);
+      safe_chr(*p, buff, bp);
+    }
+  }
+}
+
+/* could a regexp set a mark: (*MARK:x), (*:x), or any other verb with a
+ * name, some of which set one too. it may be a false alarm, like a
+ * "(*X:" in a class, which only costs the node its combined pattern */
+static int npc_reply_marks(const char *re)
+{
+  const char *p, *q;
+  
+  for (p = re; (p = strstr(p, "(*")); p += 2) {
+    for (q = p + 2; isupper((unsigned char) *q) || *q == '_'; q++)
+      ;
+    if (*q == ':')
+      return 1;
+  }
+  return 0;
+}
+
+/* forget a node's compiled replies */
+static void npc_reply_clear(struct npc_node *nd)
+{
+  int i;
+  
+  for (i = 0; i < nd->count; i++) {
+    mush_free(nd->next[i], "npc.reply_next");
+    if (nd->res && nd->res[i])
+      pcre2_code_free(nd->res[i]);
+  }
+  if (nd->res)
+    mush_free(nd->res, "npc.reply_res");
+  if (nd->next)
+    mush_free(nd->next, "npc.reply_nexts");
+  if (nd->wild)
+    mush_free(nd->wild, "npc.reply_wild");
+  if (nd->md)
+    pcre2_match_data_free(nd->md);
+  if (nd->re)
+    pcre2_code_free(nd->re);
+  nd->re = NULL;
+  nd->res = NULL;
+  nd->md = NULL;
+  nd->count = 0;
+  nd->next = NULL;
+  nd->wild = NULL;
+}
+
+/* compile the replies of a node into one pattern, or each on its own if
+ * that can't be done */
+static void npc_reply_compile(struct npc_node *nd,
+                              const struct npc_reply_list *list)
+{
+  const struct npc_reply_attr *ra;
+  char **bodies;
+  char *pattern, *bp;
+  char one[BUFFER_LEN];
+  char mark[32];
+  char *op;
+  pcre2_code *re;
+  PCRE2_SIZE erroffset;
+  size_t len;
+  int errcode, i, n, apart;
+  
+  npc_reply_clear(nd);
+  if (!list->count)
+    return;
+  
+  nd->next = mush_malloc(list->count * sizeof(char *), "npc.reply_nexts");
+  nd->wild = mush_malloc(list->count, "npc.reply_wild");
+  bodies = scratch_alloc(list->count * sizeof(char *));
+  
+  /* each reply's pattern on its own, leaving out any that doesn't
+   * compile, or doesn't fit, instead of losing them all */
+  n = 0;
+  apart = 0;
+  for (i = 0; i < list->count; i++) {
+    ra = &(list->attrs[i]);
+    
+    op = one;
+    if (ra->regexp)
+      safe_format(one, &op, ".*?\\K(?:%s%s\\E)", ra->nocase ? "(?i)" : "",
+                  ra->pattern);
+    else {
+      safe_str("(?i:", one, &op);
+      npc_reply_wild(ra->pattern, one, &op);
+      safe_str(")\\z", one, &op);
+    }
+    *op = '\0';
+    if (op >= one + BUFFER_LEN - 1)
+      continue;
+    if (ra->regexp) {
+      re = pcre2_compile((PCRE2_SPTR) ra->pattern, PCRE2_ZERO_TERMINATED, 0,
+                         &errcode, &erroffset, NULL);
+      if (!re)
+        continue;
+      pcre2_code_free(re);
+      if (npc_reply_marks(ra->pattern))
+        apart = 1;
+    }
+    
+    bodies[n] = scratch_strdup(one);
+    nd->next[n] = mush_strdup(ra->next, "npc.reply_next");
+    nd->wild[n] = !ra->regexp;
+    n++;
+  }
+  nd->count = n;
+  if (!n)
+    return;
+  
+  if (!apart) {
+    /* all of them in one, if it fits */
+    pattern = scratch_alloc(BUFFER_LEN * 2);
+    bp = pattern;
+    memcpy(bp, "^(?|", 4);
+    bp += 4;
+    for (i = 0; i < n; i++) {
+      snprintf(mark, sizeof mark, "%s(*MARK:%d)", i ? "|" : "", i);
+      len = strlen(bodies[i]);
+      if ((bp - pattern) + strlen(mark) + len + 2 >= BUFFER_LEN * 2)
+        break;
+      memcpy(bp, mark, strlen(mark));
+      bp += strlen(mark);
+      memcpy(bp, bodies[i], len);
+      bp += len;
+    }
+    *bp++ = ')';
+    *bp = '\0';
+    if (i == n)
+      nd->re = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED, 0,
+                             &errcode, &erroffset, NULL);
+    if (nd->re) {
+      pcre2_jit_compile(nd->re, PCRE2_JIT_COMPLETE);
+      nd->md = pcre2_match_data_create_from_pattern(nd->re, NULL);
+      return;
+    }
+  }
+  
+  npc_reply_compile_each(nd, bodies);
+}
+
+/* compile each of a node's replies on its own, for when they won't go
+ * into one pattern. a reply whose pattern doesn't compile this way
+ * never matches */
+static void npc_reply_compile_each(struct npc_node *nd, char **bodies)
+{
+  char *pattern;
+  PCRE2_SIZE erroffset;
+  uint32_t captures, most;
+  int errcode, i;
+  
+  nd->res = mush_malloc(nd->count * sizeof(pcre2_code *), "npc.reply_res");
+  most = 0;
+  for (i = 0; i < nd->count; i++) {
+    pattern = scratch_alloc(strlen(bodies[i]) + 8);
+    sprintf(pattern, "^(?:%s)", bodies[i]);
+    nd->res[i] = pcre2_compile((PCRE2_SPTR) pattern, PCRE2_ZERO_TERMINATED,
+                               0, &errcode, &erroffset, NULL);
+    if (!nd->res[i])
+      continue;
+    pcre2_jit_compile(nd->res[i], PCRE2_JIT_COMPLETE);
+    if (!pcre2_pattern_info(nd->res[i], PCRE2_INFO_CAPTURECOUNT, &captures) &&
+        captures > most)
+      most = captures;
+  }
+  nd->md = pcre2_match_data_create(most + 1, NULL);
+}
+
+/* match a reply against a node's replies. returns the first that
+ * matched, or -1, with pcre2_match()'s result for it in rc */
+static int npc_reply_match(struct npc_node *nd, const char *reply, int *rc)
+{
+  PCRE2_SPTR mark;
+  size_t len = strlen(reply);
+  int k;
+  
+  if (nd->re) {
+    *rc = pcre2_match(nd->re, (PCRE2_SPTR) reply, len, 0, 0, nd->md,
+                      npc_reply_ctx);
+    mark = *rc > 0 ? pcre2_get_mark(nd->md) : NULL;
+    k = mark ? atoi((const char *) mark) : -1;
+    return k >= 0 && k < nd->count ? k : -1;
+  }
+  
+  for (k = 0; nd->res && k < nd->count; k++) {
+    if (!nd->res[k])
+      continue;
+    *rc = pcre2_match(nd->res[k], (PCRE2_SPTR) reply, len, 0, 0, nd->md,
+                      npc_reply_ctx);
+    if (*rc > 0)
+      return k;
+  }
+  return -1;
+}
+
+/* get the compiled replies for a node, compiling them if they've changed */
+static struct npc_node *npc_node_replies(dbref npc, const char *node)
+{
+  struct npc_reply_list *list;
+  struct npc_node *nd;
+  char name[BUFFER_LEN];
+  char *bp;
+  
+  nd = npc_node_find(npc, node);
+  if (nd->compiled & NPC_COMPILED_REPLIES)
+    return nd;
+  
+  list = scratch_alloc(sizeof(struct npc_reply_list));
+  bp = name;
+  safe_str("DIALOG`", name, &bp);
+  safe_str(node, name, &bp);
+  safe_str("`REPLY`", name, &bp);
+  list->prefix = bp - name;
+  safe_chr('*', name, &bp);
+  *bp = '\0';
+  list->count = 0;
+  atr_iter_get(GOD, npc, name, 0, 0, npc_reply_helper, list);
+  
+  npc_reply_compile(nd, list);
+  nd->compiled |= NPC_COMPILED_REPLIES;
+  return nd;
+}
+
+/* forget a node's compiled text */
+static void npc_text_clear(struct npc_node *nd)
+{
+  if (nd->parts)
+    mush_free(nd->parts, "npc.text_parts");
+  if (nd->text)
+    mush_free(nd->text, "npc.text");
+  nd->parts = NULL;
+  nd->text = NULL;
+  nd->nparts = 0;
+  nd->kind = NPC_TEXT_STATIC;
+}
+
+/* sort a node's text into static, template or dynamic, see above */
+static void npc_text_compile(struct npc_node *nd, const char *text)
+{
+  struct npc_text_part *part;
+  const char *p, *lit;
+  int subs;
+  
+  npc_text_clear(nd);
+  nd->text = mush_strdup(text, "npc.text");
+  
+  subs = 0;
+  for (p = text; *p; p++) {
+    if (*p == '%' && (p[1] == 'n' || p[1] == 'N' || p[1] == '#')) {
+      subs++;
+      p++;
+    } else if (strchr("%[\\{}(", *p) || (*p == ' ' && p[1] == ' ')) {
+      nd->kind = NPC_TEXT_DYNAMIC;
+      return;
+    }
+  }
+  if (*text == ' ' || (*text && p[-1] == ' ')) {
+    nd->kind = NPC_TEXT_DYNAMIC;
+    return;
+  }
+  if (!subs) {
+    nd->kind = NPC_TEXT_STATIC;
+    return;
+  }
+  
+  /* at most a literal before each substitution, and one after the last */
+  nd->kind = NPC_TEXT_TEMPLATE;
+  nd->parts = mush_malloc((subs * 2 + 1) * sizeof(struct npc_text_part),
+                          "npc.text_parts");
+  lit = nd->text;
+  for (p = nd->text; *p; p++) {
+    if (*p != '%')
+      continue;
+    if (p > lit) {
+      part = &(nd->parts[nd->nparts++]);
+      part->lit = lit;
+      part->len = p - lit;
+      part->sub = 0;
+    }
+    part = &(nd->parts[nd->nparts++]);
+    part->lit = NULL;
+    part->len = 0;
+    part->sub = *++p;
+    lit = p + 1;
+  }
+  if (p > lit) {
+    part = &(nd->parts[nd->nparts++]);
+    part->lit = lit;
+    part->len = p - lit;
+    part->sub = 0;
+  }
+}
+
+/* write out the text of a node for a player, compiling it if it's changed
+ * the npc and player must be good objects, and the npc an npc */
+void npc_node_text(dbref npc, dbref player, const char *node,
+                   char *buff, char **bp)
+{
+  struct npc_node *nd;
+  struct npc_text_part *part;
+  char name[BUFFER_LEN];
+  char *np;
+  const char *sp;
+  ATTR *a;
+  int i;
+  
+  nd = npc_node_find(npc, node);
+  if (!(nd->compiled & NPC_COMPILED_TEXT)) {
+    np = name;
+    safe_str("DIALOG`", name, &np);
+    safe_str(node, name, &np);
+    safe_str("`TEXT", name, &np);
+    *np = '\0';
+    
+    a = atr_get_noparent(npc, name);
+    if (a)
+      npc_text_compile(nd, atr_value(a));
+    else
+      npc_text_clear(nd);
+    nd->compiled |= NPC_COMPILED_TEXT;
+  }
+  if (!nd->text)
+    return;
+  
+  switch (nd->kind) {
+  case NPC_TEXT_STATIC:
+    safe_str(nd->text, buff, bp);
+    break;
+  case NPC_TEXT_TEMPLATE:
+    for (i = 0; i < nd->nparts; i++) {
+      part = &(nd->parts[i]);
+      if (!part->sub)
+        safe_strl(part->lit, part->len, buff, bp);
+      else if (part->sub == '#')
+        safe_dbref(player, buff, bp);
+      else if (part->sub == 'N') {
+        safe_chr(UPCASE(*Name(player)), buff, bp);
+        if (*Name(player))
+          safe_str(Name(player) + 1, buff, bp);
+      } else
+        safe_str(Name(player), buff, bp);
+    }
+    break;
+  default:
+    /* the evaluator may change the attribute, so work from a copy */
+    sp = scratch_strdup(nd->text);
+    process_expression(buff, bp, &sp, npc, npc, player, PE_DEFAULT,
+                       PT_DEFAULT, NULL);
+    break;
+  }
+}
+
+/*
+ * match a player's reply to an npc against the replies for the node the
+ * player is on, move on to the node of the first that matches, and show
+ * the player that node's text
+ * returns 1 if a reply matched, 0 if none did, NPC_NODE_ERROR if the npc
+ * is out of dialog time
+ */
+int npc_match_reply(dbref npc, dbref player, const char *reply)
+{
+  struct npc_node *nd;
+  PE_REGS *pe_regs;
+  PCRE2_SIZE *ovector;
+  SCRATCH_MARK smark;
+  const char *node, *next;
+  char buff[BUFFER_LEN];
+  char *bp;
+  uint64_t begin;
+  int rc, k, i, arg;
   
   if (!RealGoodObject(npc) || !RealGoodObject(player))
     return 0;
@@ -23,21 +641,64 @@ int npc_match_reply(dbref npc, dbref player, const char *reply)
   if (!IsNPC(npc))
     return 0;
   
-  strcpy(node, npc_get_player_node(npc, player));
+  /* an npc that has used up its dialog time waits for the next interval */
+  if (!npc_budget_dialog_ok(npc))
+    return NPC_NODE_ERROR;
+  begin = match_stats_clock();
+  scratch_mark(&smark);
+  
+  node = npc_get_player_node(npc, player);
+  nd = node ? npc_node_replies(npc, node) : NULL;
+  k = nd ? npc_reply_match(nd, reply, &rc) : -1;
+  if (k < 0) {
+    scratch_release(&smark);
+    npc_budget_dialog(npc, match_stats_clock() - begin);
+    return 0;
+  }
+  
+  /* wildcards put their first match in %0, regexps the whole match */
+  pe_regs = pe_regs_create(PE_REGS_ARG, "npc_match_reply");
+  ovector = pcre2_get_ovector_pointer(nd->md);
+  arg = 0;
+  for (i = nd->wild[k] ? 1 : 0; i < rc && arg < 10; i++, arg++) {
+    if (ovector[2 * i] == PCRE2_UNSET)
+      continue;
+    bp = buff;
+    safe_strl(reply + ovector[2 * i], ovector[2 * i + 1] - ovector[2 * i],
+              buff, &bp);
+    *bp = '\0';
+    pe_regs_setenv(pe_regs, arg, buff);
+  }
+  
+  /* the node may be recompiled below, keep its name */
+  next = scratch_strdup(nd->next[k]);
+  npc_set_player_node(npc, player, next);
+  
+  bp = buff;
+  npc_node_text(npc, player, next, buff, &bp);
+  *bp = '\0';
+  if (*buff)
+    notify(player, buff);
   
   bp = buff;
   safe_str("DIALOG`", buff, &bp);
-  safe_str(node, buff, &bp);
-  safe_str("`REPLY`*", buff, &bp);
-
-  return 1;  
+  safe_str(next, buff, &bp);
+  safe_str("`ACTION", buff, &bp);
+  *bp = '\0';
+  queue_attribute_base(npc, buff, player, 1, pe_regs, 0);
+  pe_regs_free(pe_regs);
+  scratch_release(&smark);
+  
+  npc_budget_dialog(npc, match_stats_clock() - begin);
+  return 1;
 }
 
 
-/* find out which dialog node an player is on */
+/* find out which dialog node an player is on
+ * the node is returned in scratch memory, good until the end of the command */
 const char *npc_get_player_node(dbref npc, dbref player)
 {
-  static char node[BUFFER_LEN];
+  char node[BUFFER_LEN];
   char buff[BUFFER_LEN];
   char *bp, *np;
   time_t ntime;
@@ -49,19 +710,14 @@ const char *npc_get_player_node(dbref npc, dbref player)
   if (!IsNPC(npc))
     return NULL;
 
-  bp = buff;
-  safe_str("_DIALOG`", buff, &bp);
-  safe_dbref(player, buff, &bp);
-  *bp = '\0';
-
-  a = atr_get_noparent(npc, buff);
+  a = atr_get_noparent(npc, npc_dialog_attr(player));
   if (!a) {
     /* there was no attribute set, set node to default */
     np = node;
     safe_str(NPC_NODE_DEFAULT, node, &np);
     *np = '\0';
     npc_set_player_node(npc, player, node);
-    return node;
+    return scratch_strdup(node);
   }
 
   /* read the attribute so we can get the node and timestamp */
@@ -76,7 +732,7 @@ const char *npc_get_player_node(dbref npc, dbref player)
     safe_str(NPC_NODE_DEFAULT, node, &np);
     *np = '\0';
     npc_set_player_node(npc, player, node);
-    return node;
+    return scratch_strdup(node);
   }
   
   if ((mudtime - ntime) > NPC_TIMEOUT) {
@@ -85,7 +741,7 @@ const char *npc_get_player_node(dbref npc, dbref player)
     safe_str(NPC_NODE_DEFAULT, node, &np);
     *np = '\0';
     npc_set_player_node(npc, player, node);
-    return node;
+    return scratch_strdup(node);
   }
   
   bp++;
@@ -95,7 +751,7 @@ const char *npc_get_player_node(dbref npc, dbref player)
     safe_str(NPC_NODE_DEFAULT, node, &np);
     *np = '\0';
     npc_set_player_node(npc, player, node);
-    return node;
+    return scratch_strdup(node);
   }
   
   np = node;
@@ -103,23 +759,20 @@ const char *npc_get_player_node(dbref npc, dbref player)
   *np = '\0';
   
   /* timestamp checks out, return the node */
-  return node;
+  return scratch_strdup(node);
 }
 
 /* set a player's dialog node on an npc */
 void npc_set_player_node(dbref npc, dbref player, const char *node)
 {
-  char atr[BUFFER_LEN];
+  const char *atr;
   char buff[BUFFER_LEN];
   char *bp;
   
   if (!RealGoodObject(npc) || !RealGoodObject(player))
     return;
   
-  bp = atr;
-  safe_str("_DIALOG`", atr, &bp);
-  safe_dbref(player, atr, &bp);
-  *bp = '\0';
+  atr = npc_dialog_attr(player);
   
   /* invalid node means to clear the attribute */
   if (!node || !*node) {
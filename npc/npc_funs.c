@@ -0,0 +1,333 @@
+
+/* npc_funs.c
+ * softcode functions for npcs */
+
+#include "npc.h"
+#include "function.h"
+#include "scratch.h"
+#include "match_stats.h"
+#include "match.h"
+#include "match_index.h"
+
+FUNCTION(fun_npcgraph);
+FUNCTION(fun_npcbudget);
+FUNCTION(fun_npcpath);
+FUNCTION(fun_npcrelease);
+FUNCTION(fun_npcreply);
+FUNCTION(fun_npctext);
+
+/*
+ * npcpath(<npc>, <start>, <stop>[, <crowd>])
+ * find a path of exits for an npc from start to stop. if crowd is true,
+ * route around the paths other npcs have planned, and plan this one,
+ * see npc_findpath_crowd(). the npc must be controlled by the executor,
+ * who must also be able to examine, or be in, start and stop
+ */
+
+FUNCTION(fun_npcpath)
+{
+  SCRATCH_MARK mark;
+  dbref found[2];
+  dbref npc, start, stop;
+  
+  npc = match_thing(executor, args[0]);
+  if (!GoodObject(npc))
+  {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!controls(executor, npc))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  
+  /* both rooms, as match_thing() would, in one pass over the lists */
+  match_result_batch(executor, executor, (const char **) args + 1, 2, NOTYPE,
+                     MAT_EVERYTHING | MAT_NOISY, found);
+  start = found[0];
+  stop = found[1];
+  if ((GoodObject(start) && !Can_Examine(executor, start) &&
+       Location(executor) != start) ||
+      (GoodObject(stop) && !Can_Examine(executor, stop) &&
+       Location(executor) != stop))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  
+  /* the path is copied out, so its scratch memory can go straight back */
+  scratch_mark(&mark);
+  if (nargs > 3 && parse_boolean(args[3]))
+    safe_str(npc_findpath_crowd(npc, start, stop), buff, bp);
+  else
+    safe_str(npc_findpath(npc, start, stop), buff, bp);
+  scratch_release(&mark);
+}
+
+/*
+ * npcrelease(<npc>)
+ * give back the rooms an npc's crowd routed path has reserved, for when
+ * it stops following it
+ */
+
+FUNCTION(fun_npcrelease)
+{
+  dbref npc;
+  
+  npc = match_thing(executor, args[0]);
+  if (!GoodObject(npc))
+  {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!controls(executor, npc))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  npc_crowd_release(npc);
+}
+
+/*
+ * npcreply(<npc>, <player>, <reply>)
+ * match what player said to an npc against the replies for the dialog
+ * node player is on, see npc_match_reply(). returns 1 if a reply matched
+ * and player has moved on, 0 if none did. the executor must control the
+ * npc; it's usually the npc itself, from a $-command or ^-listen
+ */
+
+FUNCTION(fun_npcreply)
+{
+  dbref found[2];
+  dbref npc, player;
+  
+  match_result_batch(executor, executor, (const char **) args, 2, NOTYPE,
+                     MAT_EVERYTHING | MAT_NOISY, found);
+  npc = found[0];
+  player = found[1];
+  if (!GoodObject(npc) || !GoodObject(player))
+  {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!controls(executor, npc))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  if (!IsNPC(npc))
+  {
+    safe_str("#-1 NOT AN NPC", buff, bp);
+    return;
+  }
+  
+  switch (npc_match_reply(npc, player, args[2]))
+  {
+  case NPC_NODE_ERROR:
+    safe_str("#-1 BUDGET EXCEEDED", buff, bp);
+    break;
+  case 0:
+    safe_chr('0', buff, bp);
+    break;
+  default:
+    safe_chr('1', buff, bp);
+    break;
+  }
+}
+
+/*
+ * npctext(<npc>, <player>[, <node>])
+ * the text player is shown on reaching a dialog node, the one player is
+ * on if no node is given, see npc_node_text(). nothing is shown or
+ * queued, and player stays where they are. the executor must control
+ * the npc, and the time is charged to its dialog budget
+ */
+
+FUNCTION(fun_npctext)
+{
+  SCRATCH_MARK mark;
+  dbref found[2];
+  dbref npc, player;
+  const char *node;
+  uint64_t begin;
+  
+  match_result_batch(executor, executor, (const char **) args, 2, NOTYPE,
+                     MAT_EVERYTHING | MAT_NOISY, found);
+  npc = found[0];
+  player = found[1];
+  if (!GoodObject(npc) || !GoodObject(player))
+  {
+    safe_str(T(e_notvis), buff, bp);
+    return;
+  }
+  if (!controls(executor, npc))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  if (!IsNPC(npc))
+  {
+    safe_str("#-1 NOT AN NPC", buff, bp);
+    return;
+  }
+  if (!npc_budget_dialog_ok(npc))
+  {
+    safe_str("#-1 BUDGET EXCEEDED", buff, bp);
+    return;
+  }
+  
+  begin = match_stats_clock();
+  scratch_mark(&mark);
+  if (nargs > 2 && *args[2])
+    node = args[2];
+  else
+    node = npc_get_player_node(npc, player);
+  if (node)
+    npc_node_text(npc, player, node, buff, bp);
+  scratch_release(&mark);
+  npc_budget_dialog(npc, match_stats_clock() - begin);
+}
+
+/*
+ * npcgraph([stats])
+ * npcgraph(dump[, <sections>])
+ * npcgraph(load)
+ * report on the room graph, write it to NPC_GRAPH_FILE with the optional
+ * sections listed (costs, coords), or read it back from there.
+ * wizard only
+ */
+
+FUNCTION(fun_npcgraph)
+{
+  char *list, *word;
+  int sections;
+  
+  if (!Wizard(executor))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  
+  if (nargs < 1 || !*args[0] || !strcasecmp(args[0], "stats"))
+  {
+    npc_graph_stats(buff, bp);
+  }
+  else if (!strcasecmp(args[0], "dump"))
+  {
+    sections = 0;
+    if (nargs > 1)
+    {
+      list = trim_space_sep(args[1], ' ');
+      while ((word = split_token(&list, ' ')))
+      {
+        if (!strcasecmp(word, "costs"))
+          sections |= NPC_GRAPH_COSTS;
+        else if (!strcasecmp(word, "coords"))
+          sections |= NPC_GRAPH_COORDS;
+        else if (*word)
+        {
+          safe_str("#-1 INVALID SECTION", buff, bp);
+          return;
+        }
+      }
+    }
+    if (!npc_graph_dump(NPC_GRAPH_FILE, sections))
+      safe_str("#-1 COULDN'T WRITE GRAPH", buff, bp);
+    else
+      npc_graph_stats(buff, bp);
+  }
+  else if (!strcasecmp(args[0], "load"))
+  {
+    if (!npc_graph_load(NPC_GRAPH_FILE))
+      safe_str("#-1 COULDN'T LOAD GRAPH", buff, bp);
+    else
+      npc_graph_stats(buff, bp);
+  }
+  else
+    safe_str("#-1 INVALID OPTION", buff, bp);
+}
+
+/*
+ * npcbudget([<count>[, <rooms|queries|dialog|denied>]])
+ * npcbudget(reset)
+ * list the npcs and owners that have used the most pathfinding and
+ * dialog matching, as #dbref:rooms:queries:dialog_ns:denied, or forget
+ * what they have used. wizard only
+ */
+
+FUNCTION(fun_npcbudget)
+{
+  int count, sort;
+  
+  if (!Wizard(executor))
+  {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+  
+  if (nargs > 0 && !strcasecmp(args[0], "reset"))
+  {
+    npc_budget_reset();
+    return;
+  }
+  
+  count = 10;
+  if (nargs > 0 && *args[0])
+  {
+    if (!is_strict_integer(args[0]))
+    {
+      safe_str(T(e_int), buff, bp);
+      return;
+    }
+    count = parse_integer(args[0]);
+  }
+  
+  sort = NPC_USAGE_ROOMS;
+  if (nargs > 1 && *args[1])
+  {
+    if (!strcasecmp(args[1], "rooms"))
+      sort = NPC_USAGE_ROOMS;
+    else if (!strcasecmp(args[1], "queries"))
+      sort = NPC_USAGE_QUERIES;
+    else if (!strcasecmp(args[1], "dialog"))
+      sort = NPC_USAGE_DIALOG;
+    else if (!strcasecmp(args[1], "denied"))
+      sort = NPC_USAGE_DENIED;
+    else
+    {
+      safe_str("#-1 INVALID SORT", buff, bp);
+      return;
+    }
+  }
+  
+  npc_budget_report(count, sort, buff, bp);
+}
+
+/*
+ * forget everything kept about an object, call from local_data_free()
+ * before it's recycled
+ */
+void npc_destroyed(dbref thing)
+{
+  npc_crowd_release(thing);
+  npc_dialog_forget(thing);
+  npc_budget_forget(thing);
+  npc_graph_changed(thing);
+}
+
+/*
+ * add the npc softcode functions, call from local_startup()
+ * also picks up a saved room graph, so the first path search doesn't
+ * have to walk the whole database
+ */
+void npc_init(void)
+{
+  function_add("NPCPATH", fun_npcpath, 3, 4, FN_REG);
+  function_add("NPCRELEASE", fun_npcrelease, 1, 1, FN_REG);
+  function_add("NPCREPLY", fun_npcreply, 3, -3, FN_REG);
+  function_add("NPCTEXT", fun_npctext, 2, 3, FN_REG);
+  function_add("NPCGRAPH", fun_npcgraph, 0, 2, FN_REG);
+  function_add("NPCBUDGET", fun_npcbudget, 0, 2, FN_REG);
+  npc_graph_load(NPC_GRAPH_FILE);
+}
@@ -0,0 +1,833 @@
+
+/* npc_graph.c
+ * the room graph npc pathfinding searches, and saving it to a file */
+
+#include "npc.h"
+#include "scratch.h"
+#include "mymalloc.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * the graph is kept in compressed sparse row form: the exits of a room
+ * are edges[offsets[room]] up to edges[offsets[room+1]], in the order
+ * they are in the room's exit list. it's built by walking the database,
+ * or mapped in from a file written by npc_graph_dump(), which is laid
+ * out exactly like the graph in memory:
+ *
+ *   header
+ *   heads     int32[nobjs]       Exits(room) when the graph was built
+ *   zones     int32[nobjs]       Zone(room)
+ *   offsets   uint32[nobjs + 1]
+ *   edges     int32[nedges * 2]  exit and destination, as NPC_EDGE
+ *   costs     uint32[nedges]     with NPC_GRAPH_COSTS
+ *   coords    int32[nobjs * 3]   with NPC_GRAPH_COORDS
+ *
+ * each section starts on an 8 byte boundary. non-rooms have a head of
+ * NOTHING and no edges.
+ *
+ * a room's row is trusted until the server says it has changed: exits
+ * opened, destroyed or moved, through npc_graph_moved() next to
+ * match_index_moved(), and exits relinked or NPC`COST and NPC`COORD
+ * set, through npc_graph_changed(). that marks the row stale, and the
+ * next search to reach the room walks it in the database into a patch
+ * that's used instead of the row from then on. rooms created since the
+ * graph was built start out stale.
+ *
+ * searches never build the graph themselves: npc_graph_timer(), called
+ * once a second from local_timer(), builds it when there is none, and
+ * once NPC_GRAPH_PATCHES rooms have been patched folds the patches back
+ * into a new graph. that copies the rows that are still good, so only
+ * stale rooms are walked again.
+ */
+
+#define NPC_GRAPH_MAGIC		"NPCG"
+#define NPC_GRAPH_ORDER		0x01020304
+#define NPC_GRAPH_VERSION	1
+#define NPC_GRAPH_PATCHES	256
+
+#define NPC_COST_ATTR		"NPC`COST"
+#define NPC_COORD_ATTR		"NPC`COORD"
+
+#define NPC_GRAPH_PAD(n)	(((n) + 7) & ~((size_t) 7))
+
+enum npc_graph_section {
+  NPCG_HEADS, NPCG_ZONES, NPCG_OFFSETS, NPCG_EDGES, NPCG_COSTS, NPCG_COORDS,
+  NPCG_SECTIONS
+};
+
+struct npc_graph_header {
+  char magic[4];
+  uint32_t order;       /* NPC_GRAPH_ORDER, to catch the wrong byte order */
+  uint32_t version;
+  uint32_t sections;    /* NPC_GRAPH_COSTS, NPC_GRAPH_COORDS */
+  uint32_t nobjs;       /* db_top when it was built */
+  uint32_t nedges;
+  uint32_t nrooms;
+  uint32_t pad;
+  int64_t built;
+};
+
+struct npc_graph {
+  const struct npc_graph_header *hdr;
+  const int32_t *heads;
+  const int32_t *zones;
+  const uint32_t *offsets;
+  const NPC_EDGE *edges;
+  const uint32_t *costs;
+  const int32_t *coords;
+  void *base;           /* the block or mapping holding all of it */
+  size_t size;
+  size_t len[NPCG_SECTIONS];
+  int mapped;           /* base is a mapping, not a block */
+  int loaded;           /* it came from a file */
+};
+
+/* what's known about a room's row in the graph */
+#define NPC_ROW_GOOD		0	/* the graph's row can be used */
+#define NPC_ROW_STALE		1	/* the room has changed since */
+#define NPC_ROW_PATCHED		2	/* walked again since, use the patch */
+
+struct npc_row {
+  int state;
+  uint32_t count;
+  NPC_EDGE *edges;      /* the patch, for NPC_ROW_PATCHED */
+  uint32_t *costs;
+};
+
+static struct npc_graph graph;
+static time_t graph_when = 0;           /* when it was built or loaded */
+
+/* the state of each room's row, by dbref, see npc_graph_row() */
+static struct npc_row *rows = NULL;
+static size_t rows_size = 0;
+static unsigned long rows_patched = 0;  /* rows with a patch */
+static unsigned long rows_stale = 0;    /* rows marked stale since built */
+
+/* rooms visited by the current search, see npc_graph_visit() */
+static unsigned int *visit_marks = NULL;
+static size_t visit_size = 0;
+static unsigned int visit_stamp = 0;
+
+static int npc_graph_mul(size_t n, size_t each, size_t *len);
+static size_t npc_graph_layout(const struct npc_graph_header *hdr,
+                               size_t *off, size_t *len);
+static void npc_graph_point(struct npc_graph *g, const size_t *off,
+                            const size_t *len);
+static void npc_graph_free(struct npc_graph *g);
+static void npc_graph_reset(void);
+static struct npc_row *npc_graph_row(dbref room);
+static void npc_row_free(struct npc_row *row);
+static void npc_row_patch(dbref room, struct npc_row *row);
+static void npc_graph_rebuild(void);
+static void npc_graph_check(void);
+static unsigned int npc_exit_cost(dbref exit);
+static void npc_room_coords(dbref room, int32_t *coords);
+static int npc_graph_walk(dbref room, const NPC_EDGE **edges,
+                          const unsigned int **costs);
+static int npc_graph_write(FILE *f, const void *data, size_t len);
+
+/* n things of each bytes, or 0 if that doesn't fit in a size_t */
+static int npc_graph_mul(size_t n, size_t each, size_t *len)
+{
+  if (each && n > (size_t) -1 / each)
+    return 0;
+  *len = n * each;
+  return 1;
+}
+
+/*
+ * work out where each section goes and how long it is, return the
+ * total size, or 0 if it's too big to address
+ */
+static size_t npc_graph_layout(const struct npc_graph_header *hdr,
+                               size_t *off, size_t *len)
+{
+  size_t pos, padded;
+  int i;
+  
+  if (hdr->nobjs == (uint32_t) -1)
+    return 0;
+  if (!npc_graph_mul(hdr->nobjs, sizeof(int32_t), &len[NPCG_HEADS]) ||
+      !npc_graph_mul(hdr->nobjs, sizeof(int32_t), &len[NPCG_ZONES]) ||
+      !npc_graph_mul((size_t) hdr->nobjs + 1, sizeof(uint32_t),
+                     &len[NPCG_OFFSETS]) ||
+      !npc_graph_mul(hdr->nedges, sizeof(NPC_EDGE), &len[NPCG_EDGES]) ||
+      !npc_graph_mul(hdr->nedges, sizeof(uint32_t), &len[NPCG_COSTS]) ||
+      !npc_graph_mul(hdr->nobjs, 3 * sizeof(int32_t), &len[NPCG_COORDS]))
+    return 0;
+  if (!(hdr->sections & NPC_GRAPH_COSTS))
+    len[NPCG_COSTS] = 0;
+  if (!(hdr->sections & NPC_GRAPH_COORDS))
+    len[NPCG_COORDS] = 0;
+  
+  pos = NPC_GRAPH_PAD(sizeof(struct npc_graph_header));
+  for (i = 0; i < NPCG_SECTIONS; ++i)
+  {
+    if (len[i] > (size_t) -1 - 7)
+      return 0;
+    padded = NPC_GRAPH_PAD(len[i]);
+    if (padded > (size_t) -1 - pos)
+      return 0;
+    off[i] = len[i] ? pos : 0;
+    pos += padded;
+  }
+  return pos;
+}
+
+/* point the section pointers of a graph into its block */
+static void npc_graph_point(struct npc_graph *g, const size_t *off,
+                            const size_t *len)
+{
+  const char *base = g->base;
+  
+  g->hdr = g->base;
+  g->heads = (const int32_t *) (base + off[NPCG_HEADS]);
+  g->zones = (const int32_t *) (base + off[NPCG_ZONES]);
+  g->offsets = (const uint32_t *) (base + off[NPCG_OFFSETS]);
+  g->edges = (const NPC_EDGE *) (base + off[NPCG_EDGES]);
+  g->costs = off[NPCG_COSTS] ? (const uint32_t *) (base + off[NPCG_COSTS])
+    : NULL;
+  g->coords = off[NPCG_COORDS] ? (const int32_t *) (base + off[NPCG_COORDS])
+    : NULL;
+  memcpy(g->len, len, sizeof g->len);
+}
+
+static void npc_graph_free(struct npc_graph *g)
+{
+  if (!g->base)
+    return;
+#ifndef WIN32
+  if (g->mapped)
+    munmap(g->base, g->size);
+  else
+#endif
+    mush_free(g->base, "npc.graph");
+  memset(g, 0, sizeof *g);
+}
+
+/* a new graph is in place: every row it has is good, the rest stale */
+static void npc_graph_reset(void)
+{
+  size_t i;
+  
+  for (i = 0; i < rows_size; ++i)
+  {
+    npc_row_free(&rows[i]);
+    rows[i].state = i < graph.hdr->nobjs ? NPC_ROW_GOOD : NPC_ROW_STALE;
+  }
+  rows_patched = 0;
+  rows_stale = 0;
+  graph_when = mudtime;
+}
+
+/* the state of a room's row, growing the table to hold it */
+static struct npc_row *npc_graph_row(dbref room)
+{
+  size_t want, i;
+  
+  if ((size_t) room >= rows_size)
+  {
+    want = db_top > room ? (size_t) db_top : (size_t) room + 1;
+    rows = mush_realloc(rows, want * sizeof(struct npc_row), "npc.graph_rows");
+    for (i = rows_size; i < want; ++i)
+    {
+      memset(&rows[i], 0, sizeof(struct npc_row));
+      rows[i].state = (graph.base && i < graph.hdr->nobjs) ?
+        NPC_ROW_GOOD : NPC_ROW_STALE;
+    }
+    rows_size = want;
+  }
+  return &rows[room];
+}
+
+static void npc_row_free(struct npc_row *row)
+{
+  if (row->state != NPC_ROW_PATCHED)
+    return;
+  if (row->edges)
+    mush_free(row->edges, "npc.graph_patch");
+  if (row->costs)
+    mush_free(row->costs, "npc.graph_patch");
+  row->edges = NULL;
+  row->costs = NULL;
+  row->count = 0;
+  row->state = NPC_ROW_STALE;
+  rows_patched--;
+}
+
+/* walk a stale room's exits in the database into a patch */
+static void npc_row_patch(dbref room, struct npc_row *row)
+{
+  dbref thing;
+  uint32_t n;
+  
+  n = 0;
+  if (RealGoodObject(room) && IsRoom(room))
+  {
+    DOLIST(thing, Exits(room))
+      n++;
+  }
+  
+  row->edges = n ? mush_malloc(n * sizeof(NPC_EDGE), "npc.graph_patch")
+    : NULL;
+  row->costs = n ? mush_malloc(n * sizeof(uint32_t), "npc.graph_patch")
+    : NULL;
+  row->count = n;
+  n = 0;
+  if (row->count)
+  {
+    DOLIST(thing, Exits(room))
+    {
+      row->edges[n].exit = thing;
+      row->edges[n].dest = Destination(thing);
+      row->costs[n] = npc_exit_cost(thing);
+      n++;
+    }
+  }
+  row->state = NPC_ROW_PATCHED;
+  rows_patched++;
+}
+
+/*
+ * a room's exits have changed, or thing is an exit that has: walk the
+ * room again when a search next reaches it
+ */
+void npc_graph_changed(dbref thing)
+{
+  struct npc_row *row;
+  dbref room;
+  
+  if (!graph.base || !GoodObject(thing))
+    return;
+  room = IsExit(thing) ? Source(thing) : thing;
+  if (!GoodObject(room))
+    return;
+  row = npc_graph_row(room);
+  if (row->state == NPC_ROW_PATCHED)
+    npc_row_free(row);
+  else if (row->state == NPC_ROW_GOOD)
+    rows_stale++;
+  row->state = NPC_ROW_STALE;
+}
+
+/*
+ * thing has moved from one place to another, as match_index_moved() is
+ * told. for an exit those are its old and new source rooms
+ */
+void npc_graph_moved(dbref thing, dbref from, dbref to)
+{
+  if (!graph.base || !GoodObject(thing) || !IsExit(thing))
+    return;
+  if (GoodObject(from))
+    npc_graph_changed(from);
+  if (GoodObject(to))
+    npc_graph_changed(to);
+}
+
+/* the cost of going through an exit, from its NPC`COST attribute */
+static unsigned int npc_exit_cost(dbref exit)
+{
+  ATTR *a;
+  int cost;
+  
+  a = atr_get_noparent(exit, NPC_COST_ATTR);
+  if (!a)
+    return 1;
+  cost = parse_integer(atr_value(a));
+  return cost > 1 ? (unsigned int) cost : 1;
+}
+
+/* a room's position, from its NPC`COORD attribute of "<x> <y> <z>" */
+static void npc_room_coords(dbref room, int32_t *coords)
+{
+  ATTR *a;
+  int x, y, z;
+  
+  coords[0] = coords[1] = coords[2] = 0;
+  a = atr_get_noparent(room, NPC_COORD_ATTR);
+  if (a && sscanf(atr_value(a), "%d %d %d", &x, &y, &z) == 3)
+  {
+    coords[0] = x;
+    coords[1] = y;
+    coords[2] = z;
+  }
+}
+
+/*
+ * make a new graph of the whole database. rows of the old graph that are
+ * still good, and patches, are copied; only stale rooms, and all of them
+ * if there's no graph yet, are walked in the database
+ */
+static void npc_graph_rebuild(void)
+{
+  struct npc_graph_header hdr;
+  size_t off[NPCG_SECTIONS], len[NPCG_SECTIONS];
+  struct npc_graph g;
+  struct npc_row *row;
+  int32_t *heads, *zones, *coords;
+  uint32_t *offsets, *costs;
+  NPC_EDGE *edges;
+  dbref room, thing;
+  size_t nedges;
+  uint32_t n, lo, i;
+  
+  memset(&hdr, 0, sizeof hdr);
+  memcpy(hdr.magic, NPC_GRAPH_MAGIC, 4);
+  hdr.order = NPC_GRAPH_ORDER;
+  hdr.version = NPC_GRAPH_VERSION;
+  hdr.sections = NPC_GRAPH_COSTS | NPC_GRAPH_COORDS;
+  hdr.nobjs = db_top;
+  hdr.built = mudtime;
+  
+  /* patch the stale rooms first, so every row can be copied */
+  nedges = 0;
+  for (room = 0; room < db_top; ++room)
+  {
+    if (!RealGoodObject(room) || !IsRoom(room))
+      continue;
+    hdr.nrooms++;
+    if (!graph.base)
+    {
+      DOLIST(thing, Exits(room))
+        nedges++;
+      continue;
+    }
+    row = npc_graph_row(room);
+    if (row->state == NPC_ROW_STALE)
+      npc_row_patch(room, row);
+    if (row->state == NPC_ROW_PATCHED)
+      nedges += row->count;
+    else
+      nedges += graph.offsets[room + 1] - graph.offsets[room];
+  }
+  if (nedges > (uint32_t) -1)
+  {
+    do_rawlog(LT_ERR, "npc_graph_rebuild: too many exits for a graph");
+    return;
+  }
+  hdr.nedges = nedges;
+  
+  memset(&g, 0, sizeof g);
+  g.size = npc_graph_layout(&hdr, off, len);
+  if (!g.size)
+  {
+    do_rawlog(LT_ERR, "npc_graph_rebuild: the graph is too big");
+    return;
+  }
+  g.base = mush_malloc(g.size, "npc.graph");
+  memset(g.base, 0, g.size);
+  memcpy(g.base, &hdr, sizeof hdr);
+  npc_graph_point(&g, off, len);
+  
+  heads = (int32_t *) g.heads;
+  zones = (int32_t *) g.zones;
+  offsets = (uint32_t *) g.offsets;
+  edges = (NPC_EDGE *) g.edges;
+  costs = (uint32_t *) g.costs;
+  coords = (int32_t *) g.coords;
+  
+  n = 0;
+  for (room = 0; room < db_top; ++room)
+  {
+    offsets[room] = n;
+    heads[room] = NOTHING;
+    zones[room] = NOTHING;
+    if (!RealGoodObject(room) || !IsRoom(room))
+      continue;
+    
+    heads[room] = Exits(room);
+    zones[room] = Zone(room);
+    row = graph.base ? npc_graph_row(room) : NULL;
+    if (row && row->state == NPC_ROW_PATCHED)
+    {
+      memcpy(edges + n, row->edges, row->count * sizeof(NPC_EDGE));
+      memcpy(costs + n, row->costs, row->count * sizeof(uint32_t));
+      n += row->count;
+      npc_room_coords(room, coords + room * 3);
+    }
+    else if (row)
+    {
+      lo = graph.offsets[room];
+      for (i = lo; i < graph.offsets[room + 1]; ++i, ++n)
+      {
+        edges[n] = graph.edges[i];
+        costs[n] = graph.costs ? graph.costs[i] : npc_exit_cost(edges[n].exit);
+      }
+      if (graph.coords)
+        memcpy(coords + room * 3, graph.coords + room * 3,
+               3 * sizeof(int32_t));
+      else
+        npc_room_coords(room, coords + room * 3);
+    }
+    else
+    {
+      npc_room_coords(room, coords + room * 3);
+      DOLIST(thing, Exits(room))
+      {
+        edges[n].exit = thing;
+        edges[n].dest = Destination(thing);
+        costs[n] = npc_exit_cost(thing);
+        n++;
+      }
+    }
+  }
+  offsets[db_top] = n;
+  
+  npc_graph_free(&graph);
+  graph = g;
+  npc_graph_reset();
+}
+
+/*
+ * a graph loaded from a file may not match the database: mark the rows
+ * whose exits aren't the room's exit list, in order and to the same
+ * places, stale. costs and coordinates are taken from the file
+ */
+static void npc_graph_check(void)
+{
+  struct npc_row *row;
+  dbref room, thing;
+  uint32_t i, hi;
+  
+  for (room = 0; room < db_top && (uint32_t) room < graph.hdr->nobjs; ++room)
+  {
+    i = graph.offsets[room];
+    hi = graph.offsets[room + 1];
+    if (RealGoodObject(room) && IsRoom(room))
+    {
+      DOLIST(thing, Exits(room))
+      {
+        if (i >= hi || graph.edges[i].exit != thing ||
+            graph.edges[i].dest != Destination(thing))
+          break;
+        i++;
+      }
+      if (!GoodObject(thing) && i == hi)
+        continue;
+    }
+    else if (i == hi)
+      continue;
+    row = npc_graph_row(room);
+    row->state = NPC_ROW_STALE;
+    rows_stale++;
+  }
+}
+
+/* get a room's exits by walking the database, into scratch memory */
+static int npc_graph_walk(dbref room, const NPC_EDGE **edges,
+                          const unsigned int **costs)
+{
+  NPC_EDGE *ep;
+  unsigned int *cp;
+  dbref thing;
+  int n;
+  
+  n = 0;
+  DOLIST(thing, Exits(room))
+    n++;
+  
+  ep = scratch_alloc(n * sizeof(NPC_EDGE));
+  cp = costs ? scratch_alloc(n * sizeof(unsigned int)) : NULL;
+  n = 0;
+  DOLIST(thing, Exits(room))
+  {
+    ep[n].exit = thing;
+    ep[n].dest = Destination(thing);
+    if (cp)
+      cp[n] = npc_exit_cost(thing);
+    n++;
+  }
+  
+  *edges = ep;
+  if (costs)
+    *costs = cp;
+  return n;
+}
+
+/*
+ * build the graph if there is none, or fold the patches back into it
+ * once there are enough of them. called once a second, outside searches
+ */
+void npc_graph_timer(void)
+{
+  if (!graph.base || rows_patched >= NPC_GRAPH_PATCHES)
+    npc_graph_rebuild();
+}
+
+/* get ready for a search: forget which rooms the last search visited */
+void npc_graph_begin(void)
+{
+  size_t want;
+  
+  want = db_top;
+  if (visit_size < want)
+  {
+    visit_marks = mush_realloc(visit_marks, want * sizeof(unsigned int),
+                               "npc.graph_visit");
+    memset(visit_marks + visit_size, 0,
+           (want - visit_size) * sizeof(unsigned int));
+    visit_size = want;
+  }
+  
+  if (++visit_stamp == 0)
+  {
+    memset(visit_marks, 0, visit_size * sizeof(unsigned int));
+    visit_stamp = 1;
+  }
+}
+
+/* mark a room visited by this search, return 0 if it already was */
+int npc_graph_visit(dbref room)
+{
+  if (visit_marks[room] == visit_stamp)
+    return 0;
+  visit_marks[room] = visit_stamp;
+  return 1;
+}
+
+/* has a room been visited by this search */
+int npc_graph_visited(dbref room)
+{
+  return visit_marks[room] == visit_stamp;
+}
+
+/*
+ * can player see an exit out of room, the way DOLIST_VISIBLE would let
+ * them: dark exits, and exits in a dark room that aren't light, are only
+ * seen by those who can see everything or control the room
+ */
+int npc_exit_visible(dbref player, dbref exit, dbref room)
+{
+  if (!can_interact(exit, player, INTERACT_SEE, NULL))
+    return 0;
+  if (!DarkLegal(exit) && !(Dark(room) && !Light(exit)))
+    return 1;
+  return See_All(player) || room == player || controls(player, room);
+}
+
+/*
+ * get the exits of a room, and what it costs to go through each of them
+ * if costs is not NULL. with no graph the room is walked in the database,
+ * into scratch memory; a stale room is walked into a patch that's kept.
+ * returns the number of exits
+ */
+int npc_graph_edges(dbref room, const NPC_EDGE **edges,
+                    const unsigned int **costs)
+{
+  struct npc_row *row;
+  uint32_t i, lo, hi;
+  
+  if (!graph.base)
+    return npc_graph_walk(room, edges, costs);
+  
+  row = npc_graph_row(room);
+  if (row->state == NPC_ROW_STALE)
+    npc_row_patch(room, row);
+  if (row->state == NPC_ROW_PATCHED)
+  {
+    *edges = row->edges;
+    if (costs)
+      *costs = row->costs;
+    return row->count;
+  }
+  
+  lo = graph.offsets[room];
+  hi = graph.offsets[room + 1];
+  *edges = graph.edges + lo;
+  if (costs)
+  {
+    if (graph.costs)
+      *costs = graph.costs + lo;
+    else
+    {
+      /* the graph was loaded without costs, they're all 1 */
+      unsigned int *cp = scratch_alloc((hi - lo) * sizeof(unsigned int));
+      for (i = 0; i < hi - lo; ++i)
+        cp[i] = 1;
+      *costs = cp;
+    }
+  }
+  return hi - lo;
+}
+
+static int npc_graph_write(FILE *f, const void *data, size_t len)
+{
+  static const char zeros[8] = { 0 };
+  size_t pad = NPC_GRAPH_PAD(len) - len;
+  
+  if (len && fwrite(data, 1, len, f) != len)
+    return 0;
+  if (pad && fwrite(zeros, 1, pad, f) != pad)
+    return 0;
+  return 1;
+}
+
+/*
+ * write the graph, brought up to date, to a file, with the optional
+ * sections asked for. it's written to a temporary file that's then
+ * renamed over the old one, so a reader never sees half a file. returns
+ * 0 on error
+ */
+int npc_graph_dump(const char *file, int sections)
+{
+  struct npc_graph_header hdr;
+  size_t off[NPCG_SECTIONS], len[NPCG_SECTIONS];
+  char tmp[BUFFER_LEN];
+  FILE *f;
+  int ok;
+  
+  npc_graph_rebuild();
+  if (!graph.base)
+    return 0;
+  
+  hdr = *graph.hdr;
+  hdr.sections = sections & (NPC_GRAPH_COSTS | NPC_GRAPH_COORDS);
+  if (!npc_graph_layout(&hdr, off, len))
+    return 0;
+  
+  snprintf(tmp, sizeof tmp, "%s.tmp", file);
+  f = fopen(tmp, "wb");
+  if (!f)
+  {
+    do_rawlog(LT_ERR, "npc_graph_dump: couldn't open %s", tmp);
+    return 0;
+  }
+  
+  ok = npc_graph_write(f, &hdr, sizeof hdr) &&
+    npc_graph_write(f, graph.heads, len[NPCG_HEADS]) &&
+    npc_graph_write(f, graph.zones, len[NPCG_ZONES]) &&
+    npc_graph_write(f, graph.offsets, len[NPCG_OFFSETS]) &&
+    npc_graph_write(f, graph.edges, len[NPCG_EDGES]) &&
+    npc_graph_write(f, graph.costs, len[NPCG_COSTS]) &&
+    npc_graph_write(f, graph.coords, len[NPCG_COORDS]);
+  
+  if (fclose(f) != 0)
+    ok = 0;
+  if (!ok || rename(tmp, file) != 0)
+  {
+    do_rawlog(LT_ERR, "npc_graph_dump: couldn't write %s", file);
+    remove(tmp);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * use a graph written by npc_graph_dump() instead of building one, to
+ * start up without reading every exit's attributes. the file is mapped,
+ * not read, and checked enough that a bad one can't send a search
+ * outside it. rooms whose exits have changed since it was written are
+ * marked stale, see npc_graph_check(). returns 0 if there's no usable
+ * file
+ */
+int npc_graph_load(const char *file)
+{
+  struct npc_graph_header hdr;
+  size_t off[NPCG_SECTIONS], len[NPCG_SECTIONS];
+  struct npc_graph g;
+  uint32_t i;
+  FILE *f;
+  
+  f = fopen(file, "rb");
+  if (!f)
+    return 0;
+  if (fread(&hdr, sizeof hdr, 1, f) != 1 ||
+      memcmp(hdr.magic, NPC_GRAPH_MAGIC, 4) != 0 ||
+      hdr.order != NPC_GRAPH_ORDER || hdr.version != NPC_GRAPH_VERSION ||
+      (hdr.sections & ~(NPC_GRAPH_COSTS | NPC_GRAPH_COORDS)))
+  {
+    do_rawlog(LT_ERR, "npc_graph_load: %s isn't a version %d graph",
+              file, NPC_GRAPH_VERSION);
+    fclose(f);
+    return 0;
+  }
+  
+  memset(&g, 0, sizeof g);
+  g.size = npc_graph_layout(&hdr, off, len);
+  if (!g.size)
+  {
+    do_rawlog(LT_ERR, "npc_graph_load: %s is too big", file);
+    fclose(f);
+    return 0;
+  }
+  
+#ifndef WIN32
+  {
+    struct stat st;
+    
+    if (fstat(fileno(f), &st) != 0 || st.st_size < 0 ||
+        (uintmax_t) st.st_size != (uintmax_t) g.size)
+    {
+      do_rawlog(LT_ERR, "npc_graph_load: %s is the wrong size", file);
+      fclose(f);
+      return 0;
+    }
+    g.base = mmap(NULL, g.size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (g.base == MAP_FAILED)
+    {
+      do_rawlog(LT_ERR, "npc_graph_load: couldn't map %s", file);
+      fclose(f);
+      return 0;
+    }
+    g.mapped = 1;
+  }
+#else
+  g.base = mush_malloc(g.size, "npc.graph");
+  rewind(f);
+  if (fread(g.base, 1, g.size, f) != g.size || fgetc(f) != EOF)
+  {
+    do_rawlog(LT_ERR, "npc_graph_load: %s is the wrong size", file);
+    mush_free(g.base, "npc.graph");
+    fclose(f);
+    return 0;
+  }
+#endif
+  fclose(f);
+  npc_graph_point(&g, off, len);
+  
+  /* the offsets have to stay inside the edges */
+  for (i = 0; i < hdr.nobjs; ++i)
+  {
+    if (g.offsets[i] > g.offsets[i + 1])
+      break;
+  }
+  if (g.offsets[0] != 0 || i < hdr.nobjs || g.offsets[i] != hdr.nedges)
+  {
+    do_rawlog(LT_ERR, "npc_graph_load: %s has bad offsets", file);
+    npc_graph_free(&g);
+    return 0;
+  }
+  
+  g.loaded = 1;
+  npc_graph_free(&graph);
+  graph = g;
+  npc_graph_reset();
+  npc_graph_check();
+  return 1;
+}
+
+/* describe the graph, for npcgraph(stats) */
+void npc_graph_stats(char *buff, char **bp)
+{
+  if (!graph.base)
+  {
+    safe_str("#-1 NO GRAPH", buff, bp);
+    return;
+  }
+  safe_format(buff, bp, "rooms:%u edges:%u objects:%u source:%s "
+              "costs:%d coords:%d stale:%lu patched:%lu age:%ld",
+              graph.hdr->nrooms, graph.hdr->nedges, graph.hdr->nobjs,
+              graph.loaded ? "file" : "built", graph.costs != NULL,
+              graph.coords != NULL, rows_stale, rows_patched,
+              (long) (mudtime - graph_when));
+}
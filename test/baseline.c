@@ -0,0 +1,22 @@
+/* baseline.c
+ * the matcher and pathfinder as they were before the generic and npc
+ * modules were reworked, built under other names so the tests can check
+ * the new code gives the same answers. */
+
+#define match_result base_match_result
+#define match_result_relative base_match_result_relative
+#define noisy_match_result base_noisy_match_result
+#define last_match_result base_last_match_result
+#define match_controlled base_match_controlled
+#define match_aliases base_match_aliases
+#include "baseline/match.c"
+#undef match_result
+#undef match_result_relative
+#undef noisy_match_result
+#undef last_match_result
+#undef match_controlled
+#undef match_aliases
+
+#define npc_findpath base_npc_findpath
+#include "baseline/npc_action.c"
+#undef npc_findpath
@@ -0,0 +1,18 @@
+/* baseline.h
+ * the old matcher and pathfinder, see baseline.c */
+
+#ifndef __BASELINE_H
+#define __BASELINE_H
+
+#include "mushtype.h"
+
+extern dbref base_match_result(dbref who, const char *name, int type,
+                               long flags);
+extern dbref base_match_result_relative(dbref who, dbref where,
+                                        const char *name, int type,
+                                        long flags);
+extern dbref base_noisy_match_result(dbref who, const char *name, int type,
+                                     long flags);
+extern const char *base_npc_findpath(dbref player, dbref start, dbref stop);
+
+#endif                          /* __BASELINE_H */
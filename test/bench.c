@@ -0,0 +1,172 @@
+/* bench.c
+ * throughput and latency of matching and pathfinding, old and new, on
+ * synthetic worlds. not a test: run it with "cmake --build . --target
+ * bench" and compare the numbers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "baseline.h"
+#include "match.h"
+#include "match_index.h"
+#include "match_stats.h"
+#include "npc.h"
+#include "scratch.h"
+#include "world.h"
+
+#define BENCH_QUERIES 4000
+#define BENCH_ROUNDS 5
+#define BENCH_BATCH 6
+
+struct query {
+  dbref who;
+  char name[64];
+};
+
+static struct world w;
+static struct query queries[BENCH_QUERIES];
+
+static void
+report(const char *what, const struct match_hist *h)
+{
+  char buff[BUFFER_LEN];
+  char *bp = buff;
+
+  match_bench_report(h, buff, &bp);
+  *bp = '\0';
+  printf("%-28s %s\n", what, buff);
+}
+
+static void
+bench_match(void)
+{
+  struct match_hist h;
+  const char *names[BENCH_BATCH];
+  dbref results[BENCH_BATCH];
+  uint64_t begin;
+  int r, i, j;
+
+  tdb_init();
+  tdb_srand(7);
+  world_city(&w, 300, 3);
+  world_populate(&w, 3000, 60);
+  world_generic(&w, 40, 800);
+  for (i = 0; i < BENCH_QUERIES; i++) {
+    queries[i].who = world_pick(w.players, w.nplayers);
+    snprintf(queries[i].name, sizeof queries[i].name, "%s", world_name());
+  }
+  tdb_end_command();
+
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      begin = match_stats_clock();
+      base_match_result(queries[i].who, queries[i].name, NOTYPE,
+                        MAT_EVERYTHING);
+      match_hist_add(&h, match_stats_clock() - begin);
+    }
+  report("match, old", &h);
+
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      tdb_end_command();
+      begin = match_stats_clock();
+      match_result(queries[i].who, queries[i].name, NOTYPE, MAT_EVERYTHING);
+      match_hist_add(&h, match_stats_clock() - begin);
+    }
+  report("match, new", &h);
+
+  memset(&h, 0, sizeof h);
+  tdb_end_command();
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      begin = match_stats_clock();
+      match_result(queries[i].who, queries[i].name, NOTYPE, MAT_EVERYTHING);
+      match_hist_add(&h, match_stats_clock() - begin);
+    }
+  report("match, new, one command", &h);
+
+  /* a batch's time is shared between its names */
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i + BENCH_BATCH <= BENCH_QUERIES; i += BENCH_BATCH) {
+      for (j = 0; j < BENCH_BATCH; j++)
+        names[j] = queries[i + j].name;
+      tdb_end_command();
+      begin = match_stats_clock();
+      match_result_batch(queries[i].who, queries[i].who, names, BENCH_BATCH,
+                         NOTYPE, MAT_EVERYTHING, results);
+      begin = (match_stats_clock() - begin) / BENCH_BATCH;
+      for (j = 0; j < BENCH_BATCH; j++)
+        match_hist_add(&h, begin);
+    }
+  report("match, new, batched", &h);
+  world_free(&w);
+}
+
+static void
+bench_path(void)
+{
+  struct match_hist h;
+  SCRATCH_MARK mark;
+  dbref npc, from[BENCH_QUERIES], to[BENCH_QUERIES];
+  uint64_t begin;
+  int r, i;
+
+  tdb_init();
+  tdb_srand(11);
+  world_grid(&w, 20, 20);
+  world_block(&w, 5);
+  npc = tdb_create("Guard", TYPE_THING, w.rooms[0]);
+  tdb_set_flag(npc, F_BIT_NPC, 1);
+  for (i = 0; i < BENCH_QUERIES; i++) {
+    from[i] = world_pick(w.rooms, w.nrooms);
+    to[i] = world_pick(w.rooms, w.nrooms);
+  }
+  tdb_timer();
+
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      begin = match_stats_clock();
+      base_npc_findpath(npc, from[i], to[i]);
+      match_hist_add(&h, match_stats_clock() - begin);
+    }
+  report("npc path, old", &h);
+
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      scratch_mark(&mark);
+      begin = match_stats_clock();
+      npc_findpath_unbudgeted(npc, from[i], to[i]);
+      match_hist_add(&h, match_stats_clock() - begin);
+      scratch_release(&mark);
+    }
+  report("npc path, new", &h);
+
+  memset(&h, 0, sizeof h);
+  for (r = 0; r < BENCH_ROUNDS; r++)
+    for (i = 0; i < BENCH_QUERIES; i++) {
+      mudtime += NPC_BUDGET_INTERVAL;
+      scratch_mark(&mark);
+      begin = match_stats_clock();
+      npc_findpath_crowd(npc, from[i], to[i]);
+      match_hist_add(&h, match_stats_clock() - begin);
+      scratch_release(&mark);
+    }
+  report("npc path, crowd routed", &h);
+  npc_crowd_release(npc);
+  world_free(&w);
+}
+
+int
+main(void)
+{
+  bench_match();
+  bench_path();
+  tdb_free();
+  return 0;
+}
@@ -0,0 +1,42 @@
+/* Test shim for PennMUSH's attrib.h: just what the modules use. */
+
+#ifndef __ATTRIB_H
+#define __ATTRIB_H
+
+#include "mushtype.h"
+
+typedef struct attr {
+  const char *name;
+  char *value;
+  int flags;
+  struct attr *next;
+} ATTR;
+
+#define AL_NAME(a) ((a)->name)
+#define AL_FLAGS(a) ((a)->flags)
+
+#define AF_PRIVATE 0x10         /* no_inherit */
+#define AF_REGEXP 0x1000
+#define AF_CASE 0x2000
+#define AF_SAFE 0x4000          /* can't be cleared */
+
+#define AE_OKAY 0
+#define AE_ERROR (-1)
+#define AE_SAFE (-2)
+
+typedef int (*aig_func) (dbref player, dbref thing, dbref parent,
+                         const char *pattern, ATTR *atr, void *args);
+
+extern char *atr_value(ATTR *atr);
+extern ATTR *atr_get(dbref thing, const char *name);
+extern ATTR *atr_get_noparent(dbref thing, const char *name);
+extern int atr_iter_get(dbref player, dbref thing, const char *name,
+                        int mortal, int regexp, aig_func func, void *args);
+extern int atr_iter_get_parent(dbref player, dbref thing, const char *name,
+                               int mortal, int regexp, aig_func func,
+                               void *args);
+extern int atr_add(dbref thing, const char *atr, const char *s,
+                   dbref player, unsigned int flags);
+extern int atr_clr(dbref thing, const char *atr, dbref player);
+
+#endif                          /* __ATTRIB_H */
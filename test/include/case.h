@@ -0,0 +1,11 @@
+/* Test shim for PennMUSH's case.h. */
+
+#ifndef __CASE_H
+#define __CASE_H
+
+#include <ctype.h>
+
+#define DOWNCASE(x) ((unsigned char) tolower((unsigned char) (x)))
+#define UPCASE(x) ((unsigned char) toupper((unsigned char) (x)))
+
+#endif                          /* __CASE_H */
@@ -0,0 +1,27 @@
+/* Test shim for PennMUSH's conf.h: just what the modules use. */
+
+#ifndef __CONF_H
+#define __CONF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "mushtype.h"
+
+#define BUFFER_LEN 8192
+#define MAX_PARENTS 10
+#define MAX_ARG 1024
+
+#define NUMBER_TOKEN '#'
+#define LOOKUP_TOKEN '*'
+#define EXIT_DELIMITER ';'
+
+/* The stub db always has these */
+#define GOD 1
+#define MASTER_ROOM 2
+
+extern time_t mudtime;
+
+#endif                          /* __CONF_H */
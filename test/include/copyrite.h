@@ -0,0 +1 @@
+/* Test shim for PennMUSH's copyrite.h. */
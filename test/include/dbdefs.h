@@ -0,0 +1,71 @@
+/* Test shim for PennMUSH's dbdefs.h: the in-memory db in stubdb.c. */
+
+#ifndef __DBDEFS_H
+#define __DBDEFS_H
+
+#include "conf.h"
+#include "mushtype.h"
+
+#define TYPE_ROOM 0x1
+#define TYPE_THING 0x2
+#define TYPE_EXIT 0x4
+#define TYPE_PLAYER 0x8
+#define TYPE_GARBAGE 0x10
+#define NOTYPE 0xFFFF
+
+struct attr;
+
+struct object {
+  const char *name;
+  dbref location;     /* also an exit's destination */
+  dbref contents;
+  dbref exits;        /* also an exit's source, a thing's home */
+  dbref next;
+  dbref parent;
+  dbref zone;
+  dbref owner;
+  int type;
+  unsigned char flags[4];
+  time_t creation_time;
+  struct attr *list;  /* attributes, in name order */
+  dbref lock_deny;    /* could_doit() fails for this one (or ANY_DBREF) */
+  dbref see_deny;     /* can_interact() fails for this one */
+};
+
+extern struct object *db;
+extern dbref db_top;
+
+#define Name(x) (db[(x)].name)
+#define Location(x) (db[(x)].location)
+#define Contents(x) (db[(x)].contents)
+#define Exits(x) (db[(x)].exits)
+#define Next(x) (db[(x)].next)
+#define Source(x) (db[(x)].exits)
+#define Home(x) (db[(x)].exits)
+#define Destination(x) (db[(x)].location)
+#define Zone(x) (db[(x)].zone)
+#define Parent(x) (db[(x)].parent)
+#define Owner(x) (db[(x)].owner)
+#define Typeof(x) (db[(x)].type)
+#define Flags(x) (db[(x)].flags)
+#define CreTime(x) (db[(x)].creation_time)
+
+#define IsRoom(x) (Typeof(x) == TYPE_ROOM)
+#define IsThing(x) (Typeof(x) == TYPE_THING)
+#define IsExit(x) (Typeof(x) == TYPE_EXIT)
+#define IsPlayer(x) (Typeof(x) == TYPE_PLAYER)
+#define IsGarbage(x) (Typeof(x) == TYPE_GARBAGE)
+
+#define GoodObject(x) ((x) >= 0 && (x) < db_top)
+#define RealGoodObject(x) (GoodObject(x) && !IsGarbage(x))
+
+#define DOLIST(var, first) \
+  for ((var) = (first); GoodObject((var)); (var) = Next(var))
+
+extern dbref first_visible(dbref player, dbref thing);
+
+#define DOLIST_VISIBLE(var, first, player) \
+  for ((var) = first_visible((player), (first)); GoodObject((var)); \
+       (var) = first_visible((player), Next(var)))
+
+#endif                          /* __DBDEFS_H */
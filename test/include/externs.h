@@ -0,0 +1,34 @@
+/* Test shim for PennMUSH's externs.h: just what the modules use. */
+
+#ifndef __EXTERNS_H
+#define __EXTERNS_H
+
+#include "mushtype.h"
+
+/* The real externs.h gets these to its users one way or another */
+#include "case.h"
+#include "flags.h"
+#include "game.h"
+#include "lock.h"
+#include "mushdb.h"
+
+#define T(x) x
+
+#define INTERACT_SEE 0x1
+#define INTERACT_HEAR 0x2
+#define INTERACT_MATCH 0x4
+#define INTERACT_PRESENCE 0x8
+
+extern int can_interact(dbref from, dbref to, int type,
+                        NEW_PE_INFO *pe_info);
+extern int controls(dbref who, dbref what);
+extern int nearby(dbref obj1, dbref obj2);
+extern dbref lookup_player(const char *name);
+extern dbref visible_short_page(dbref player, const char *match);
+extern dbref match_thing(dbref player, const char *name);
+extern int check_alias(const char *command, const char *list);
+
+extern int list2arr(char *r[], int max, char *list, char sep, int nullok);
+extern void notify_format(dbref player, const char *fmt, ...);
+
+#endif                          /* __EXTERNS_H */
@@ -0,0 +1,23 @@
+/* Test shim for PennMUSH's flags.h: just what the modules use. */
+
+#ifndef __FLAGS_H
+#define __FLAGS_H
+
+#include "mushtype.h"
+
+typedef struct flag_info {
+  const char *name;
+  char letter;
+  int type;
+  int bitpos;
+  int perms;
+  int negate_perms;
+} FLAG;
+
+#define F_DISABLED 0x100
+
+extern FLAG *match_flag(const char *name);
+extern int has_flag_by_name(dbref thing, const char *flag, int type);
+extern int has_bit(object_flag_type flags, int bitpos);
+
+#endif                          /* __FLAGS_H */
@@ -0,0 +1,30 @@
+/* Test shim for PennMUSH's function.h: just what the modules use. */
+
+#ifndef __FUNCTION_H
+#define __FUNCTION_H
+
+#include "mushtype.h"
+
+#define FN_REG 0x0
+#define FN_WIZARD 0x10
+#define FN_NOPARSE 0x20
+#define FN_LITERAL 0x40
+
+typedef void (*function_func) (FUN *, char *, char **, int, char *[], int[],
+                               dbref, dbref, dbref, const char *,
+                               NEW_PE_INFO *, int);
+
+#define FUNCTION(fun_name) \
+  void fun_name(FUN *fun __attribute__ ((__unused__)), char *buff, \
+                char **bp, int nargs __attribute__ ((__unused__)), \
+                char *args[], int arglen[] __attribute__ ((__unused__)), \
+                dbref executor, dbref caller __attribute__ ((__unused__)), \
+                dbref enactor __attribute__ ((__unused__)), \
+                char const *called_as __attribute__ ((__unused__)), \
+                NEW_PE_INFO *pe_info __attribute__ ((__unused__)), \
+                int eflags __attribute__ ((__unused__)))
+
+extern void function_add(const char *name, function_func fun, int minargs,
+                         int maxargs, int ftype);
+
+#endif                          /* __FUNCTION_H */
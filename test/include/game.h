@@ -0,0 +1,14 @@
+/* Test shim for PennMUSH's game.h: just what the modules use. */
+
+#ifndef __GAME_H
+#define __GAME_H
+
+#include "mushtype.h"
+
+#define QUEUE_DEFAULT 0
+
+extern int queue_attribute_base(dbref executor, const char *atrname,
+                                dbref enactor, int noparent,
+                                PE_REGS *pe_regs, int flags);
+
+#endif                          /* __GAME_H */
@@ -0,0 +1,29 @@
+/* Test shim for PennMUSH's htab.h: a chained hash with string keys. */
+
+#ifndef __HTAB_H
+#define __HTAB_H
+
+#include <stdbool.h>
+
+struct hash_ent;
+
+typedef struct hashtable {
+  int size;
+  int entries;
+  struct hash_ent **buckets;
+  void (*free_data) (void *);
+  int iter_bucket;              /* for hash_firstentry()/hash_nextentry() */
+  struct hash_ent *iter_ent;
+} HASHTAB;
+
+extern void hash_init(HASHTAB *htab, int size, void (*free_data) (void *));
+extern void *hashfind(const char *key, HASHTAB *htab);
+extern bool hashadd(const char *key, void *data, HASHTAB *htab);
+extern void hashdelete(const char *key, HASHTAB *htab);
+extern void hashfree(HASHTAB *htab);
+extern void *hash_firstentry(HASHTAB *htab);
+extern void *hash_nextentry(HASHTAB *htab);
+extern const char *hash_firstentry_key(HASHTAB *htab);
+extern const char *hash_nextentry_key(HASHTAB *htab);
+
+#endif                          /* __HTAB_H */
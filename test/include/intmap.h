@@ -0,0 +1,20 @@
+/* Test shim for PennMUSH's intmap.h. */
+
+#ifndef __INTMAP_H
+#define __INTMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint32_t im_key;
+typedef struct intmap intmap;
+
+extern intmap *im_new(void);
+extern void im_destroy(intmap *im);
+extern int64_t im_count(intmap *im);
+extern bool im_insert(intmap *im, im_key key, void *data);
+extern void *im_find(intmap *im, im_key key);
+extern bool im_exists(intmap *im, im_key key);
+extern bool im_delete(intmap *im, im_key key);
+
+#endif                          /* __INTMAP_H */
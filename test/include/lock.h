@@ -0,0 +1,10 @@
+/* Test shim for PennMUSH's lock.h: just what the modules use. */
+
+#ifndef __LOCK_H
+#define __LOCK_H
+
+#include "mushtype.h"
+
+extern int could_doit(dbref player, dbref thing, NEW_PE_INFO *pe_info);
+
+#endif                          /* __LOCK_H */
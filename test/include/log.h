@@ -0,0 +1,11 @@
+/* Test shim for PennMUSH's log.h. */
+
+#ifndef __LOG_H
+#define __LOG_H
+
+#define LT_ERR 0
+#define LT_TRACE 1
+
+extern void do_rawlog(int logtype, const char *fmt, ...);
+
+#endif                          /* __LOG_H */
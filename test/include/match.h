@@ -0,0 +1,48 @@
+/* Test shim for PennMUSH's match.h. */
+
+#ifndef __MATCH_H
+#define __MATCH_H
+
+#include "mushtype.h"
+
+#define MAT_CHECK_KEYS       0x0000001
+#define MAT_GLOBAL           0x0000002
+#define MAT_REMOTES          0x0000004
+#define MAT_NEAR             0x0000008
+#define MAT_CONTROL          0x0000010
+#define MAT_ME               0x0000020
+#define MAT_HERE             0x0000040
+#define MAT_ABSOLUTE         0x0000080
+#define MAT_PLAYER           0x0000100
+#define MAT_NEIGHBOR         0x0000200
+#define MAT_POSSESSION       0x0000400
+#define MAT_EXIT             0x0000800
+#define MAT_PMATCH           0x0001000
+#define MAT_CARRIED_EXIT     0x0002000
+#define MAT_CONTAINER        0x0004000
+#define MAT_REMOTE_CONTENTS  0x0008000
+#define MAT_NOISY            0x0010000
+#define MAT_LAST             0x0020000
+#define MAT_ENGLISH          0x0040000
+#define MAT_TYPE             0x0080000
+#define MAT_EXACT            0x0100000
+#define MAT_CONTENTS         0x0200000
+
+#define MAT_EVERYTHING (MAT_ME | MAT_HERE | MAT_ABSOLUTE | MAT_PLAYER | \
+                        MAT_NEIGHBOR | MAT_POSSESSION | MAT_EXIT | \
+                        MAT_ENGLISH)
+#define MAT_NEARBY (MAT_EVERYTHING | MAT_NEAR)
+#define MAT_REMOTE (MAT_ABSOLUTE | MAT_PLAYER | MAT_REMOTE_CONTENTS | \
+                    MAT_EXIT | MAT_REMOTES)
+
+extern dbref match_result(dbref who, const char *name, int type, long flags);
+extern dbref match_result_relative(dbref who, dbref where, const char *name,
+                                   int type, long flags);
+extern dbref noisy_match_result(dbref who, const char *name, int type,
+                                long flags);
+extern dbref last_match_result(dbref who, const char *name, int type,
+                               long flags);
+extern dbref match_controlled(dbref player, const char *name);
+extern int match_aliases(dbref match, const char *name);
+
+#endif                          /* __MATCH_H */
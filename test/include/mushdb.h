@@ -0,0 +1,26 @@
+/* Test shim for PennMUSH's mushdb.h: the flag tests the modules use. */
+
+#ifndef __MUSHDB_H
+#define __MUSHDB_H
+
+#include "dbdefs.h"
+#include "flags.h"
+
+/* Bits of the flags the stub db knows; see stubdb.c */
+#define F_BIT_GENERIC 0
+#define F_BIT_NPC 1
+#define F_BIT_DARK 2
+#define F_BIT_LIGHT 3
+#define F_BIT_OPAQUE 4
+#define F_BIT_WIZARD 5
+
+#define Dark(x) (has_bit(Flags(x), F_BIT_DARK))
+#define Light(x) (has_bit(Flags(x), F_BIT_LIGHT))
+#define Opaque(x) (has_bit(Flags(x), F_BIT_OPAQUE))
+#define Wizard(x) ((x) == GOD || has_bit(Flags(x), F_BIT_WIZARD))
+#define See_All(x) Wizard(x)
+#define Long_Fingers(x) 0
+#define Can_Examine(p, x) controls(p, x)
+#define DarkLegal(x) (Dark(x) && (Wizard(x) || !IsPlayer(x)))
+
+#endif                          /* __MUSHDB_H */
@@ -0,0 +1,21 @@
+/* Test shim for PennMUSH's mushtype.h: just what the modules use. */
+
+#ifndef __MUSHTYPE_H
+#define __MUSHTYPE_H
+
+#include <stdint.h>
+#include <time.h>
+
+typedef int dbref;
+
+#define NOTHING (-1)
+#define AMBIGUOUS (-2)
+#define HOME (-3)
+
+typedef unsigned char *object_flag_type;
+
+typedef struct new_pe_info NEW_PE_INFO;
+typedef struct pe_regs PE_REGS;
+typedef struct fun FUN;
+
+#endif                          /* __MUSHTYPE_H */
@@ -0,0 +1,15 @@
+/* Test shim for PennMUSH's mymalloc.h. The stub counts live blocks by
+ * check name, so tests can look for leaks; see stubdb.h. */
+
+#ifndef __MYMALLOC_H
+#define __MYMALLOC_H
+
+#include <stddef.h>
+
+extern void *mush_malloc(size_t size, const char *check);
+extern void *mush_calloc(size_t count, size_t size, const char *check);
+extern void *mush_realloc(void *ptr, size_t size, const char *check);
+extern char *mush_strdup(const char *s, const char *check);
+extern void mush_free(void *ptr, const char *check);
+
+#endif                          /* __MYMALLOC_H */
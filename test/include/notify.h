@@ -0,0 +1,11 @@
+/* Test shim for PennMUSH's notify.h. The stub records what each object
+ * is told; see stubdb.h. */
+
+#ifndef __NOTIFY_H
+#define __NOTIFY_H
+
+#include "mushtype.h"
+
+extern void notify(dbref player, const char *msg);
+
+#endif                          /* __NOTIFY_H */
@@ -0,0 +1,43 @@
+/* Test shim for PennMUSH's parse.h: just what the modules use. */
+
+#ifndef __PARSE_H
+#define __PARSE_H
+
+#include <stdint.h>
+
+#include "mushtype.h"
+
+#define e_perm "#-1 PERMISSION DENIED"
+#define e_match "#-1 NO MATCH"
+#define e_int "#-1 ARGUMENT MUST BE INTEGER"
+#define e_notvis "#-1 NO SUCH OBJECT VISIBLE"
+
+#define PE_DEFAULT 0
+#define PT_DEFAULT 0
+
+#define PE_REGS_Q 0x1
+#define PE_REGS_REGEXP 0x2
+#define PE_REGS_ARG 0x10
+
+extern dbref parse_objid(const char *str);
+extern dbref parse_dbref(const char *str);
+extern int parse_integer(const char *str);
+extern int parse_int(const char *s, char **end, int base);
+extern int parse_boolean(const char *str);
+extern int is_strict_integer(const char *str);
+extern int is_integer(const char *str);
+extern const char *unparse_dbref(dbref num);
+extern const char *unparse_integer(intmax_t num);
+
+extern PE_REGS *pe_regs_create_real(int pr_flags, const char *name);
+#define pe_regs_create(t, n) pe_regs_create_real(t, n)
+extern void pe_regs_free(PE_REGS *pe_regs);
+extern void pe_regs_set(PE_REGS *pe_regs, int type, const char *key,
+                        const char *val);
+extern void pe_regs_setenv(PE_REGS *pe_regs, int num, const char *val);
+
+extern int process_expression(char *buff, char **bp, char const **str,
+                              dbref executor, dbref caller, dbref enactor,
+                              int eflags, int tflags, NEW_PE_INFO *pe_info);
+
+#endif                          /* __PARSE_H */
@@ -0,0 +1,27 @@
+/* Test shim for PennMUSH's strutil.h: just what the modules use. */
+
+#ifndef __STRUTIL_H
+#define __STRUTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mushtype.h"
+
+extern size_t mush_strncpy(char *dst, const char *src, size_t len);
+extern int safe_str(const char *s, char *buff, char **bp);
+extern int safe_strl(const char *s, size_t len, char *buff, char **bp);
+extern int safe_chr(char c, char *buff, char **bp);
+extern int safe_dbref(dbref d, char *buff, char **bp);
+extern int safe_integer(intmax_t i, char *buff, char **bp);
+extern int safe_format(char *buff, char **bp, const char *fmt, ...)
+  __attribute__ ((__format__(__printf__, 3, 4)));
+extern char *string_match(const char *src, const char *sub);
+extern int string_prefix(const char *string, const char *prefix);
+extern char *strupper(const char *s);
+extern char *strlower(const char *s);
+extern char *remove_markup(const char *orig, size_t *stripped_len);
+extern char *trim_space_sep(char *str, char sep);
+extern char *split_token(char **sp, char sep);
+
+#endif                          /* __STRUTIL_H */
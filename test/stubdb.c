@@ -0,0 +1,1582 @@
+/* stubdb.c
+ * an in-memory stand-in for the parts of the PennMUSH server the generic
+ * and npc modules use. the string and permission routines follow the
+ * server's closely enough that the modules and the baseline code they
+ * replace give the same answers on top of them; see stubdb.h. */
+
+#include "stubdb.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "attrib.h"
+#include "externs.h"
+#include "flags.h"
+#include "function.h"
+#include "game.h"
+#include "htab.h"
+#include "intmap.h"
+#include "log.h"
+#include "match.h"
+#include "mushdb.h"
+#include "mymalloc.h"
+#include "notify.h"
+#include "parse.h"
+#include "strutil.h"
+
+#include "flag_handle.h"
+#include "generic.h"
+#include "match_index.h"
+#include "match_stats.h"
+#include "npc.h"
+#include "scratch.h"
+
+struct object *db = NULL;
+dbref db_top = 0;
+static dbref db_size = 0;
+time_t mudtime = 1000000;
+
+unsigned long tdb_interact_calls = 0;
+static long live_blocks = 0;
+
+/* ---------------------------------------------------------------------
+ * output capture
+ */
+
+struct tdb_log {
+  char *text;
+  size_t len, size;
+};
+
+static struct tdb_log told_log, queued_log;
+
+static void
+tdb_log_add(struct tdb_log *l, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  for (;;) {
+    va_start(ap, fmt);
+    n = vsnprintf(l->text ? l->text + l->len : NULL,
+                  l->text ? l->size - l->len : 0, fmt, ap);
+    va_end(ap);
+    if (l->text && l->len + n < l->size)
+      break;
+    l->size = (l->size + n + 1) * 2;
+    l->text = realloc(l->text, l->size);
+    l->text[l->len] = '\0';
+  }
+  l->len += n;
+}
+
+static void
+tdb_log_clear(struct tdb_log *l)
+{
+  l->len = 0;
+  if (l->text)
+    l->text[0] = '\0';
+}
+
+const char *
+tdb_told(void)
+{
+  return told_log.text ? told_log.text : "";
+}
+
+void
+tdb_told_clear(void)
+{
+  tdb_log_clear(&told_log);
+}
+
+const char *
+tdb_queued(void)
+{
+  return queued_log.text ? queued_log.text : "";
+}
+
+void
+tdb_queued_clear(void)
+{
+  tdb_log_clear(&queued_log);
+}
+
+void
+notify(dbref player, const char *msg)
+{
+  tdb_log_add(&told_log, "#%d %s\n", player, msg);
+}
+
+void
+notify_format(dbref player, const char *fmt, ...)
+{
+  char buff[BUFFER_LEN];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(buff, sizeof buff, fmt, ap);
+  va_end(ap);
+  notify(player, buff);
+}
+
+void
+do_rawlog(int logtype __attribute__ ((__unused__)), const char *fmt, ...)
+{
+  (void) fmt;
+}
+
+/* ---------------------------------------------------------------------
+ * memory
+ */
+
+void *
+mush_malloc(size_t size, const char *check __attribute__ ((__unused__)))
+{
+  live_blocks++;
+  return malloc(size ? size : 1);
+}
+
+void *
+mush_calloc(size_t count, size_t size,
+            const char *check __attribute__ ((__unused__)))
+{
+  live_blocks++;
+  return calloc(count ? count : 1, size ? size : 1);
+}
+
+void *
+mush_realloc(void *ptr, size_t size,
+             const char *check __attribute__ ((__unused__)))
+{
+  if (!ptr)
+    live_blocks++;
+  return realloc(ptr, size ? size : 1);
+}
+
+char *
+mush_strdup(const char *s, const char *check)
+{
+  size_t len = strlen(s) + 1;
+  char *p = mush_malloc(len, check);
+
+  memcpy(p, s, len);
+  return p;
+}
+
+void
+mush_free(void *ptr, const char *check __attribute__ ((__unused__)))
+{
+  if (!ptr)
+    return;
+  live_blocks--;
+  free(ptr);
+}
+
+long
+tdb_live_blocks(void)
+{
+  return live_blocks;
+}
+
+/* ---------------------------------------------------------------------
+ * strings
+ */
+
+size_t
+mush_strncpy(char *dst, const char *src, size_t len)
+{
+  size_t n = 0;
+
+  if (!len)
+    return 0;
+  while (n < len - 1 && src[n]) {
+    dst[n] = src[n];
+    n++;
+  }
+  dst[n] = '\0';
+  return n;
+}
+
+int
+safe_strl(const char *s, size_t len, char *buff, char **bp)
+{
+  size_t room = buff + BUFFER_LEN - 1 - *bp;
+  int over = 0;
+
+  if (len > room) {
+    len = room;
+    over = 1;
+  }
+  memcpy(*bp, s, len);
+  *bp += len;
+  return over;
+}
+
+int
+safe_str(const char *s, char *buff, char **bp)
+{
+  if (!s)
+    return 0;
+  return safe_strl(s, strlen(s), buff, bp);
+}
+
+int
+safe_chr(char c, char *buff, char **bp)
+{
+  return safe_strl(&c, 1, buff, bp);
+}
+
+int
+safe_format(char *buff, char **bp, const char *fmt, ...)
+{
+  char tbuf[BUFFER_LEN];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(tbuf, sizeof tbuf, fmt, ap);
+  va_end(ap);
+  return safe_str(tbuf, buff, bp);
+}
+
+int
+safe_integer(intmax_t i, char *buff, char **bp)
+{
+  return safe_format(buff, bp, "%jd", i);
+}
+
+int
+safe_dbref(dbref d, char *buff, char **bp)
+{
+  return safe_format(buff, bp, "#%d", d);
+}
+
+const char *
+unparse_dbref(dbref num)
+{
+  static char buff[32];
+
+  snprintf(buff, sizeof buff, "#%d", num);
+  return buff;
+}
+
+const char *
+unparse_integer(intmax_t num)
+{
+  static char buff[32];
+
+  snprintf(buff, sizeof buff, "%jd", num);
+  return buff;
+}
+
+int
+string_prefix(const char *string, const char *prefix)
+{
+  if (!string || !prefix)
+    return 0;
+  while (*string && *prefix) {
+    if (DOWNCASE(*string) != DOWNCASE(*prefix))
+      return 0;
+    string++, prefix++;
+  }
+  return *prefix == '\0';
+}
+
+char *
+string_match(const char *src, const char *sub)
+{
+  if (!src || !sub)
+    return NULL;
+  if (*sub != '\0') {
+    while (*src) {
+      if (string_prefix(src, sub))
+        return (char *) src;
+      while (*src && isalnum((unsigned char) *src))
+        src++;
+      while (*src && !isalnum((unsigned char) *src))
+        src++;
+    }
+  }
+  return NULL;
+}
+
+int
+check_alias(const char *command, const char *list)
+{
+  const char *p;
+
+  while (*list) {
+    for (p = command; (*p && DOWNCASE(*p) == DOWNCASE(*list)
+                       && *list != EXIT_DELIMITER); p++, list++) ;
+    if (*p == '\0') {
+      while (isspace((unsigned char) *list))
+        list++;
+      if (*list == '\0' || *list == EXIT_DELIMITER)
+        return 1;
+    }
+    while (*list && *list++ != EXIT_DELIMITER) ;
+    while (isspace((unsigned char) *list))
+      list++;
+  }
+  return 0;
+}
+
+char *
+strupper(const char *s)
+{
+  static char buff[BUFFER_LEN];
+  char *p = buff;
+
+  while (*s && p < buff + BUFFER_LEN - 1)
+    *p++ = UPCASE(*s++);
+  *p = '\0';
+  return buff;
+}
+
+char *
+strlower(const char *s)
+{
+  static char buff[BUFFER_LEN];
+  char *p = buff;
+
+  while (*s && p < buff + BUFFER_LEN - 1)
+    *p++ = DOWNCASE(*s++);
+  *p = '\0';
+  return buff;
+}
+
+char *
+remove_markup(const char *orig, size_t *stripped_len)
+{
+  static char buff[BUFFER_LEN];
+  size_t n = mush_strncpy(buff, orig, BUFFER_LEN);
+
+  if (stripped_len)
+    *stripped_len = n + 1;
+  return buff;
+}
+
+char *
+trim_space_sep(char *str, char sep)
+{
+  char *p;
+
+  if (sep != ' ')
+    return str;
+  while (*str == ' ')
+    str++;
+  p = str + strlen(str);
+  while (p > str && p[-1] == ' ')
+    *--p = '\0';
+  return str;
+}
+
+char *
+split_token(char **sp, char sep)
+{
+  char *str, *save;
+
+  save = str = *sp;
+  if (!str) {
+    *sp = NULL;
+    return NULL;
+  }
+  while (*str && *str != sep)
+    str++;
+  if (*str) {
+    *str++ = '\0';
+    if (sep == ' ')
+      while (*str == ' ')
+        str++;
+  } else {
+    str = NULL;
+  }
+  *sp = str;
+  return save;
+}
+
+int
+list2arr(char *r[], int max, char *list, char sep,
+         int nullok __attribute__ ((__unused__)))
+{
+  char *p;
+  int n = 0;
+
+  list = trim_space_sep(list, sep);
+  if (!*list)
+    return 0;
+  p = list;
+  while (p && n < max)
+    r[n++] = split_token(&p, sep);
+  return n;
+}
+
+int
+is_strict_integer(const char *str)
+{
+  if (!str)
+    return 0;
+  if (*str == '-' || *str == '+')
+    str++;
+  if (!isdigit((unsigned char) *str))
+    return 0;
+  while (isdigit((unsigned char) *str))
+    str++;
+  return *str == '\0';
+}
+
+int
+is_integer(const char *str)
+{
+  char buff[BUFFER_LEN];
+
+  mush_strncpy(buff, str, BUFFER_LEN);
+  return is_strict_integer(trim_space_sep(buff, ' '));
+}
+
+int
+parse_integer(const char *str)
+{
+  return (int) strtol(str, NULL, 10);
+}
+
+int
+parse_int(const char *s, char **end, int base)
+{
+  return (int) strtol(s, end, base);
+}
+
+int
+parse_boolean(const char *str)
+{
+  if (!str || !*str)
+    return 0;
+  if (*str == '#')
+    return str[1] != '-';
+  if (is_strict_integer(str))
+    return parse_integer(str) != 0;
+  return 1;
+}
+
+dbref
+parse_dbref(const char *str)
+{
+  const char *p;
+  dbref num;
+
+  if (!str || *str != NUMBER_TOKEN || !str[1])
+    return NOTHING;
+  for (p = str + 1; isdigit((unsigned char) *p); p++) ;
+  if (*p)
+    return NOTHING;
+  num = atoi(str + 1);
+  if (!GoodObject(num))
+    return NOTHING;
+  return num;
+}
+
+dbref
+parse_objid(const char *str)
+{
+  char buff[BUFFER_LEN];
+  char *p;
+  dbref it;
+
+  if (!str || !(p = strchr(str, ':')))
+    return parse_dbref(str);
+  mush_strncpy(buff, str, BUFFER_LEN);
+  p = buff + (p - str);
+  *p++ = '\0';
+  it = parse_dbref(buff);
+  if (GoodObject(it) && is_strict_integer(p) &&
+      CreTime(it) == (time_t) strtol(p, NULL, 10))
+    return it;
+  return NOTHING;
+}
+
+/* ---------------------------------------------------------------------
+ * flags
+ */
+
+static FLAG flag_table[] = {
+  {"GENERIC", 'g', TYPE_THING, F_BIT_GENERIC, 0, 0},
+  {"NPC", 'n', NOTYPE, F_BIT_NPC, 0, 0},
+  {"DARK", 'D', NOTYPE, F_BIT_DARK, 0, 0},
+  {"LIGHT", 'l', NOTYPE, F_BIT_LIGHT, 0, 0},
+  {"OPAQUE", 'O', NOTYPE, F_BIT_OPAQUE, 0, 0},
+  {"WIZARD", 'W', NOTYPE, F_BIT_WIZARD, 0, 0},
+  {NULL, 0, 0, 0, 0, 0}
+};
+
+FLAG *
+match_flag(const char *name)
+{
+  FLAG *f;
+
+  for (f = flag_table; f->name; f++)
+    if (!strcasecmp(f->name, name))
+      return f;
+  return NULL;
+}
+
+int
+has_bit(object_flag_type flags, int bitpos)
+{
+  return (flags[bitpos >> 3] >> (bitpos & 7)) & 1;
+}
+
+int
+has_flag_by_name(dbref thing, const char *flag, int type)
+{
+  FLAG *f = match_flag(flag);
+
+  if (!f || (f->perms & F_DISABLED) || !GoodObject(thing) ||
+      !(Typeof(thing) & type))
+    return 0;
+  return has_bit(Flags(thing), f->bitpos);
+}
+
+/* @flag/disable or /enable; see HOOKS */
+void
+tdb_flag_disable(const char *name, int disabled)
+{
+  FLAG *f = match_flag(name);
+
+  if (disabled)
+    f->perms |= F_DISABLED;
+  else
+    f->perms &= ~F_DISABLED;
+  flag_handles_reset();
+  match_cache_clear();
+}
+
+/* ---------------------------------------------------------------------
+ * permissions
+ */
+
+int
+controls(dbref who, dbref what)
+{
+  if (!GoodObject(who) || !GoodObject(what))
+    return 0;
+  if (who == GOD)
+    return 1;
+  if (what == GOD)
+    return 0;
+  if (Wizard(who))
+    return 1;
+  return who == what || Owner(who) == Owner(what);
+}
+
+int
+can_interact(dbref from, dbref to, int type __attribute__ ((__unused__)),
+             NEW_PE_INFO *pe_info __attribute__ ((__unused__)))
+{
+  tdb_interact_calls++;
+  if (!GoodObject(from))
+    return 1;
+  return !(db[from].see_deny == to || db[from].see_deny == TDB_EVERYONE);
+}
+
+int
+could_doit(dbref player, dbref thing,
+           NEW_PE_INFO *pe_info __attribute__ ((__unused__)))
+{
+  return !(db[thing].lock_deny == player ||
+           db[thing].lock_deny == TDB_EVERYONE);
+}
+
+int
+nearby(dbref obj1, dbref obj2)
+{
+  dbref loc1, loc2;
+
+  if (!GoodObject(obj1) || !GoodObject(obj2))
+    return 0;
+  if (IsRoom(obj1) && IsRoom(obj2))
+    return 0;
+  loc1 = Location(obj1);
+  if (loc1 == obj2)
+    return 1;
+  loc2 = Location(obj2);
+  return loc2 == obj1 || loc2 == loc1;
+}
+
+dbref
+first_visible(dbref player, dbref thing)
+{
+  int lck = 0;
+  int ldark;
+  dbref loc;
+
+  if (!GoodObject(thing) || IsRoom(thing))
+    return NOTHING;
+  loc = IsExit(thing) ? Source(thing) : Location(thing);
+  if (!GoodObject(loc))
+    return NOTHING;
+  ldark = IsPlayer(loc) ? Opaque(loc) : Dark(loc);
+
+  while (GoodObject(thing)) {
+    if (can_interact(thing, player, INTERACT_SEE, NULL)) {
+      if (DarkLegal(thing) || (ldark && !Light(thing))) {
+        if (!lck) {
+          if (See_All(player) || loc == player || controls(player, loc))
+            return thing;
+          lck = 1;
+        }
+        if (controls(player, thing))
+          return thing;
+      } else {
+        return thing;
+      }
+    }
+    thing = Next(thing);
+  }
+  return thing;
+}
+
+dbref
+lookup_player(const char *name)
+{
+  dbref i;
+
+  if (*name == NUMBER_TOKEN) {
+    i = parse_objid(name);
+    return (GoodObject(i) && IsPlayer(i)) ? i : NOTHING;
+  }
+  for (i = 0; i < db_top; i++)
+    if (IsPlayer(i) && !strcasecmp(Name(i), name))
+      return i;
+  return NOTHING;
+}
+
+dbref
+visible_short_page(dbref player __attribute__ ((__unused__)),
+                   const char *match __attribute__ ((__unused__)))
+{
+  /* nobody is connected */
+  return NOTHING;
+}
+
+dbref
+match_thing(dbref player, const char *name)
+{
+  return noisy_match_result(player, name, NOTYPE, MAT_EVERYTHING);
+}
+
+/* ---------------------------------------------------------------------
+ * attributes
+ */
+
+/* attribute name wildcards: * doesn't match `, ** does, ? is any char */
+static int
+tdb_wild(const char *pat, const char *s)
+{
+  while (*pat) {
+    if (*pat == '*') {
+      int deep = pat[1] == '*';
+
+      pat += deep ? 2 : 1;
+      for (;;) {
+        if (tdb_wild(pat, s))
+          return 1;
+        if (!*s || (!deep && *s == '`'))
+          return 0;
+        s++;
+      }
+    }
+    if (!*s || (*pat != '?' && UPCASE(*pat) != UPCASE(*s)))
+      return 0;
+    pat++, s++;
+  }
+  return !*s;
+}
+
+char *
+atr_value(ATTR *atr)
+{
+  static char buff[BUFFER_LEN];
+
+  mush_strncpy(buff, atr->value, BUFFER_LEN);
+  return buff;
+}
+
+ATTR *
+atr_get_noparent(dbref thing, const char *name)
+{
+  ATTR *a;
+
+  if (!GoodObject(thing))
+    return NULL;
+  for (a = db[thing].list; a; a = a->next)
+    if (!strcasecmp(a->name, name))
+      return a;
+  return NULL;
+}
+
+ATTR *
+atr_get(dbref thing, const char *name)
+{
+  ATTR *a;
+  int depth;
+
+  for (depth = 0; GoodObject(thing) && depth <= MAX_PARENTS; depth++) {
+    a = atr_get_noparent(thing, name);
+    if (a && (!depth || !(a->flags & AF_PRIVATE)))
+      return a;
+    thing = Parent(thing);
+  }
+  return NULL;
+}
+
+int
+atr_iter_get(dbref player, dbref thing, const char *name,
+             int mortal __attribute__ ((__unused__)),
+             int regexp __attribute__ ((__unused__)), aig_func func,
+             void *args)
+{
+  ATTR *a, *next;
+  int result = 0;
+
+  if (!GoodObject(thing))
+    return 0;
+  for (a = db[thing].list; a; a = next) {
+    next = a->next;
+    if (tdb_wild(name, a->name) && func(player, thing, thing, name, a, args))
+      result++;
+  }
+  return result;
+}
+
+int
+atr_iter_get_parent(dbref player, dbref thing, const char *name,
+                    int mortal __attribute__ ((__unused__)),
+                    int regexp __attribute__ ((__unused__)), aig_func func,
+                    void *args)
+{
+  dbref chain[MAX_PARENTS + 1];
+  dbref parent;
+  ATTR *a, *next;
+  int n, i, j, shadowed, result = 0;
+
+  n = 0;
+  for (parent = thing; GoodObject(parent) && n <= MAX_PARENTS;
+       parent = Parent(parent))
+    chain[n++] = parent;
+
+  for (i = 0; i < n; i++) {
+    for (a = db[chain[i]].list; a; a = next) {
+      next = a->next;
+      if (!tdb_wild(name, a->name))
+        continue;
+      if (i && (a->flags & AF_PRIVATE))
+        continue;
+      /* hidden by what atr_get() would find first */
+      for (shadowed = 0, j = 0; j < i && !shadowed; j++) {
+        ATTR *b = atr_get_noparent(chain[j], a->name);
+
+        shadowed = b && (!j || !(b->flags & AF_PRIVATE));
+      }
+      if (!shadowed && func(player, thing, chain[i], name, a, args))
+        result++;
+    }
+  }
+  return result;
+}
+
+/* the server's hooks for a changed attribute; see HOOKS */
+static void
+tdb_attr_hooks(dbref thing, const char *name)
+{
+  if (!strcasecmp(name, "ALIAS"))
+    match_index_renamed(thing);
+  else if (!strncasecmp(name, GENERIC_ATTR, strlen(GENERIC_ATTR)))
+    generic_attr_changed(thing);
+  else if (!strncasecmp(name, "DIALOG`", 7))
+    npc_dialog_changed(thing);
+  else if (!strncasecmp(name, "NPC`", 4))
+    npc_graph_changed(thing);
+}
+
+static void
+tdb_attr_free(ATTR *a)
+{
+  free((char *) a->name);
+  free(a->value);
+  free(a);
+}
+
+/* set an attribute's value; flags are or'd into an existing one's, as
+ * atr_add() does, unless replace is set */
+static int
+tdb_attr_set(dbref thing, const char *name, const char *s, int flags,
+             int replace)
+{
+  ATTR **ap, *a;
+  char *uname;
+
+  if (!GoodObject(thing))
+    return AE_ERROR;
+  uname = strdup(strupper(name));
+  for (ap = &db[thing].list; *ap && strcmp((*ap)->name, uname) < 0;
+       ap = &(*ap)->next) ;
+  if (*ap && !strcmp((*ap)->name, uname)) {
+    a = *ap;
+    free(uname);
+    free(a->value);
+    if (!replace)
+      flags |= a->flags;
+  } else {
+    a = malloc(sizeof *a);
+    a->name = uname;
+    a->next = *ap;
+    *ap = a;
+  }
+  a->value = strdup(s);
+  a->flags = flags;
+  tdb_attr_hooks(thing, a->name);
+  return AE_OKAY;
+}
+
+int
+atr_add(dbref thing, const char *atr, const char *s,
+        dbref player __attribute__ ((__unused__)), unsigned int flags)
+{
+  if (!s || !*s)
+    return atr_clr(thing, atr, player);
+  return tdb_attr_set(thing, atr, s, (int) flags, 0);
+}
+
+int
+atr_clr(dbref thing, const char *atr,
+        dbref player __attribute__ ((__unused__)))
+{
+  ATTR **ap, *a;
+
+  if (!GoodObject(thing))
+    return AE_ERROR;
+  for (ap = &db[thing].list; *ap; ap = &(*ap)->next) {
+    if (!strcasecmp((*ap)->name, atr)) {
+      if ((*ap)->flags & AF_SAFE)
+        return AE_SAFE;
+      /* the hooks run once it's gone, as they do in the server */
+      a = *ap;
+      *ap = a->next;
+      a->next = NULL;
+      tdb_attr_hooks(thing, a->name);
+      tdb_attr_free(a);
+      return AE_OKAY;
+    }
+  }
+  return AE_OKAY;
+}
+
+void
+tdb_set_attr_flags(dbref thing, const char *name, const char *value,
+                   int flags)
+{
+  if (!value || !*value)
+    atr_clr(thing, name, GOD);
+  else
+    tdb_attr_set(thing, name, value, flags, 1);
+}
+
+void
+tdb_set_attr(dbref thing, const char *name, const char *value)
+{
+  ATTR *a = atr_get_noparent(thing, name);
+
+  tdb_set_attr_flags(thing, name, value, a ? a->flags : 0);
+}
+
+void
+tdb_clr_attr(dbref thing, const char *name)
+{
+  atr_clr(thing, name, GOD);
+}
+
+/* ---------------------------------------------------------------------
+ * softcode: functions, registers, the queue
+ */
+
+#define TDB_MAX_ARGS 8
+
+struct tdb_fun {
+  const char *name;
+  function_func fun;
+  int minargs, maxargs;
+};
+
+static struct tdb_fun *funs = NULL;
+static int nfuns = 0;
+
+void
+function_add(const char *name, function_func fun, int minargs, int maxargs,
+             int ftype __attribute__ ((__unused__)))
+{
+  funs = realloc(funs, (nfuns + 1) * sizeof *funs);
+  funs[nfuns].name = name;
+  funs[nfuns].fun = fun;
+  funs[nfuns].minargs = minargs;
+  funs[nfuns].maxargs = maxargs;
+  nfuns++;
+}
+
+const char *
+tdb_call(const char *name, dbref executor, int nargs, const char **args)
+{
+  static char buff[BUFFER_LEN];
+  static char abuf[TDB_MAX_ARGS][BUFFER_LEN];
+  char *argv[TDB_MAX_ARGS];
+  int arglen[TDB_MAX_ARGS];
+  char *bp = buff;
+  int i;
+
+  for (i = 0; i < nfuns; i++)
+    if (!strcasecmp(funs[i].name, name))
+      break;
+  /* a negative maxargs is the server's "the last one takes the rest" */
+  if (i == nfuns || nargs < funs[i].minargs || nargs > abs(funs[i].maxargs) ||
+      nargs > TDB_MAX_ARGS)
+    return "#-1 FUNCTION NOT FOUND";
+  for (int a = 0; a < nargs; a++) {
+    arglen[a] = (int) mush_strncpy(abuf[a], args[a], BUFFER_LEN);
+    argv[a] = abuf[a];
+  }
+  funs[i].fun(NULL, buff, &bp, nargs, argv, arglen, executor, executor,
+              executor, name, NULL, 0);
+  *bp = '\0';
+  return buff;
+}
+
+struct pe_regs {
+  char env[10][BUFFER_LEN];
+};
+
+PE_REGS *
+pe_regs_create_real(int pr_flags __attribute__ ((__unused__)),
+                    const char *name)
+{
+  return mush_calloc(1, sizeof(PE_REGS), name);
+}
+
+void
+pe_regs_free(PE_REGS *pe_regs)
+{
+  mush_free(pe_regs, "pe_regs");
+}
+
+void
+pe_regs_setenv(PE_REGS *pe_regs, int num, const char *val)
+{
+  if (num >= 0 && num < 10)
+    mush_strncpy(pe_regs->env[num], val, BUFFER_LEN);
+}
+
+void
+pe_regs_set(PE_REGS *pe_regs, int type __attribute__ ((__unused__)),
+            const char *key, const char *val)
+{
+  if (isdigit((unsigned char) *key))
+    pe_regs_setenv(pe_regs, *key - '0', val);
+}
+
+/* no evaluation: the text is copied as it is */
+int
+process_expression(char *buff, char **bp, char const **str,
+                   dbref executor __attribute__ ((__unused__)),
+                   dbref caller __attribute__ ((__unused__)),
+                   dbref enactor __attribute__ ((__unused__)),
+                   int eflags __attribute__ ((__unused__)),
+                   int tflags __attribute__ ((__unused__)),
+                   NEW_PE_INFO *pe_info __attribute__ ((__unused__)))
+{
+  safe_str(*str, buff, bp);
+  *str += strlen(*str);
+  return 0;
+}
+
+int
+queue_attribute_base(dbref executor, const char *atrname, dbref enactor,
+                     int noparent, PE_REGS *pe_regs,
+                     int flags __attribute__ ((__unused__)))
+{
+  ATTR *a;
+
+  a = noparent ? atr_get_noparent(executor, atrname)
+    : atr_get(executor, atrname);
+  if (!a)
+    return 0;
+  tdb_log_add(&queued_log, "#%d %s #%d %s\n", executor, atrname, enactor,
+              pe_regs ? pe_regs->env[0] : "");
+  return 1;
+}
+
+/* ---------------------------------------------------------------------
+ * hash tables
+ */
+
+struct hash_ent {
+  char *key;
+  void *data;
+  struct hash_ent *next;
+};
+
+static unsigned int
+tdb_hash(const char *key, int size)
+{
+  unsigned int h = 5381;
+
+  while (*key)
+    h = h * 33 + (unsigned char) *key++;
+  return h % (unsigned int) size;
+}
+
+void
+hash_init(HASHTAB *htab, int size, void (*free_data) (void *))
+{
+  htab->size = size < 16 ? 16 : size;
+  htab->entries = 0;
+  htab->buckets = calloc(htab->size, sizeof(struct hash_ent *));
+  htab->free_data = free_data;
+  htab->iter_bucket = 0;
+  htab->iter_ent = NULL;
+}
+
+void *
+hashfind(const char *key, HASHTAB *htab)
+{
+  struct hash_ent *e;
+
+  if (!htab->buckets)
+    return NULL;
+  for (e = htab->buckets[tdb_hash(key, htab->size)]; e; e = e->next)
+    if (!strcmp(e->key, key))
+      return e->data;
+  return NULL;
+}
+
+bool
+hashadd(const char *key, void *data, HASHTAB *htab)
+{
+  struct hash_ent *e;
+  unsigned int b;
+
+  if (hashfind(key, htab))
+    return false;
+  b = tdb_hash(key, htab->size);
+  e = malloc(sizeof *e);
+  e->key = strdup(key);
+  e->data = data;
+  e->next = htab->buckets[b];
+  htab->buckets[b] = e;
+  htab->entries++;
+  return true;
+}
+
+void
+hashdelete(const char *key, HASHTAB *htab)
+{
+  struct hash_ent **ep, *e;
+
+  if (!htab->buckets)
+    return;
+  for (ep = &htab->buckets[tdb_hash(key, htab->size)]; *ep;
+       ep = &(*ep)->next) {
+    if (!strcmp((*ep)->key, key)) {
+      e = *ep;
+      *ep = e->next;
+      if (htab->free_data)
+        htab->free_data(e->data);
+      free(e->key);
+      free(e);
+      htab->entries--;
+      return;
+    }
+  }
+}
+
+void
+hashfree(HASHTAB *htab)
+{
+  struct hash_ent *e, *next;
+  int i;
+
+  if (!htab->buckets)
+    return;
+  for (i = 0; i < htab->size; i++) {
+    for (e = htab->buckets[i]; e; e = next) {
+      next = e->next;
+      if (htab->free_data)
+        htab->free_data(e->data);
+      free(e->key);
+      free(e);
+    }
+  }
+  free(htab->buckets);
+  htab->buckets = NULL;
+  htab->entries = 0;
+}
+
+static struct hash_ent *
+hash_iter(HASHTAB *htab, struct hash_ent *e)
+{
+  if (e && e->next)
+    return htab->iter_ent = e->next;
+  if (!htab->buckets)
+    return NULL;
+  for (htab->iter_bucket += e ? 1 : 0; htab->iter_bucket < htab->size;
+       htab->iter_bucket++)
+    if (htab->buckets[htab->iter_bucket])
+      return htab->iter_ent = htab->buckets[htab->iter_bucket];
+  return htab->iter_ent = NULL;
+}
+
+void *
+hash_firstentry(HASHTAB *htab)
+{
+  struct hash_ent *e;
+
+  htab->iter_bucket = 0;
+  e = hash_iter(htab, NULL);
+  return e ? e->data : NULL;
+}
+
+void *
+hash_nextentry(HASHTAB *htab)
+{
+  struct hash_ent *e;
+
+  if (!htab->iter_ent)
+    return NULL;
+  e = hash_iter(htab, htab->iter_ent);
+  return e ? e->data : NULL;
+}
+
+const char *
+hash_firstentry_key(HASHTAB *htab)
+{
+  struct hash_ent *e;
+
+  htab->iter_bucket = 0;
+  e = hash_iter(htab, NULL);
+  return e ? e->key : NULL;
+}
+
+const char *
+hash_nextentry_key(HASHTAB *htab)
+{
+  struct hash_ent *e;
+
+  if (!htab->iter_ent)
+    return NULL;
+  e = hash_iter(htab, htab->iter_ent);
+  return e ? e->key : NULL;
+}
+
+/* ---------------------------------------------------------------------
+ * intmaps: open addressing, linear probing, backward shift deletion
+ */
+
+struct im_slot {
+  im_key key;
+  int used;
+  void *data;
+};
+
+struct intmap {
+  struct im_slot *slots;
+  uint32_t size;                /* a power of 2 */
+  int64_t count;
+};
+
+intmap *
+im_new(void)
+{
+  intmap *im = mush_malloc(sizeof(intmap), "intmap");
+
+  im->size = 16;
+  im->count = 0;
+  im->slots = calloc(im->size, sizeof(struct im_slot));
+  return im;
+}
+
+void
+im_destroy(intmap *im)
+{
+  if (!im)
+    return;
+  free(im->slots);
+  mush_free(im, "intmap");
+}
+
+int64_t
+im_count(intmap *im)
+{
+  return im->count;
+}
+
+static uint32_t
+im_hash(im_key key, uint32_t size)
+{
+  return (key * 2654435761u) & (size - 1);
+}
+
+static struct im_slot *
+im_slot(intmap *im, im_key key)
+{
+  uint32_t i = im_hash(key, im->size);
+
+  while (im->slots[i].used && im->slots[i].key != key)
+    i = (i + 1) & (im->size - 1);
+  return &im->slots[i];
+}
+
+bool
+im_insert(intmap *im, im_key key, void *data)
+{
+  struct im_slot *s;
+
+  if ((im->count + 1) * 2 > im->size) {
+    struct im_slot *old = im->slots;
+    uint32_t i, osize = im->size;
+
+    im->size *= 2;
+    im->slots = calloc(im->size, sizeof(struct im_slot));
+    for (i = 0; i < osize; i++)
+      if (old[i].used)
+        *im_slot(im, old[i].key) = old[i];
+    free(old);
+  }
+  s = im_slot(im, key);
+  if (s->used)
+    return false;
+  s->used = 1;
+  s->key = key;
+  s->data = data;
+  im->count++;
+  return true;
+}
+
+void *
+im_find(intmap *im, im_key key)
+{
+  struct im_slot *s = im_slot(im, key);
+
+  return s->used ? s->data : NULL;
+}
+
+bool
+im_exists(intmap *im, im_key key)
+{
+  return im_slot(im, key)->used;
+}
+
+bool
+im_delete(intmap *im, im_key key)
+{
+  uint32_t i, j, k, mask = im->size - 1;
+  struct im_slot *s = im_slot(im, key);
+
+  if (!s->used)
+    return false;
+  i = (uint32_t) (s - im->slots);
+  im->slots[i].used = 0;
+  im->count--;
+  for (j = (i + 1) & mask; im->slots[j].used; j = (j + 1) & mask) {
+    k = im_hash(im->slots[j].key, im->size);
+    /* move j back to i unless its home lies cyclically in (i, j] */
+    if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+      continue;
+    im->slots[i] = im->slots[j];
+    im->slots[j].used = 0;
+    i = j;
+  }
+  return true;
+}
+
+/* ---------------------------------------------------------------------
+ * the db
+ */
+
+static unsigned long rng_state = 1;
+
+void
+tdb_srand(unsigned long seed)
+{
+  rng_state = seed ? seed : 1;
+}
+
+unsigned long
+tdb_rand(void)
+{
+  /* xorshift64* */
+  uint64_t x = rng_state;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng_state = x;
+  return (unsigned long) ((x * 2685821657736338717ull) >> 33);
+}
+
+static dbref
+tdb_new(const char *name, int type)
+{
+  struct object *o;
+
+  if (db_top == db_size) {
+    db_size = db_size ? db_size * 2 : 64;
+    db = realloc(db, db_size * sizeof(struct object));
+  }
+  o = &db[db_top];
+  memset(o, 0, sizeof *o);
+  o->name = strdup(name);
+  o->location = o->contents = o->exits = o->next = NOTHING;
+  o->parent = o->zone = NOTHING;
+  o->owner = GOD;
+  o->type = type;
+  o->creation_time = mudtime;
+  o->lock_deny = o->see_deny = NOTHING;
+  return db_top++;
+}
+
+/* the list an object is on in a container */
+static dbref *
+tdb_list(dbref thing, dbref where)
+{
+  return IsExit(thing) ? &db[where].exits : &db[where].contents;
+}
+
+static void
+tdb_unlink(dbref thing, dbref where)
+{
+  dbref *p;
+
+  if (!GoodObject(where))
+    return;
+  for (p = tdb_list(thing, where); GoodObject(*p); p = &db[*p].next) {
+    if (*p == thing) {
+      *p = Next(thing);
+      break;
+    }
+  }
+  db[thing].next = NOTHING;
+}
+
+/* push thing on the front of where's list, as the server does */
+static void
+tdb_push(dbref thing, dbref where)
+{
+  dbref *p = tdb_list(thing, where);
+
+  db[thing].next = *p;
+  *p = thing;
+}
+
+dbref
+tdb_create(const char *name, int type, dbref loc)
+{
+  dbref thing = tdb_new(name, type);
+
+  if (type == TYPE_PLAYER)
+    db[thing].owner = thing;
+  if (type != TYPE_ROOM && GoodObject(loc)) {
+    db[thing].location = loc;
+    db[thing].exits = loc;      /* home */
+    tdb_push(thing, loc);
+    match_index_moved(thing, NOTHING, loc);
+    npc_graph_moved(thing, NOTHING, loc);
+  }
+  return thing;
+}
+
+dbref
+tdb_open(const char *name, dbref source, dbref dest)
+{
+  dbref exit = tdb_new(name, TYPE_EXIT);
+
+  db[exit].exits = source;
+  db[exit].location = dest;
+  tdb_push(exit, source);
+  match_index_moved(exit, NOTHING, source);
+  npc_graph_moved(exit, NOTHING, source);
+  return exit;
+}
+
+void
+tdb_link(dbref exit, dbref dest)
+{
+  db[exit].location = dest;
+  npc_graph_changed(exit);
+}
+
+void
+tdb_move(dbref thing, dbref to)
+{
+  dbref from = IsExit(thing) ? Source(thing) : Location(thing);
+
+  tdb_unlink(thing, from);
+  if (IsExit(thing))
+    db[thing].exits = to;
+  else
+    db[thing].location = to;
+  if (GoodObject(to))
+    tdb_push(thing, to);
+  match_index_moved(thing, from, to);
+  npc_graph_moved(thing, from, to);
+}
+
+void
+tdb_rename(dbref thing, const char *name)
+{
+  free((char *) db[thing].name);
+  db[thing].name = strdup(name);
+  match_index_renamed(thing);
+}
+
+void
+tdb_set_flag(dbref thing, int bit, int on)
+{
+  if (on)
+    db[thing].flags[bit >> 3] |= 1 << (bit & 7);
+  else
+    db[thing].flags[bit >> 3] &= ~(1 << (bit & 7));
+  match_cache_clear();
+}
+
+void
+tdb_lock(dbref thing, int lock, dbref who)
+{
+  if (lock == TDB_INTERACT_LOCK)
+    db[thing].see_deny = who;
+  else
+    db[thing].lock_deny = who;
+  match_cache_clear();
+}
+
+void
+tdb_chown(dbref thing, dbref owner)
+{
+  db[thing].owner = owner;
+  match_cache_clear();
+}
+
+void
+tdb_parent(dbref thing, dbref parent)
+{
+  db[thing].parent = parent;
+  match_cache_clear();
+}
+
+/* the server's local_data_free() */
+static void
+tdb_destroyed_hooks(dbref thing)
+{
+  match_index_destroyed(thing);
+  generic_destroyed(thing);
+  npc_destroyed(thing);
+}
+
+void
+tdb_destroy(dbref thing)
+{
+  ATTR *a, *next;
+  dbref loc;
+
+  if (!RealGoodObject(thing) || thing < 3)
+    return;
+  if (IsRoom(thing)) {
+    while (GoodObject(Exits(thing)))
+      tdb_destroy(Exits(thing));
+    while (GoodObject(Contents(thing)))
+      tdb_move(Contents(thing), 0);
+  } else if (!IsExit(thing)) {
+    while (GoodObject(Contents(thing)))
+      tdb_move(Contents(thing), 0);
+  }
+
+  tdb_destroyed_hooks(thing);
+
+  loc = IsExit(thing) ? Source(thing) : Location(thing);
+  if (!IsRoom(thing))
+    tdb_unlink(thing, loc);
+  for (a = db[thing].list; a; a = next) {
+    next = a->next;
+    tdb_attr_free(a);
+  }
+  db[thing].list = NULL;
+  free((char *) db[thing].name);
+  db[thing].name = strdup("Garbage");
+  db[thing].type = TYPE_GARBAGE;
+  db[thing].location = db[thing].exits = db[thing].contents = NOTHING;
+  db[thing].parent = db[thing].zone = NOTHING;
+  memset(db[thing].flags, 0, sizeof db[thing].flags);
+}
+
+void
+tdb_end_command(void)
+{
+  match_cycle_end();
+  scratch_reset();
+}
+
+void
+tdb_timer(void)
+{
+  npc_graph_timer();
+}
+
+void
+tdb_init(void)
+{
+  static int started = 0;
+
+  if (db)
+    tdb_free();
+  tdb_new("Room Zero", TYPE_ROOM);
+  tdb_new("One", TYPE_PLAYER);
+  tdb_new("Master Room", TYPE_ROOM);
+  db[GOD].owner = GOD;
+  db[GOD].location = 0;
+  db[GOD].exits = 0;
+  tdb_push(GOD, 0);
+  match_index_moved(GOD, NOTHING, 0);
+
+  if (!started) {
+    started = 1;
+    generic_init();
+    match_stats_init();
+    npc_init();
+  }
+  tdb_told_clear();
+  tdb_queued_clear();
+}
+
+void
+tdb_free(void)
+{
+  dbref i;
+
+  for (i = db_top - 1; i >= 3; i--)
+    tdb_destroy(i);
+  for (i = 0; i < db_top; i++) {
+    ATTR *a, *next;
+
+    tdb_destroyed_hooks(i);
+    for (a = db[i].list; a; a = next) {
+      next = a->next;
+      tdb_attr_free(a);
+    }
+    free((char *) db[i].name);
+  }
+  free(db);
+  db = NULL;
+  db_top = db_size = 0;
+  tdb_end_command();
+}
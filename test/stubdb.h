@@ -0,0 +1,76 @@
+/* stubdb.h
+ * an in-memory stand-in for the parts of the PennMUSH server the generic
+ * and npc modules use, so they can be built and tested on their own.
+ *
+ * The tdb_* mutators change the db the way the server's commands do and
+ * call the modules' hooks from the same places the server patch in HOOKS
+ * does, so a test that goes through them sees what a running game would.
+ */
+
+#ifndef __STUBDB_H
+#define __STUBDB_H
+
+#include <stddef.h>
+
+#include "conf.h"
+#include "dbdefs.h"
+
+/* for lock_deny and see_deny: applies to everyone */
+#define TDB_EVERYONE (-100)
+
+/* which lock tdb_lock() sets: the basic lock, or the interact lock */
+#define TDB_BASIC_LOCK 0
+#define TDB_INTERACT_LOCK 1
+
+/* set up an empty db: #0 room, #1 God (in #0), #2 the master room */
+extern void tdb_init(void);
+/* throw the db away, telling the modules each object is gone */
+extern void tdb_free(void);
+
+extern dbref tdb_create(const char *name, int type, dbref loc);
+extern dbref tdb_open(const char *name, dbref source, dbref dest);
+extern void tdb_move(dbref thing, dbref to);
+/* relink an exit, as @link would */
+extern void tdb_link(dbref exit, dbref dest);
+extern void tdb_rename(dbref thing, const char *name);
+extern void tdb_destroy(dbref thing);
+extern void tdb_set_flag(dbref thing, int bit, int on);
+/* lock thing against who, or NOTHING to unlock it, as @lock would */
+extern void tdb_lock(dbref thing, int lock, dbref who);
+extern void tdb_chown(dbref thing, dbref owner);
+extern void tdb_parent(dbref thing, dbref parent);
+/* disable or enable a flag, as @flag would */
+extern void tdb_flag_disable(const char *name, int disabled);
+extern void tdb_set_attr(dbref thing, const char *name, const char *value);
+extern void tdb_set_attr_flags(dbref thing, const char *name,
+                               const char *value, int flags);
+extern void tdb_clr_attr(dbref thing, const char *name);
+/* what the server does at the end of each command */
+extern void tdb_end_command(void);
+/* what the server does once a second, from local_timer() */
+extern void tdb_timer(void);
+
+/* everything notify()'d, as "#<dbref> <message>\n" lines */
+extern const char *tdb_told(void);
+extern void tdb_told_clear(void);
+
+/* attributes queue_attribute_base() was asked to run, as
+ * "#<executor> <attr> #<enactor>\n" lines */
+extern const char *tdb_queued(void);
+extern void tdb_queued_clear(void);
+
+/* call a softcode function registered with function_add() */
+extern const char *tdb_call(const char *name, dbref executor, int nargs,
+                            const char **args);
+
+/* can_interact() calls so far */
+extern unsigned long tdb_interact_calls;
+/* blocks from mush_malloc() and friends not yet freed */
+extern long tdb_live_blocks(void);
+
+/* a small, seedable rng, so runs are repeatable */
+extern void tdb_srand(unsigned long seed);
+extern unsigned long tdb_rand(void);
+#define tdb_randn(n) ((int) (tdb_rand() % (unsigned long) (n)))
+
+#endif                          /* __STUBDB_H */
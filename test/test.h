@@ -0,0 +1,45 @@
+/* test.h
+ * checks for the test programs. a failed check is reported and counted,
+ * and the test carries on; main() returns TEST_EXIT. */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+extern int test_failures;
+
+/* only the first few failures are worth reading */
+#define TEST_REPORT_MAX 20
+
+#define TEST_FAIL(...) \
+  do { \
+    if (++test_failures <= TEST_REPORT_MAX) { \
+      fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+    } \
+  } while (0)
+
+#define CHECK(cond) \
+  do { if (!(cond)) TEST_FAIL("failed: %s", #cond); } while (0)
+
+#define CHECK_INT(got, want) \
+  do { \
+    long long got_ = (long long) (got), want_ = (long long) (want); \
+    if (got_ != want_) \
+      TEST_FAIL("%s is %lld, wanted %lld", #got, got_, want_); \
+  } while (0)
+
+#define CHECK_STR(got, want) \
+  do { \
+    const char *got_ = (got), *want_ = (want); \
+    if (strcmp(got_, want_)) \
+      TEST_FAIL("%s is \"%s\", wanted \"%s\"", #got, got_, want_); \
+  } while (0)
+
+#define TEST_EXIT \
+  (test_failures ? (fprintf(stderr, "%d failed\n", test_failures), 1) : 0)
+
+#endif                          /* __TEST_H */
@@ -0,0 +1,288 @@
+/* test_dialog.c
+ * npc dialog through npcreply() and npctext(): wildcard and regexp
+ * replies, the node a player moves on to, the text they're shown and
+ * the action queued, replies whose patterns can't all be compiled into
+ * one, and the compiled nodes going when they're wiped or the npc is. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attrib.h"
+#include "mushdb.h"
+#include "npc.h"
+#include "stubdb.h"
+#include "test.h"
+
+static dbref room, npc, player;
+static char npc_ref[16], player_ref[16];
+
+static void
+setup(void)
+{
+  tdb_init();
+  room = tdb_create("Inn", TYPE_ROOM, NOTHING);
+  npc = tdb_create("Barkeep", TYPE_THING, room);
+  player = tdb_create("wanda", TYPE_PLAYER, room);
+  tdb_set_flag(npc, F_BIT_NPC, 1);
+  snprintf(npc_ref, sizeof npc_ref, "#%d", npc);
+  snprintf(player_ref, sizeof player_ref, "#%d", player);
+}
+
+/* player says reply to the npc, the npc asks how that went */
+static const char *
+reply(const char *what)
+{
+  tdb_told_clear();
+  tdb_queued_clear();
+  return tdb_call("NPCREPLY", npc, 3,
+                  (const char *[]) {npc_ref, player_ref, what});
+}
+
+/* the node player is on */
+static const char *
+node(void)
+{
+  const char *nd = npc_get_player_node(npc, player);
+
+  return nd ? nd : "";
+}
+
+static void
+check_basics(void)
+{
+  char want[BUFFER_LEN];
+
+  setup();
+  tdb_set_attr(npc, "DIALOG`0`REPLY`DRINK", "* ale*");
+  tdb_set_attr(npc, "DIALOG`0`REPLY`ROOM", "room?");
+  tdb_set_attr(npc, "DIALOG`DRINK`TEXT", "Here you go, %N.");
+  tdb_set_attr(npc, "DIALOG`DRINK`ACTION", "@pemit %#=clink");
+  tdb_set_attr_flags(npc, "DIALOG`DRINK`REPLY`0", "^th(anks|x)", AF_REGEXP);
+
+  CHECK_STR(reply("something else"), "0");
+  CHECK_STR(node(), "0");
+  CHECK_STR(tdb_told(), "");
+
+  /* wildcards match case-blind, and their captures go to %0 on */
+  CHECK_STR(reply("A pint of ALE please"), "1");
+  CHECK_STR(node(), "DRINK");
+  snprintf(want, sizeof want, "#%d Here you go, Wanda.\n", player);
+  CHECK_STR(tdb_told(), want);
+  snprintf(want, sizeof want, "#%d DIALOG`DRINK`ACTION #%d A pint of\n",
+           npc, player);
+  CHECK_STR(tdb_queued(), want);
+
+  /* regexps match anywhere, case sensitive only if set CASE */
+  CHECK_STR(reply("THANKS"), "1");
+  CHECK_STR(node(), "0");
+  CHECK_STR(reply("rooms"), "1");
+  CHECK_STR(node(), "ROOM");
+
+  /* a changed reply is compiled again */
+  tdb_set_attr(npc, "DIALOG`ROOM`REPLY`0", "yes");
+  CHECK_STR(reply("yes"), "1");
+  CHECK_STR(node(), "0");
+  tdb_set_attr(npc, "DIALOG`0`REPLY`DRINK", "beer");
+  CHECK_STR(reply("A pint of ale"), "0");
+  CHECK_STR(reply("beer"), "1");
+  CHECK_STR(node(), "DRINK");
+  tdb_set_attr_flags(npc, "DIALOG`DRINK`REPLY`0", "^TH(ANKS|X)",
+                     AF_REGEXP | AF_CASE);
+  CHECK_STR(reply("thanks"), "0");
+  CHECK_STR(reply("THX"), "1");
+}
+
+/* replies that can't share one pattern still match, in order */
+static void
+check_apart(void)
+{
+  setup();
+  /* the same group number with two names, which a branch reset group
+     won't have */
+  tdb_set_attr_flags(npc, "DIALOG`0`REPLY`A", "(?<x>a)(?<y>b)", AF_REGEXP);
+  tdb_set_attr_flags(npc, "DIALOG`0`REPLY`B", "(?<y>c)d", AF_REGEXP);
+  tdb_set_attr(npc, "DIALOG`A`REPLY`0", "*");
+  tdb_set_attr(npc, "DIALOG`B`REPLY`0", "*");
+  CHECK_STR(reply("xcd"), "1");
+  CHECK_STR(node(), "B");
+  CHECK_STR(reply("back"), "1");
+  CHECK_STR(reply("ab"), "1");
+  CHECK_STR(node(), "A");
+  CHECK_STR(reply("back"), "1");
+  CHECK_STR(reply("nothing"), "0");
+
+  /* a mark of the reply's own can't pass for another reply's number */
+  tdb_clr_attr(npc, "DIALOG`0`REPLY`A");
+  tdb_clr_attr(npc, "DIALOG`0`REPLY`B");
+  tdb_set_attr_flags(npc, "DIALOG`0`REPLY`A", "(*MARK:1)zzz", AF_REGEXP);
+  tdb_set_attr(npc, "DIALOG`0`REPLY`B", "other");
+  CHECK_STR(reply("zzz"), "1");
+  CHECK_STR(node(), "A");
+  CHECK_STR(reply("back"), "1");
+  tdb_set_attr_flags(npc, "DIALOG`0`REPLY`A", "(*:1)yyy", AF_REGEXP);
+  CHECK_STR(reply("yyy"), "1");
+  CHECK_STR(node(), "A");
+  CHECK_STR(reply("back"), "1");
+  CHECK_STR(reply("other"), "1");
+  CHECK_STR(node(), "B");
+
+  /* one that doesn't compile is left out, the rest still work */
+  tdb_clr_attr(npc, "DIALOG`B`REPLY`0");
+  tdb_set_attr_flags(npc, "DIALOG`B`REPLY`A", "(unclosed", AF_REGEXP);
+  tdb_set_attr(npc, "DIALOG`B`REPLY`C", "*");
+  CHECK_STR(reply("(unclosed"), "1");
+  CHECK_STR(node(), "C");
+}
+
+/* what a player is shown at a node */
+static const char *
+text(const char *at)
+{
+  return tdb_call("NPCTEXT", npc, 3,
+                  (const char *[]) {npc_ref, player_ref, at});
+}
+
+static void
+check_text(void)
+{
+  char want[BUFFER_LEN];
+
+  setup();
+  tdb_set_attr(npc, "DIALOG`0`TEXT", "Welcome in.");
+  tdb_set_attr(npc, "DIALOG`NAME`TEXT", "%N is %#, or is it %n?");
+  tdb_set_attr(npc, "DIALOG`SUM`TEXT", "That's [add(1,2)].");
+  tdb_set_attr(npc, "DIALOG`SPACE`TEXT", "two  spaces");
+  tdb_set_attr(npc, "DIALOG`0`REPLY`NAME", "name");
+
+  /* static text is shown as it is */
+  CHECK_STR(text(""), "Welcome in.");
+  CHECK_STR(text("0"), "Welcome in.");
+  CHECK_STR(text("NOWHERE"), "");
+
+  /* a template fills in the player */
+  snprintf(want, sizeof want, "Wanda is #%d, or is it wanda?", player);
+  CHECK_STR(text("NAME"), want);
+  CHECK_STR(reply("name"), "1");
+  CHECK_STR(text(""), want);
+
+  /* anything else goes to the evaluator, which in the tests leaves it
+     as it is */
+  CHECK_STR(text("SUM"), "That's [add(1,2)].");
+  CHECK_STR(text("SPACE"), "two  spaces");
+
+  /* and a change is seen */
+  tdb_set_attr(npc, "DIALOG`NAME`TEXT", "Hello again.");
+  CHECK_STR(text(""), "Hello again.");
+  tdb_clr_attr(npc, "DIALOG`NAME`TEXT");
+  CHECK_STR(text(""), "");
+  tdb_set_attr(npc, "DIALOG`NAME`TEXT", "Hi %n.");
+  CHECK_STR(text(""), "Hi wanda.");
+}
+
+/* compiled nodes don't outlive their attributes, or their npc */
+static dbref cook;
+
+static const char *
+cook_text(const char *at)
+{
+  char ref[16];
+
+  snprintf(ref, sizeof ref, "#%d", cook);
+  return tdb_call("NPCTEXT", cook, 3,
+                  (const char *[]) {ref, player_ref, at});
+}
+
+static void
+check_prune(void)
+{
+  char name[BUFFER_LEN], at[16];
+  long before, one;
+  int i;
+
+  setup();
+  cook = tdb_create("Cook", TYPE_THING, room);
+  tdb_set_flag(cook, F_BIT_NPC, 1);
+  tdb_set_attr(cook, "DIALOG`0`TEXT", "Hello %n.");
+  tdb_set_attr(cook, "DIALOG`0`REPLY`1", "*");
+  /* the owner's dialog budget usage outlives the cook, so a first one
+     makes it */
+  CHECK_STR(cook_text("0"), "Hello wanda.");
+  tdb_destroy(cook);
+  before = tdb_live_blocks();
+
+  /* a dbref that hasn't had dialog on it before */
+  cook = tdb_create("Cook", TYPE_THING, room);
+  tdb_set_flag(cook, F_BIT_NPC, 1);
+  tdb_set_attr(cook, "DIALOG`0`TEXT", "Hello %n.");
+  tdb_set_attr(cook, "DIALOG`0`REPLY`1", "*");
+  CHECK_STR(cook_text("0"), "Hello wanda.");
+  one = tdb_live_blocks();
+  CHECK(one > before);
+
+  for (i = 1; i <= 50; i++) {
+    snprintf(name, sizeof name, "DIALOG`%d`TEXT", i);
+    tdb_set_attr(cook, name, "Room %n.");
+    snprintf(name, sizeof name, "DIALOG`%d`REPLY`%d", i, i + 1);
+    tdb_set_attr(cook, name, "go");
+  }
+  for (i = 1; i <= 50; i++) {
+    snprintf(at, sizeof at, "%d", i);
+    CHECK_STR(cook_text(at), "Room wanda.");
+  }
+  CHECK(tdb_live_blocks() > one);
+
+  /* as @wipe would */
+  for (i = 1; i <= 50; i++) {
+    snprintf(name, sizeof name, "DIALOG`%d`TEXT", i);
+    tdb_clr_attr(cook, name);
+    snprintf(name, sizeof name, "DIALOG`%d`REPLY`%d", i, i + 1);
+    tdb_clr_attr(cook, name);
+  }
+  CHECK_STR(cook_text("0"), "Hello wanda.");
+  CHECK_INT(tdb_live_blocks(), one);
+
+  /* but for the generation the match index keeps for the dbref */
+  tdb_destroy(cook);
+  CHECK_INT(tdb_live_blocks(), before + 1);
+}
+
+/* who may ask */
+static void
+check_errors(void)
+{
+  dbref rock, mortal;
+  char rock_ref[16];
+
+  setup();
+  rock = tdb_create("Rock", TYPE_THING, room);
+  mortal = tdb_create("Mortal", TYPE_PLAYER, room);
+  snprintf(rock_ref, sizeof rock_ref, "#%d", rock);
+  CHECK_STR(tdb_call("NPCREPLY", GOD, 3,
+                     (const char *[]) {rock_ref, player_ref, "hi"}),
+            "#-1 NOT AN NPC");
+  CHECK_STR(tdb_call("NPCREPLY", mortal, 3,
+                     (const char *[]) {npc_ref, player_ref, "hi"}),
+            "#-1 PERMISSION DENIED");
+  CHECK_STR(tdb_call("NPCREPLY", npc, 3,
+                     (const char *[]) {npc_ref, "nobody", "hi"}),
+            "#-1 NO SUCH OBJECT VISIBLE");
+  CHECK_STR(tdb_call("NPCTEXT", GOD, 2,
+                     (const char *[]) {rock_ref, player_ref}),
+            "#-1 NOT AN NPC");
+  CHECK_STR(tdb_call("NPCTEXT", mortal, 2,
+                     (const char *[]) {npc_ref, player_ref}),
+            "#-1 PERMISSION DENIED");
+}
+
+int
+main(void)
+{
+  check_basics();
+  check_apart();
+  check_text();
+  check_prune();
+  check_errors();
+  tdb_free();
+  return TEST_EXIT;
+}
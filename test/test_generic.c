@@ -0,0 +1,341 @@
+/* test_generic.c
+ * GENERIC stacks against the attributes they're kept in: whatever the
+ * tables say has to be what reading the attributes afresh would, as the
+ * stacks, their parents and the attributes change underneath. */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attrib.h"
+#include "generic.h"
+#include "mushdb.h"
+#include "parse.h"
+#include "strutil.h"
+#include "test.h"
+#include "world.h"
+
+static struct world w;
+
+/* the count generic_count() should give, straight from the attributes */
+static int
+ref_count(dbref container, dbref proto)
+{
+  char name[64];
+  ATTR *a;
+  dbref p;
+  int level;
+
+  snprintf(name, sizeof name, "GENERIC`#%d", proto);
+  for (p = container, level = 0; GoodObject(p) && level <= MAX_PARENTS;
+       p = Parent(p), level++) {
+    a = atr_get_noparent(p, name);
+    if (a && (!level || !(AL_FLAGS(a) & AF_PRIVATE))) {
+      level = parse_integer(atr_value(a));
+      return level > 0 ? level : 0;
+    }
+  }
+  return 0;
+}
+
+/* the count of a container's own stack */
+static int
+own_count(dbref container, dbref proto)
+{
+  char name[64];
+  ATTR *a;
+  int count;
+
+  snprintf(name, sizeof name, "GENERIC`#%d", proto);
+  a = atr_get_noparent(container, name);
+  count = a ? parse_integer(atr_value(a)) : 0;
+  return count > 0 ? count : 0;
+}
+
+struct stack_list {
+  char text[BUFFER_LEN];
+  char *bp;
+};
+
+static int
+ref_iter_helper(dbref player __attribute__ ((__unused__)),
+                dbref thing __attribute__ ((__unused__)),
+                dbref parent __attribute__ ((__unused__)),
+                const char *pattern __attribute__ ((__unused__)),
+                ATTR *atr, void *args)
+{
+  struct stack_list *sl = args;
+  const char *name = strchr(AL_NAME(atr), '`') + 1;
+  dbref proto = parse_dbref(name);
+
+  /* names other than GENERIC`#<dbref> aren't stacks */
+  if (GoodObject(proto) && !strcmp(name, unparse_dbref(proto)))
+    safe_format(sl->text, &sl->bp, "#%d:%d ", proto,
+                parse_integer(atr_value(atr)));
+  return 0;
+}
+
+static int
+iter_helper(dbref container __attribute__ ((__unused__)), dbref proto,
+            int count, void *data)
+{
+  struct stack_list *sl = data;
+
+  safe_format(sl->text, &sl->bp, "#%d:%d ", proto, count);
+  return 0;
+}
+
+static void
+check_container(dbref c)
+{
+  struct stack_list got, want;
+  int i, inherit;
+
+  for (i = 0; i < w.nprotos; i++)
+    if (generic_count(c, w.protos[i]) != ref_count(c, w.protos[i]))
+      TEST_FAIL("#%d has %d of #%d, wanted %d", c,
+                generic_count(c, w.protos[i]), w.protos[i],
+                ref_count(c, w.protos[i]));
+
+  for (inherit = 0; inherit < 2; inherit++) {
+    got.bp = got.text;
+    want.bp = want.text;
+    generic_iter(c, inherit, iter_helper, &got);
+    if (inherit)
+      atr_iter_get_parent(GOD, c, GENERIC_ATTR "*", 0, 0, ref_iter_helper,
+                          &want);
+    else
+      atr_iter_get(GOD, c, GENERIC_ATTR "*", 0, 0, ref_iter_helper, &want);
+    *got.bp = *want.bp = '\0';
+    if (strcmp(got.text, want.text))
+      TEST_FAIL("#%d has stacks %s\"%s\", wanted \"%s\"", c,
+                inherit ? "(inherited) " : "", got.text, want.text);
+  }
+}
+
+static dbref
+holder(void)
+{
+  return tdb_randn(2) ? world_pick(w.rooms, w.nrooms)
+    : world_pick(w.things, w.nthings);
+}
+
+static void
+mutate(void)
+{
+  char attr[64], value[32];
+  dbref c = holder(), proto = world_pick(w.protos, w.nprotos);
+  int before, delta, got;
+
+  snprintf(attr, sizeof attr, "GENERIC`#%d", proto);
+  switch (tdb_randn(8)) {
+  case 0:
+    snprintf(value, sizeof value, "%d", tdb_randn(30) - 2);
+    tdb_set_attr(c, attr, tdb_randn(5) ? value : "");
+    break;
+  case 1:
+    /* no_inherit on or off */
+    if (atr_get_noparent(c, attr))
+      tdb_set_attr_flags(c, attr, atr_value(atr_get_noparent(c, attr)),
+                         tdb_randn(2) ? AF_PRIVATE : 0);
+    break;
+  case 2:
+    db[c].parent = tdb_randn(3) ? holder() : NOTHING;
+    /* no loops */
+    for (dbref p = Parent(c); GoodObject(p); p = Parent(p))
+      if (p == c) {
+        db[c].parent = NOTHING;
+        break;
+      }
+    break;
+  case 3:
+  case 4:
+    if (IsGarbage(c))
+      break;
+    before = own_count(c, proto);
+    delta = tdb_randn(11) - 5;
+    got = generic_adjust(c, proto, delta);
+    if (before + delta < 0)
+      CHECK_INT(got, GENERIC_ERR_SHORT);
+    else
+      CHECK_INT(got, before + delta);
+    CHECK_INT(own_count(c, proto), before + delta < 0 ? before : got);
+    break;
+  case 5:
+    if (IsGarbage(c))
+      break;
+    delta = tdb_randn(10) - 1;
+    CHECK_INT(generic_set(c, proto, delta), delta > 0 ? delta : 0);
+    CHECK_INT(own_count(c, proto), delta > 0 ? delta : 0);
+    break;
+  case 6:
+    /* through softcode */
+    {
+      const char *args[3];
+      char a0[16], a1[16], a2[16];
+
+      snprintf(a0, sizeof a0, "#%d", c);
+      snprintf(a1, sizeof a1, "#%d", proto);
+      snprintf(a2, sizeof a2, "%d", tdb_randn(7) - 3);
+      args[0] = a0;
+      args[1] = a1;
+      args[2] = a2;
+      tdb_call("ADDGENERIC", GOD, 3, args);
+    }
+    break;
+  default:
+    if (!IsPlayer(c) && !IsRoom(c) && !tdb_randn(4))
+      tdb_destroy(c);
+    break;
+  }
+  if (tdb_randn(2))
+    tdb_end_command();
+}
+
+static void
+run_world(unsigned long seed, int steps)
+{
+  int i, j;
+
+  tdb_init();
+  tdb_srand(seed);
+  world_city(&w, 10, 2);
+  world_populate(&w, 40, 4);
+  world_generic(&w, 12, 60);
+
+  for (i = 0; i < steps; i++) {
+    for (j = 0; j < 3; j++)
+      check_container(holder());
+    mutate();
+  }
+  for (i = 0; i < w.nrooms; i++)
+    check_container(w.rooms[i]);
+  for (i = 0; i < w.nthings; i++)
+    check_container(w.things[i]);
+  world_free(&w);
+}
+
+/* the softcode view of a container */
+static void
+check_functions(void)
+{
+  const char *args[2];
+  char a0[16], a1[16];
+  dbref box, apple, pear;
+
+  tdb_init();
+  box = tdb_create("box", TYPE_THING, 0);
+  apple = tdb_create("apple", TYPE_THING, 0);
+  pear = tdb_create("pear", TYPE_THING, 0);
+  tdb_set_flag(apple, F_BIT_GENERIC, 1);
+  snprintf(a0, sizeof a0, "#%d", box);
+  snprintf(a1, sizeof a1, "#%d", apple);
+  args[0] = a0;
+  args[1] = a1;
+
+  CHECK_STR(tdb_call("GENERIC", GOD, 1, args), "");
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "5"}), "5");
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "-7"}), "#-1 NOT ENOUGH");
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "-2"}), "3");
+  CHECK_INT(own_count(box, apple), 3);
+  CHECK_STR(tdb_call("GENERIC", GOD, 2, args), "3");
+  snprintf(a1, sizeof a1, "#%d", pear);
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "1"}),
+            "#-1 NOT A GENERIC OBJECT");
+  /* both names are looked up, and both complained about */
+  tdb_told_clear();
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {"nobox", "nosuch", "1"}),
+            "#-1 NO SUCH OBJECT VISIBLE");
+  CHECK_STR(tdb_told(), "#1 I can't see that here.\n"
+            "#1 I can't see that here.\n");
+  snprintf(a1, sizeof a1, "#%d:3", apple);
+  CHECK_STR(tdb_call("GENERIC", GOD, 1, args), a1);
+
+  /* the flag handle follows @flag */
+  snprintf(a1, sizeof a1, "#%d", apple);
+  tdb_flag_disable("GENERIC", 1);
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "1"}),
+            "#-1 NOT A GENERIC OBJECT");
+  tdb_flag_disable("GENERIC", 0);
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "1"}), "4");
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "-1"}), "3");
+
+  /* a stack as big as a count gets, set straight on the attribute */
+  snprintf(a1, sizeof a1, "%s#%d", GENERIC_ATTR, apple);
+  tdb_set_attr(box, a1, "2147483646");
+  CHECK_INT(generic_adjust(box, apple, 2), GENERIC_ERR_FULL);
+  CHECK_INT(generic_adjust(box, apple, INT_MAX), GENERIC_ERR_FULL);
+  snprintf(a1, sizeof a1, "#%d", apple);
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "2"}), "#-1 TOO MANY");
+  CHECK_INT(own_count(box, apple), INT_MAX - 1);
+  CHECK_STR(tdb_call("ADDGENERIC", GOD, 3,
+                     (const char *[]) {a0, a1, "1"}), "2147483647");
+  CHECK_INT(generic_count(box, apple), INT_MAX);
+}
+
+/* a stack whose attribute can't be cleared stays, and only the name
+ * generic_set() writes is a stack */
+static void
+check_attrs(void)
+{
+  struct stack_list got;
+  char name[64], want[64];
+  dbref box, apple, pear;
+
+  tdb_init();
+  box = tdb_create("box", TYPE_THING, 0);
+  apple = tdb_create("apple", TYPE_THING, 0);
+  pear = tdb_create("pear", TYPE_THING, 0);
+  tdb_set_flag(apple, F_BIT_GENERIC, 1);
+  tdb_set_flag(pear, F_BIT_GENERIC, 1);
+
+  snprintf(name, sizeof name, "%s#%d", GENERIC_ATTR, apple);
+  tdb_set_attr_flags(box, name, "3", AF_SAFE);
+  CHECK_INT(generic_count(box, apple), 3);
+  CHECK_INT(generic_set(box, apple, 0), GENERIC_ERR_SET);
+  CHECK_INT(generic_count(box, apple), 3);
+  CHECK_INT(generic_adjust(box, apple, -3), GENERIC_ERR_SET);
+  CHECK_INT(generic_count(box, apple), 3);
+  CHECK_INT(generic_adjust(box, apple, 2), 5);
+  CHECK_INT(own_count(box, apple), 5);
+  tdb_set_attr_flags(box, name, "5", 0);
+  CHECK_INT(generic_set(box, apple, 0), 0);
+  CHECK_INT(generic_count(box, apple), 0);
+  CHECK(atr_get_noparent(box, name) == NULL);
+  /* and clearing a stack that was never there is fine */
+  CHECK_INT(generic_set(box, apple, 0), 0);
+
+  /* #0<pear> names pear as a dbref, but isn't its stack's name */
+  snprintf(name, sizeof name, "%s#0%d", GENERIC_ATTR, pear);
+  tdb_set_attr(box, name, "4");
+  CHECK_INT(generic_count(box, pear), 0);
+  CHECK_INT(generic_set(box, pear, 2), 2);
+  got.bp = got.text;
+  generic_iter(box, 1, iter_helper, &got);
+  *got.bp = '\0';
+  snprintf(want, sizeof want, "#%d:2 ", pear);
+  CHECK_STR(got.text, want);
+}
+
+int
+main(void)
+{
+  unsigned long seed;
+
+  check_functions();
+  check_attrs();
+  for (seed = 1; seed <= 40; seed++)
+    run_world(seed, 400);
+  tdb_free();
+  return TEST_EXIT;
+}
@@ -0,0 +1,452 @@
+/* test_match.c
+ * the matcher against the one it replaced, on random worlds that change
+ * as the test goes: every lookup has to give the same object and the
+ * same complaint as before, single or batched. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attrib.h"
+#include "baseline.h"
+#include "generic.h"
+#include "match.h"
+#include "match_index.h"
+#include "match_stats.h"
+#include "mushdb.h"
+#include "test.h"
+#include "world.h"
+
+#define BATCH_MAX 6
+
+static struct world w;
+static int quiet_renames;       /* rename without calling the hook */
+
+/* flags the game commonly matches with, before extras are added */
+static const long base_flags[] = {
+  MAT_EVERYTHING,
+  MAT_NEARBY,
+  MAT_EVERYTHING | MAT_GLOBAL | MAT_REMOTES,
+  MAT_REMOTE,
+  MAT_POSSESSION | MAT_PLAYER | MAT_ABSOLUTE | MAT_CONTENTS | MAT_ENGLISH,
+  MAT_NEIGHBOR | MAT_EXIT | MAT_ENGLISH,
+  MAT_ME | MAT_HERE | MAT_ABSOLUTE | MAT_CONTAINER | MAT_CARRIED_EXIT,
+};
+
+static const long extra_flags[] = {
+  MAT_TYPE, MAT_EXACT, MAT_LAST, MAT_CONTROL, MAT_CHECK_KEYS, MAT_PMATCH,
+  MAT_CONTAINER, MAT_CARRIED_EXIT, MAT_NEAR, MAT_CONTENTS
+};
+
+static const int types[] = {
+  NOTYPE, NOTYPE, TYPE_THING, TYPE_EXIT, TYPE_PLAYER,
+  TYPE_THING | TYPE_PLAYER
+};
+
+#define NELEM(a) ((int) (sizeof(a) / sizeof((a)[0])))
+
+/* an object anywhere in the world */
+static dbref
+any_object(void)
+{
+  switch (tdb_randn(5)) {
+  case 0:
+    return world_pick(w.rooms, w.nrooms);
+  case 1:
+    return world_pick(w.exits, w.nexits);
+  case 2:
+    return world_pick(w.protos, w.nprotos);
+  default:
+    return world_pick(w.things, w.nthings);
+  }
+}
+
+/* the name of an object, or one of its aliases */
+static const char *
+name_of(dbref thing)
+{
+  static char buff[BUFFER_LEN];
+  ATTR *a;
+  char *p;
+
+  if (!GoodObject(thing))
+    return "nothing";
+  if (IsExit(thing) || ((a = atr_get_noparent(thing, "ALIAS")) &&
+                        tdb_randn(2)))
+    strcpy(buff, IsExit(thing) ? Name(thing) : atr_value(a));
+  else
+    return Name(thing);
+  /* one of the ; separated names, picked at random */
+  p = strtok(buff, ";");
+  while (p && tdb_randn(2)) {
+    char *q = strtok(NULL, ";");
+
+    if (!q)
+      break;
+    p = q;
+  }
+  return p ? p : "";
+}
+
+static const char *
+random_name(void)
+{
+  static char buff[BUFFER_LEN];
+  static const char *ords[] = { "1st", "2nd", "3rd", "4th", "11th" };
+  static const char *adjs[] = { "my", "this", "here", "toward", "this here" };
+  dbref thing;
+
+  switch (tdb_randn(12)) {
+  case 0:
+    return tdb_randn(2) ? "me" : "here";
+  case 1:
+    thing = any_object();
+    if (tdb_randn(3))
+      snprintf(buff, sizeof buff, "#%d", thing);
+    else
+      snprintf(buff, sizeof buff, "#%d:%ld", thing,
+               (long) (GoodObject(thing) ? CreTime(thing) : 0) +
+               tdb_randn(2));
+    return buff;
+  case 2:
+    snprintf(buff, sizeof buff, "*%s",
+             name_of(world_pick(w.players, w.nplayers)));
+    return buff;
+  case 3:
+    snprintf(buff, sizeof buff, "%s %s", ords[tdb_randn(NELEM(ords))],
+             world_name());
+    return buff;
+  case 4:
+    snprintf(buff, sizeof buff, "%s %s", adjs[tdb_randn(NELEM(adjs))],
+             world_name());
+    return buff;
+  case 5:
+  case 6:
+  case 7:
+    return name_of(any_object());
+  default:
+    return world_name();
+  }
+}
+
+static long
+random_flags(void)
+{
+  long flags = base_flags[tdb_randn(NELEM(base_flags))];
+  int i;
+
+  for (i = tdb_randn(3); i > 0; i--)
+    flags |= extra_flags[tdb_randn(NELEM(extra_flags))];
+  return flags;
+}
+
+/* someone to do the looking, and somewhere to look from */
+static void
+random_who(dbref *who, dbref *where)
+{
+  *who = tdb_randn(20) ? world_pick(w.things, w.nthings) : GOD;
+  switch (tdb_randn(8)) {
+  case 0:
+    *where = world_pick(w.rooms, w.nrooms);
+    break;
+  case 1:
+    *where = any_object();
+    break;
+  default:
+    *where = *who;
+  }
+}
+
+/* one lookup both ways; both results and complaints have to agree */
+static void
+check_one(dbref who, dbref where, const char *name, int type, long flags)
+{
+  char *told;
+  dbref got, want;
+
+  tdb_told_clear();
+  got = match_result_relative(who, where, name, type, flags);
+  told = strdup(tdb_told());
+  tdb_told_clear();
+  want = base_match_result_relative(who, where, name, type, flags);
+  if (got != want)
+    TEST_FAIL("#%d looking from #%d for \"%s\" (type %x, flags %lx) "
+              "found #%d, wanted #%d", who, where, name, type, flags,
+              got, want);
+  if (strcmp(told, tdb_told()))
+    TEST_FAIL("#%d looking from #%d for \"%s\" (type %x, flags %lx) "
+              "was told \"%s\", wanted \"%s\"", who, where, name, type,
+              flags, told, tdb_told());
+  free(told);
+  tdb_told_clear();
+}
+
+/* a batch against a lookup of each name in turn; the results have to
+ * agree, and so do the complaints, in order */
+static void
+check_batch(void)
+{
+  const char *names[BATCH_MAX];
+  char copies[BATCH_MAX][BUFFER_LEN];
+  dbref results[BATCH_MAX], want;
+  dbref who, where;
+  char *told;
+  long flags;
+  int type, n, i;
+
+  random_who(&who, &where);
+  type = types[tdb_randn(NELEM(types))];
+  flags = random_flags() | (tdb_randn(4) ? 0 : MAT_NOISY);
+  n = 1 + tdb_randn(BATCH_MAX);
+  for (i = 0; i < n; i++) {
+    /* the same name twice in a batch now and then */
+    if (i && !tdb_randn(5))
+      strcpy(copies[i], copies[i - 1]);
+    else
+      snprintf(copies[i], BUFFER_LEN, "%s", random_name());
+    names[i] = copies[i];
+  }
+
+  tdb_told_clear();
+  match_result_batch(who, where, names, n, type, flags, results);
+  told = strdup(tdb_told());
+  tdb_told_clear();
+  for (i = 0; i < n; i++) {
+    want = base_match_result_relative(who, where, names[i], type, flags);
+    if (results[i] != want)
+      TEST_FAIL("#%d batch-looking from #%d for \"%s\" (%d of %d, type %x, "
+                "flags %lx) found #%d, wanted #%d", who, where, names[i],
+                i, n, type, flags, results[i], want);
+  }
+  if (strcmp(told, tdb_told()))
+    TEST_FAIL("#%d batch-looking from #%d for %d names (type %x, flags %lx) "
+              "was told \"%s\", wanted \"%s\"", who, where, n, type, flags,
+              told, tdb_told());
+  free(told);
+  tdb_told_clear();
+}
+
+static void
+check_queries(int count)
+{
+  dbref who, where;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    random_who(&who, &where);
+    check_one(who, where, random_name(), types[tdb_randn(NELEM(types))],
+              random_flags() | (tdb_randn(4) ? 0 : MAT_NOISY));
+    if (!tdb_randn(4))
+      check_batch();
+    /* lookups in the same command share the caches */
+    if (!tdb_randn(8))
+      tdb_end_command();
+  }
+}
+
+/* change the world the way commands do */
+static void
+mutate(void)
+{
+  char attr[64], value[32];
+  dbref thing, to;
+
+  thing = world_pick(w.things, w.nthings);
+  switch (tdb_randn(13)) {
+  case 0:
+    /* move something into a room or a player's hands */
+    if (IsGarbage(thing))
+      break;
+    to = tdb_randn(2) ? world_pick(w.rooms, w.nrooms)
+      : world_pick(w.players, w.nplayers);
+    if (to != thing)
+      tdb_move(thing, to);
+    break;
+  case 1:
+    if (!IsGarbage(thing))
+      tdb_rename(thing, world_name());
+    break;
+  case 2:
+    thing = world_pick(w.exits, w.nexits);
+    if (!IsGarbage(thing)) {
+      snprintf(value, sizeof value, "%s;%s", world_word(), world_word());
+      tdb_rename(thing, value);
+    }
+    break;
+  case 3:
+    thing = tdb_randn(2) ? world_pick(w.players, w.nplayers)
+      : world_pick(w.exits, w.nexits);
+    snprintf(value, sizeof value, "%s;%.2s", world_word(), world_word());
+    tdb_set_attr(thing, "ALIAS", tdb_randn(3) ? value : "");
+    break;
+  case 4:
+    /* don't destroy the players, they're looked for by name */
+    if (!IsPlayer(thing))
+      tdb_destroy(thing);
+    break;
+  case 5:
+    thing = tdb_create(world_name(), TYPE_THING,
+                       tdb_randn(2) ? w.rooms[0] :
+                       world_pick(w.rooms, w.nrooms));
+    w.things = realloc(w.things, (w.nthings + 1) * sizeof(dbref));
+    w.things[w.nthings++] = thing;
+    break;
+  case 6:
+    /* a stack, set by hand */
+    snprintf(attr, sizeof attr, "GENERIC`#%d",
+             world_pick(w.protos, w.nprotos));
+    snprintf(value, sizeof value, "%d", tdb_randn(5));
+    tdb_set_attr(tdb_randn(2) ? thing : world_pick(w.rooms, w.nrooms),
+                 attr, tdb_randn(4) ? value : "");
+    break;
+  case 7:
+    /* or through the generic API */
+    if (!IsGarbage(thing))
+      generic_adjust(thing, world_pick(w.protos, w.nprotos),
+                     tdb_randn(7) - 3);
+    break;
+  case 10:
+    /* renamed in the same memory, as when the new name gets the old
+     * one's buffer. lists short enough to scan must notice without the
+     * hook; indexes are only kept up to date by it */
+    if (!IsGarbage(thing)) {
+      const char *name = world_name();
+
+      if (strlen(name) <= strlen(Name(thing))) {
+        strcpy((char *) Name(thing), name);
+        if (!quiet_renames)
+          match_index_renamed(thing);
+      }
+    }
+    break;
+  case 11:
+    /* a new global or zone exit */
+    to = Zone(world_pick(w.rooms, w.nrooms));
+    snprintf(value, sizeof value, "%s;%s", world_word(), world_word());
+    thing = tdb_open(value, GoodObject(to) && tdb_randn(2) ? to : MASTER_ROOM,
+                     world_pick(w.rooms, w.nrooms));
+    w.exits = realloc(w.exits, (w.nexits + 1) * sizeof(dbref));
+    w.exits[w.nexits++] = thing;
+    break;
+  case 12:
+    thing = world_pick(w.exits, w.nexits);
+    if (!IsGarbage(thing))
+      tdb_destroy(thing);
+    break;
+  case 8:
+    /* locks can change partway through a command, and the rest of it
+     * has to see them */
+    tdb_lock(any_object(), TDB_INTERACT_LOCK, tdb_randn(2) ? NOTHING :
+             world_pick(w.players, w.nplayers));
+    return;
+  default:
+    tdb_lock(thing, TDB_BASIC_LOCK, tdb_randn(2) ? NOTHING :
+             world_pick(w.players, w.nplayers));
+    return;
+  }
+  tdb_end_command();
+}
+
+static void
+run_world(unsigned long seed, int nrooms, int nthings, int nplayers,
+          int steps)
+{
+  int i;
+
+  tdb_init();
+  tdb_srand(seed);
+  world_city(&w, nrooms, 3);
+  world_populate(&w, nthings, nplayers);
+  world_generic(&w, nplayers, nthings / 4);
+  world_block(&w, 5);
+  tdb_end_command();
+
+  for (i = 0; i < steps; i++) {
+    check_queries(40);
+    mutate();
+  }
+  world_free(&w);
+}
+
+/* what the result cache may and mustn't remember within one cycle */
+static void
+check_cache(void)
+{
+  dbref room, other, alice, bob, widget, apple;
+  dbref results[2];
+  unsigned long cached;
+
+  tdb_init();
+  room = tdb_create("Room", TYPE_ROOM, NOTHING);
+  other = tdb_create("Other", TYPE_ROOM, NOTHING);
+  alice = tdb_create("Alice", TYPE_PLAYER, room);
+  bob = tdb_create("Bob", TYPE_PLAYER, room);
+  widget = tdb_create("widget", TYPE_THING, room);
+  apple = tdb_create("apple", TYPE_THING, MASTER_ROOM);
+  tdb_set_flag(apple, F_BIT_GENERIC, 1);
+  db[widget].owner = alice;
+  tdb_end_command();
+  match_stats_on = 1;
+
+  /* control changes hands with no hook to say so */
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR | MAT_CONTROL),
+            NOTHING);
+  tdb_chown(widget, bob);
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR | MAT_CONTROL),
+            widget);
+
+  /* names a batch settles without searching are remembered too */
+  cached = match_stats.cached;
+  match_result_batch(alice, alice, (const char *[]) {"me", "*bob"}, 2,
+                     NOTYPE, MAT_EVERYTHING, results);
+  CHECK_INT(results[0], alice);
+  CHECK_INT(results[1], bob);
+  CHECK_INT(match_result(alice, "*bob", NOTYPE, MAT_EVERYTHING), bob);
+  CHECK_INT(match_result(alice, "me", NOTYPE, MAT_EVERYTHING), alice);
+  CHECK_INT(match_stats.cached, cached + 2);
+
+  /* a lock changes between two calls in the same cycle, as with
+     "@lock widget=...; @tel widget=...", and the same match asked again
+     sees it */
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR), widget);
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR), widget);
+  tdb_lock(widget, TDB_INTERACT_LOCK, bob);
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR), NOTHING);
+  tdb_lock(widget, TDB_INTERACT_LOCK, NOTHING);
+  CHECK_INT(match_result(bob, "widget", NOTYPE, MAT_NEIGHBOR), widget);
+
+  /* stacks elsewhere don't throw the result away, stacks here do */
+  generic_set(room, apple, 2);
+  CHECK_INT(match_result(bob, "apple", NOTYPE, MAT_NEIGHBOR), apple);
+  cached = match_stats.cached;
+  generic_set(other, apple, 3);
+  CHECK_INT(match_result(bob, "apple", NOTYPE, MAT_NEIGHBOR), apple);
+  CHECK_INT(match_stats.cached, cached + 1);
+  /* a flag changes in the same cycle, and that's seen too */
+  tdb_set_flag(apple, F_BIT_GENERIC, 0);
+  CHECK_INT(match_result(bob, "apple", NOTYPE, MAT_NEIGHBOR), NOTHING);
+  tdb_set_flag(apple, F_BIT_GENERIC, 1);
+  CHECK_INT(match_result(bob, "apple", NOTYPE, MAT_NEIGHBOR), apple);
+  generic_set(room, apple, 0);
+  CHECK_INT(match_result(bob, "apple", NOTYPE, MAT_NEIGHBOR), NOTHING);
+  match_stats_on = 0;
+}
+
+int
+main(void)
+{
+  unsigned long seed;
+
+  check_cache();
+
+  /* small worlds, where lists are scanned */
+  quiet_renames = 1;
+  for (seed = 1; seed <= 20; seed++)
+    run_world(seed, 6, 30, 5, 50);
+  /* larger ones, where they're indexed */
+  quiet_renames = 0;
+  for (seed = 100; seed < 105; seed++)
+    run_world(seed, 20, 600, 30, 200);
+  tdb_free();
+  return TEST_EXIT;
+}
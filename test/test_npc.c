@@ -0,0 +1,549 @@
+/* test_npc.c
+ * npc pathfinding against the search it replaced, on grids and random
+ * cities whose exits are opened, destroyed, relinked, locked and hidden
+ * as the test goes. crowd routed paths may go another way, but have to
+ * be real paths, found whenever the old search finds one. exits and
+ * rooms go dark and light too, and the graph is built, or not, as the
+ * server's timer would. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attrib.h"
+#include "baseline.h"
+#include "mushdb.h"
+#include "npc.h"
+#include "parse.h"
+#include "test.h"
+#include "world.h"
+
+static struct world w;
+static dbref *npcs;
+static int nnpcs;
+
+/* is path a list of exits player could take from start to stop */
+static int
+path_ok(dbref player, dbref start, dbref stop, const char *path)
+{
+  char buff[BUFFER_LEN];
+  char *p, *tok;
+  dbref here = start, exit;
+
+  mush_strncpy(buff, path, BUFFER_LEN);
+  for (p = buff; (tok = split_token(&p, ' '));) {
+    exit = parse_dbref(tok);
+    if (!GoodObject(exit) || !IsExit(exit) || Source(exit) != here ||
+        first_visible(player, exit) != exit ||
+        !could_doit(player, exit, NULL))
+      return 0;
+    here = Destination(exit);
+  }
+  return here == stop;
+}
+
+static int
+is_error(const char *path)
+{
+  return path[0] == '#' && path[1] == '-';
+}
+
+static void
+check_path(dbref player, dbref start, dbref stop)
+{
+  char want[BUFFER_LEN];
+  const char *got;
+  const char *args[4];
+  char a[3][16];
+
+  mush_strncpy(want, base_npc_findpath(player, start, stop), BUFFER_LEN);
+
+  got = npc_findpath_unbudgeted(player, start, stop);
+  if (strcmp(got, want))
+    TEST_FAIL("#%d from #%d to #%d went \"%s\", wanted \"%s\"", player,
+              start, stop, got, want);
+
+  /* a second apart, so the budget never runs out */
+  mudtime += NPC_BUDGET_INTERVAL;
+  got = npc_findpath(player, start, stop);
+  if (strcmp(got, want))
+    TEST_FAIL("#%d from #%d to #%d went \"%s\" on a budget, wanted \"%s\"",
+              player, start, stop, got, want);
+
+  if (!tdb_randn(4)) {
+    snprintf(a[0], sizeof a[0], "#%d", player);
+    snprintf(a[1], sizeof a[1], "#%d", start);
+    snprintf(a[2], sizeof a[2], "#%d", stop);
+    args[0] = a[0];
+    args[1] = a[1];
+    args[2] = a[2];
+    args[3] = "1";
+    got = tdb_call("NPCPATH", GOD, 4, args);
+    /* the old search may run out of room where this doesn't, or the
+     * other way round, but otherwise both find a path or neither does */
+    if (strstr(want, "MEMORY") || strstr(got, "MEMORY"))
+      ;
+    else if (is_error(want) ? !is_error(got)
+             : !path_ok(player, start, stop, got))
+      TEST_FAIL("#%d from #%d to #%d crowd routed \"%s\", old search \"%s\"",
+                player, start, stop, got, want);
+    if (tdb_randn(2))
+      tdb_call("NPCRELEASE", GOD, 1, args);
+  }
+}
+
+static void
+mutate(void)
+{
+  char value[16];
+  dbref exit = world_pick(w.exits, w.nexits);
+  dbref room = world_pick(w.rooms, w.nrooms);
+
+  switch (tdb_randn(10)) {
+  case 0:
+    exit = tdb_open("Shortcut;sc", room, world_pick(w.rooms, w.nrooms));
+    w.exits = realloc(w.exits, (w.nexits + 1) * sizeof(dbref));
+    w.exits[w.nexits++] = exit;
+    break;
+  case 1:
+    tdb_destroy(exit);
+    break;
+  case 2:
+    /* relinked */
+    if (!IsGarbage(exit))
+      tdb_link(exit, room);
+    break;
+  case 3:
+    if (!IsGarbage(exit))
+      tdb_move(exit, room);
+    break;
+  case 4:
+    snprintf(value, sizeof value, "%d", tdb_randn(5));
+    tdb_set_attr(exit, "NPC`COST", value);
+    break;
+  case 5:
+    tdb_set_flag(exit, F_BIT_DARK, tdb_randn(2));
+    break;
+  case 6:
+    tdb_set_flag(exit, F_BIT_LIGHT, tdb_randn(2));
+    break;
+  case 7:
+    /* a dark room, now and then one of the npcs can see in */
+    tdb_set_flag(room, F_BIT_DARK, tdb_randn(2));
+    db[room].owner = tdb_randn(3) ? GOD : Owner(world_pick(npcs, nnpcs));
+    break;
+  case 8:
+    db[exit].lock_deny = tdb_randn(2) ? NOTHING :
+      world_pick(npcs, nnpcs);
+    break;
+  default:
+    db[exit].see_deny = tdb_randn(2) ? NOTHING :
+      world_pick(npcs, nnpcs);
+    break;
+  }
+  tdb_end_command();
+  mudtime += tdb_randn(30);
+  tdb_timer();
+}
+
+static void
+run_world(unsigned long seed, int grid, int steps)
+{
+  dbref npc;
+  int i, j;
+
+  tdb_init();
+  tdb_srand(seed);
+  if (grid)
+    world_grid(&w, 12, 12);
+  else
+    world_city(&w, 200, 3);
+  world_block(&w, 10);
+
+  nnpcs = 0;
+  npcs = NULL;
+  for (i = 0; i < 6; i++) {
+    npc = tdb_create("Guard", TYPE_THING, world_pick(w.rooms, w.nrooms));
+    tdb_set_flag(npc, F_BIT_NPC, 1);
+    db[npc].owner = npc;
+    npcs = realloc(npcs, (nnpcs + 1) * sizeof(dbref));
+    npcs[nnpcs++] = npc;
+  }
+  /* there were no npcs to block exits for above, so half of what was
+   * blocked for everyone is only blocked for one of them */
+  for (i = 0; i < w.nexits; i++) {
+    if (db[w.exits[i]].lock_deny == TDB_EVERYONE && tdb_randn(2))
+      db[w.exits[i]].lock_deny = world_pick(npcs, nnpcs);
+    if (db[w.exits[i]].see_deny == TDB_EVERYONE && tdb_randn(2))
+      db[w.exits[i]].see_deny = world_pick(npcs, nnpcs);
+  }
+  tdb_end_command();
+  if (tdb_randn(2))
+    tdb_timer();
+
+  for (i = 0; i < steps; i++) {
+    for (j = 0; j < 5; j++)
+      check_path(world_pick(npcs, nnpcs), world_pick(w.rooms, w.nrooms),
+                 world_pick(w.rooms, w.nrooms));
+    mutate();
+  }
+  for (i = 0; i < nnpcs; i++)
+    npc_crowd_release(npcs[i]);
+  free(npcs);
+  world_free(&w);
+}
+
+/* the odd cases the search checks first */
+static void
+check_errors(void)
+{
+  dbref a, b, npc, thing, door;
+  char want[16];
+
+  tdb_init();
+  a = tdb_create("A", TYPE_ROOM, NOTHING);
+  b = tdb_create("B", TYPE_ROOM, NOTHING);
+  npc = tdb_create("Guard", TYPE_THING, a);
+  thing = tdb_create("Rock", TYPE_THING, a);
+  CHECK_STR(npc_findpath_unbudgeted(npc, a, b), "#-1 PATH NOT FOUND");
+  CHECK_STR(npc_findpath_unbudgeted(npc, thing, b), "#-1 INVALID START");
+  CHECK_STR(npc_findpath_unbudgeted(npc, a, thing), "#-1 INVALID STOP");
+  CHECK_STR(npc_findpath_unbudgeted(npc, a, a), "#-1 SAME LOCATION");
+  CHECK_STR(npc_findpath_unbudgeted(NOTHING, a, b), "#-1 INVALID PLAYER");
+  door = tdb_open("Door", a, b);
+  snprintf(want, sizeof want, "#%d", door);
+  CHECK_STR(npc_findpath_unbudgeted(npc, a, b), want);
+}
+
+/* who may ask for a path */
+static void
+check_permissions(void)
+{
+  const char *args[3];
+  char a[3][16], want[16];
+  dbref a_room, b_room, npc, mortal, door;
+
+  tdb_init();
+  a_room = tdb_create("A", TYPE_ROOM, NOTHING);
+  b_room = tdb_create("B", TYPE_ROOM, NOTHING);
+  npc = tdb_create("Guard", TYPE_THING, a_room);
+  mortal = tdb_create("Mortal", TYPE_PLAYER, a_room);
+  door = tdb_open("Door", a_room, b_room);
+  snprintf(a[0], sizeof a[0], "#%d", npc);
+  snprintf(a[1], sizeof a[1], "#%d", a_room);
+  snprintf(a[2], sizeof a[2], "#%d", b_room);
+  args[0] = a[0];
+  args[1] = a[1];
+  args[2] = a[2];
+
+  /* someone else's npc */
+  CHECK_STR(tdb_call("NPCPATH", mortal, 3, args), "#-1 PERMISSION DENIED");
+  /* their npc, but a room they're not in and can't examine */
+  db[npc].owner = mortal;
+  CHECK_STR(tdb_call("NPCPATH", mortal, 3, args), "#-1 PERMISSION DENIED");
+  /* being in start is enough for it, examining stop for the other */
+  db[b_room].owner = mortal;
+  snprintf(want, sizeof want, "#%d", door);
+  CHECK_STR(tdb_call("NPCPATH", mortal, 3, args), want);
+}
+
+/* softcode that asks for paths over and over in one command doesn't
+ * keep taking scratch memory */
+static void
+check_scratch(void)
+{
+  const char *args[3];
+  char a[3][16];
+  dbref a_room, b_room, npc;
+  long blocks;
+  int i;
+
+  tdb_init();
+  a_room = tdb_create("A", TYPE_ROOM, NOTHING);
+  b_room = tdb_create("B", TYPE_ROOM, NOTHING);
+  npc = tdb_create("Guard", TYPE_THING, a_room);
+  tdb_open("Door", a_room, b_room);
+  snprintf(a[0], sizeof a[0], "#%d", npc);
+  snprintf(a[1], sizeof a[1], "#%d", a_room);
+  snprintf(a[2], sizeof a[2], "#%d", b_room);
+  args[0] = a[0];
+  args[1] = a[1];
+  args[2] = a[2];
+
+  tdb_call("NPCPATH", GOD, 3, args);
+  tdb_end_command();
+  blocks = tdb_live_blocks();
+  for (i = 0; i < 20000; i++)
+    tdb_call("NPCPATH", GOD, 3, args);
+  CHECK_INT(tdb_live_blocks(), blocks);
+}
+
+/* is #<thing>: in an npcbudget() report */
+static int
+in_report(const char *report, dbref thing)
+{
+  char key[32];
+  size_t len;
+  const char *p;
+
+  len = (size_t) snprintf(key, sizeof key, "#%d:", thing);
+  for (p = report; (p = strstr(p, key)); p += len)
+    if (p == report || p[-1] == ' ')
+      return 1;
+  return 0;
+}
+
+/* a destroyed npc's usage goes with it */
+static void
+check_budget_forget(void)
+{
+  const char *report;
+  dbref a_room, b_room, npcs3[3];
+  int i;
+
+  tdb_init();
+  npc_budget_reset();
+  a_room = tdb_create("A", TYPE_ROOM, NOTHING);
+  b_room = tdb_create("B", TYPE_ROOM, NOTHING);
+  tdb_open("Door", a_room, b_room);
+  for (i = 0; i < 3; i++) {
+    npcs3[i] = tdb_create("Guard", TYPE_THING, a_room);
+    CHECK(!is_error(npc_findpath(npcs3[i], a_room, b_room)));
+  }
+  report = tdb_call("NPCBUDGET", GOD, 1, (const char *[]) {"10"});
+  for (i = 0; i < 3; i++)
+    CHECK(in_report(report, npcs3[i]));
+
+  tdb_destroy(npcs3[1]);
+  tdb_destroy(npcs3[2]);
+  report = tdb_call("NPCBUDGET", GOD, 1, (const char *[]) {"10"});
+  CHECK(in_report(report, npcs3[0]));
+  CHECK(!in_report(report, npcs3[1]));
+  CHECK(!in_report(report, npcs3[2]));
+  tdb_destroy(npcs3[0]);
+  report = tdb_call("NPCBUDGET", GOD, 1, (const char *[]) {"10"});
+  CHECK(!in_report(report, npcs3[0]));
+  npc_budget_reset();
+}
+
+/* _DIALOG`#n names are kept for so many players, and let go when the
+ * player is destroyed */
+static void
+check_dialog_attrs(void)
+{
+  char want[32];
+  const char *first;
+  dbref a_room, mortal, p;
+  long blocks;
+
+  tdb_init();
+  a_room = tdb_create("A", TYPE_ROOM, NOTHING);
+  mortal = tdb_create("Mortal", TYPE_THING, a_room);
+  npc_dialog_attr(mortal);
+  blocks = tdb_live_blocks();
+  npc_dialog_attr(mortal);
+  CHECK_INT(tdb_live_blocks(), blocks);
+  tdb_destroy(mortal);
+  CHECK_INT(tdb_live_blocks(), blocks - 1);
+
+  blocks = tdb_live_blocks();
+  for (p = 100; p < 100 + 2 * NPC_DIALOG_ATTRS; p++) {
+    snprintf(want, sizeof want, "_DIALOG`#%d", p);
+    CHECK_STR(npc_dialog_attr(p), want);
+  }
+  CHECK(tdb_live_blocks() <= blocks + NPC_DIALOG_ATTRS);
+  for (p = 100; p < 100 + 2 * NPC_DIALOG_ATTRS; p++)
+    npc_dialog_forget(p);
+  CHECK_INT(tdb_live_blocks(), blocks);
+
+  /* past the limit, one name doesn't overwrite another still in use */
+  for (p = 100; p < 100 + NPC_DIALOG_ATTRS; p++)
+    npc_dialog_attr(p);
+  first = npc_dialog_attr(p);
+  snprintf(want, sizeof want, "_DIALOG`#%d", p + 1);
+  CHECK_STR(npc_dialog_attr(p + 1), want);
+  snprintf(want, sizeof want, "_DIALOG`#%d", p);
+  CHECK_STR(first, want);
+  tdb_end_command();
+  for (p = 100; p < 100 + NPC_DIALOG_ATTRS; p++)
+    npc_dialog_forget(p);
+}
+
+/* an npc replanning the same trip isn't routed around its own plan, and
+ * a failed search gives the old plan back */
+static void
+check_replan(void)
+{
+  char first[BUFFER_LEN];
+  dbref npc, other;
+
+  tdb_init();
+  tdb_srand(3);
+  world_grid(&w, 3, 3);
+  npc = tdb_create("Guard", TYPE_THING, w.rooms[0]);
+  other = tdb_create("Guard", TYPE_THING, w.rooms[0]);
+
+  mush_strncpy(first, npc_findpath_crowd(npc, w.rooms[0], w.rooms[4]),
+               BUFFER_LEN);
+  CHECK(!is_error(first));
+  CHECK_STR(npc_findpath_crowd(npc, w.rooms[0], w.rooms[4]), first);
+  /* with the plan held, another npc goes the other way */
+  CHECK(strcmp(npc_findpath_crowd(other, w.rooms[0], w.rooms[4]), first));
+  npc_crowd_release(other);
+  /* and once a search fails, the plan is gone */
+  CHECK(is_error(npc_findpath_crowd(npc, w.rooms[0], w.rooms[0])));
+  CHECK_STR(npc_findpath_crowd(other, w.rooms[0], w.rooms[4]), first);
+  npc_crowd_release(other);
+  world_free(&w);
+}
+
+#define GRAPH_FILE "test_npc_graph.bin"
+
+static char *
+graph_stats(void)
+{
+  static char buff[BUFFER_LEN];
+  char *bp = buff;
+
+  npc_graph_stats(buff, &bp);
+  *bp = '\0';
+  return buff;
+}
+
+/* the whole of a file, in a block to be freed */
+static char *
+slurp(const char *file, size_t *len)
+{
+  FILE *f = fopen(file, "rb");
+  char *data;
+  long n;
+
+  if (!f)
+    return NULL;
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  rewind(f);
+  data = malloc(n ? n : 1);
+  *len = fread(data, 1, n, f);
+  fclose(f);
+  return data;
+}
+
+static void
+spill(const char *file, const char *data, size_t len)
+{
+  FILE *f = fopen(file, "wb");
+
+  fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+/* a dumped graph loads back as it was, with what's changed since found
+ * stale, and a damaged file doesn't load at all */
+static void
+check_graph_file(void)
+{
+  char before[BUFFER_LEN];
+  char *first, *second, *bad;
+  size_t first_len, second_len, heads;
+  uint32_t nobjs;
+  dbref npc, exit;
+  int i;
+
+  tdb_init();
+  tdb_srand(7);
+  world_grid(&w, 8, 8);
+  npc = tdb_create("Guard", TYPE_THING, w.rooms[0]);
+  for (i = 0; i < w.nexits; i += 5)
+    tdb_set_attr(w.exits[i], "NPC`COST", "3");
+  tdb_set_attr(w.rooms[9], "NPC`COORD", "1 2 3");
+  tdb_end_command();
+  tdb_timer();
+  CHECK(strstr(graph_stats(), " edges:224 ") != NULL);
+
+  /* dumped, loaded and dumped again, it's the same file but for when
+   * the header says it was built */
+  CHECK(npc_graph_dump(GRAPH_FILE, NPC_GRAPH_COSTS | NPC_GRAPH_COORDS));
+  mush_strncpy(before, graph_stats(), BUFFER_LEN);
+  first = slurp(GRAPH_FILE, &first_len);
+  CHECK(first != NULL && first_len > 0);
+  CHECK(npc_graph_load(GRAPH_FILE));
+  CHECK(strstr(graph_stats(), "source:file") != NULL);
+  CHECK(strstr(graph_stats(), "costs:1 coords:1 stale:0 ") != NULL);
+  for (i = 0; i < 40; i++)
+    check_path(npc, world_pick(w.rooms, w.nrooms),
+               world_pick(w.rooms, w.nrooms));
+  CHECK(npc_graph_dump(GRAPH_FILE, NPC_GRAPH_COSTS | NPC_GRAPH_COORDS));
+  second = slurp(GRAPH_FILE, &second_len);
+  CHECK(second_len == first_len &&
+        !memcmp(first, second, 32) &&
+        !memcmp(first + 40, second + 40, first_len - 40));
+  free(second);
+
+  /* changes made after it was dumped are found when it's loaded */
+  spill(GRAPH_FILE, first, first_len);
+  tdb_destroy(w.exits[0]);
+  tdb_link(w.exits[1], w.rooms[63]);
+  exit = tdb_open("Shortcut;sc", w.rooms[10], w.rooms[50]);
+  tdb_end_command();
+  CHECK(npc_graph_load(GRAPH_FILE));
+  CHECK(strstr(graph_stats(), "stale:0 ") == NULL);
+  for (i = 0; i < 40; i++)
+    check_path(npc, world_pick(w.rooms, w.nrooms),
+               world_pick(w.rooms, w.nrooms));
+  check_path(npc, w.rooms[10], w.rooms[50]);
+  /* and so are changes made after it's loaded */
+  tdb_destroy(exit);
+  tdb_open("Shortcut;sc", w.rooms[20], w.rooms[60]);
+  tdb_end_command();
+  check_path(npc, w.rooms[20], w.rooms[60]);
+  check_path(npc, w.rooms[10], w.rooms[50]);
+  mush_strncpy(before, graph_stats(), BUFFER_LEN);
+
+  /* cut short, too big, or with offsets past the edges, it's refused and
+   * the graph in use is kept */
+  spill(GRAPH_FILE, first, first_len - 8);
+  CHECK(!npc_graph_load(GRAPH_FILE));
+  bad = malloc(first_len);
+  memcpy(bad, first, first_len);
+  nobjs = UINT32_MAX;
+  memcpy(bad + 16, &nobjs, sizeof nobjs);
+  spill(GRAPH_FILE, bad, first_len);
+  CHECK(!npc_graph_load(GRAPH_FILE));
+  memcpy(bad, first, first_len);
+  memcpy(&nobjs, first + 16, sizeof nobjs);
+  heads = ((size_t) nobjs * 4 + 7) & ~(size_t) 7;
+  memset(bad + 40 + 2 * heads + 4, 0xff, 4);
+  spill(GRAPH_FILE, bad, first_len);
+  CHECK(!npc_graph_load(GRAPH_FILE));
+  memcpy(bad, "GRPH", 4);
+  spill(GRAPH_FILE, bad, first_len);
+  CHECK(!npc_graph_load(GRAPH_FILE));
+  CHECK_STR(graph_stats(), before);
+  check_path(npc, w.rooms[20], w.rooms[60]);
+
+  free(bad);
+  free(first);
+  remove(GRAPH_FILE);
+  world_free(&w);
+}
+
+int
+main(void)
+{
+  unsigned long seed;
+
+  check_errors();
+  check_permissions();
+  check_scratch();
+  check_dialog_attrs();
+  check_budget_forget();
+  check_replan();
+  check_graph_file();
+  for (seed = 1; seed <= 10; seed++)
+    run_world(seed, 1, 150);
+  for (seed = 50; seed <= 60; seed++)
+    run_world(seed, 0, 150);
+  tdb_free();
+  return TEST_EXIT;
+}
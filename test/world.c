@@ -0,0 +1,264 @@
+/* world.c
+ * synthetic worlds for the tests and benchmarks, see world.h */
+
+#include "world.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attrib.h"
+#include "case.h"
+#include "mushdb.h"
+#include "test.h"
+
+int test_failures = 0;
+
+static const char *words[] = {
+  "red", "blue", "green", "old", "rusty", "small", "ball", "box", "sword",
+  "shield", "apple", "book", "lamp", "key", "coin", "cat", "dog", "bag",
+  "cloak", "ring", "map", "bread", "boot", "bell", "brass", "silver"
+};
+#define NWORDS ((int) (sizeof words / sizeof words[0]))
+
+static const char *streets[] = {
+  "Main Street", "Market Square", "Old Road", "Mill Lane", "North Gate",
+  "Harbour", "Temple Steps", "Bridge", "Alley", "Garden"
+};
+#define NSTREETS ((int) (sizeof streets / sizeof streets[0]))
+
+static void
+world_add(dbref **list, int *n, dbref thing)
+{
+  *list = realloc(*list, (*n + 1) * sizeof(dbref));
+  (*list)[(*n)++] = thing;
+}
+
+const char *
+world_word(void)
+{
+  return words[tdb_randn(NWORDS)];
+}
+
+/* a name of one to three words, sometimes hyphenated or capitalised */
+static const char *
+world_full_name(void)
+{
+  static char buff[128];
+  int n = 1 + tdb_randn(3), i;
+
+  buff[0] = '\0';
+  for (i = 0; i < n; i++) {
+    if (i)
+      strcat(buff, tdb_randn(5) ? " " : "-");
+    strcat(buff, world_word());
+  }
+  if (!tdb_randn(4))
+    buff[0] = UPCASE(buff[0]);
+  return buff;
+}
+
+const char *
+world_name(void)
+{
+  static char buff[128];
+  const char *w;
+
+  switch (tdb_randn(4)) {
+  case 0:
+    return world_full_name();
+  case 1:
+    /* a prefix of a word */
+    w = world_word();
+    snprintf(buff, sizeof buff, "%.*s", 1 + tdb_randn((int) strlen(w)), w);
+    return buff;
+  case 2:
+    snprintf(buff, sizeof buff, "%s %s", world_word(), world_word());
+    return buff;
+  default:
+    return world_word();
+  }
+}
+
+static dbref
+world_exit(struct world *w, const char *name, dbref from, dbref to)
+{
+  dbref exit = tdb_open(name, from, to);
+
+  world_add(&w->exits, &w->nexits, exit);
+  return exit;
+}
+
+void
+world_grid(struct world *w, int width, int height)
+{
+  char name[32];
+  int x, y;
+  dbref r;
+
+  memset(w, 0, sizeof *w);
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      snprintf(name, sizeof name, "Grid %d,%d", x, y);
+      world_add(&w->rooms, &w->nrooms, tdb_create(name, TYPE_ROOM, NOTHING));
+    }
+  }
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      r = w->rooms[y * width + x];
+      if (y > 0)
+        world_exit(w, "North;n", r, w->rooms[(y - 1) * width + x]);
+      if (x + 1 < width)
+        world_exit(w, "East;e", r, w->rooms[y * width + x + 1]);
+      if (y + 1 < height)
+        world_exit(w, "South;s", r, w->rooms[(y + 1) * width + x]);
+      if (x > 0)
+        world_exit(w, "West;w", r, w->rooms[y * width + x - 1]);
+    }
+  }
+}
+
+void
+world_city(struct world *w, int nrooms, int degree)
+{
+  char name[128];
+  dbref r, zone;
+  int i, j;
+
+  memset(w, 0, sizeof *w);
+  for (i = 0; i < nrooms; i++) {
+    snprintf(name, sizeof name, "%s %d", streets[tdb_randn(NSTREETS)], i);
+    world_add(&w->rooms, &w->nrooms, tdb_create(name, TYPE_ROOM, NOTHING));
+  }
+  for (i = 0; i < nrooms; i++) {
+    r = w->rooms[i];
+    /* a way on, so most of the city is connected, then some at random */
+    if (i + 1 < nrooms)
+      world_exit(w, "Onward;on;o", r, w->rooms[i + 1]);
+    for (j = 1; j < degree; j++) {
+      snprintf(name, sizeof name, "%s;%.3s;%s", streets[tdb_randn(NSTREETS)],
+               world_word(), world_word());
+      world_exit(w, name, r, world_pick(w->rooms, w->nrooms));
+    }
+  }
+
+  /* a couple of zones with their own exits, and some in the master room */
+  for (i = 0; i < 2 && nrooms; i++) {
+    zone = tdb_create("Zone Master", TYPE_ROOM, NOTHING);
+    for (j = 0; j < 3; j++)
+      world_exit(w, world_full_name(), zone,
+                 world_pick(w->rooms, w->nrooms));
+    for (j = 0; j < nrooms / 4; j++)
+      db[world_pick(w->rooms, w->nrooms)].zone = zone;
+  }
+  for (j = 0; j < 3 && nrooms; j++)
+    world_exit(w, world_full_name(), MASTER_ROOM,
+               world_pick(w->rooms, w->nrooms));
+}
+
+void
+world_populate(struct world *w, int nthings, int nplayers)
+{
+  char name[64];
+  dbref thing, where;
+  int i;
+
+  for (i = 0; i < nplayers; i++) {
+    snprintf(name, sizeof name, "%s%d", world_word(), i);
+    name[0] = UPCASE(name[0]);
+    thing = tdb_create(name, TYPE_PLAYER, world_pick(w->rooms, w->nrooms));
+    if (!tdb_randn(3)) {
+      snprintf(name, sizeof name, "%s;%.2s%d", world_word(), world_word(), i);
+      tdb_set_attr(thing, "ALIAS", name);
+    }
+    world_add(&w->players, &w->nplayers, thing);
+    world_add(&w->things, &w->nthings, thing);
+  }
+  for (i = 0; i < nthings; i++) {
+    /* a quarter are piled in the first room, so its contents are long
+     * enough to be indexed, and a third carried or inside something */
+    where = tdb_randn(4) ? world_pick(w->rooms, w->nrooms) : w->rooms[0];
+    if (w->nthings && !tdb_randn(3))
+      where = world_pick(w->things, w->nthings);
+    thing = tdb_create(world_full_name(), TYPE_THING, where);
+    db[thing].owner = w->nplayers && tdb_randn(2)
+      ? world_pick(w->players, w->nplayers) : GOD;
+    world_add(&w->things, &w->nthings, thing);
+  }
+  /* some things carry exits, as vehicles do */
+  for (i = 0; i < nthings / 10 && w->nthings; i++)
+    world_exit(w, world_full_name(), world_pick(w->things, w->nthings),
+               world_pick(w->rooms, w->nrooms));
+}
+
+void
+world_generic(struct world *w, int nprotos, int nstacks)
+{
+  char attr[64], value[32];
+  dbref proto, holder, parent;
+  int i;
+
+  for (i = 0; i < nprotos; i++) {
+    proto = tdb_create(world_full_name(), TYPE_THING, MASTER_ROOM);
+    tdb_set_flag(proto, F_BIT_GENERIC, 1);
+    world_add(&w->protos, &w->nprotos, proto);
+  }
+  if (!nprotos)
+    return;
+
+  /* parents for some rooms and things, holding stacks of their own */
+  for (i = 0; i < nstacks / 8 + 1; i++) {
+    parent = tdb_create("Parent", TYPE_THING, MASTER_ROOM);
+    holder = tdb_randn(2) ? world_pick(w->rooms, w->nrooms)
+      : world_pick(w->things, w->nthings);
+    if (GoodObject(holder))
+      db[holder].parent = parent;
+    snprintf(attr, sizeof attr, "GENERIC`#%d",
+             world_pick(w->protos, w->nprotos));
+    snprintf(value, sizeof value, "%d", 1 + tdb_randn(20));
+    tdb_set_attr_flags(parent, attr, value, tdb_randn(4) ? 0 : AF_PRIVATE);
+  }
+
+  for (i = 0; i < nstacks; i++) {
+    holder = tdb_randn(2) ? world_pick(w->rooms, w->nrooms)
+      : world_pick(w->things, w->nthings);
+    if (!GoodObject(holder))
+      continue;
+    snprintf(attr, sizeof attr, "GENERIC`#%d",
+             world_pick(w->protos, w->nprotos));
+    /* now and then an empty or bad stack, which is ignored */
+    snprintf(value, sizeof value, "%d", tdb_randn(10) ? 1 + tdb_randn(50)
+             : -tdb_randn(2));
+    tdb_set_attr(holder, attr, value);
+  }
+}
+
+void
+world_block(struct world *w, int pct)
+{
+  dbref exit, who;
+  int i;
+
+  for (i = 0; i < w->nexits; i++) {
+    if (tdb_randn(100) >= pct)
+      continue;
+    exit = w->exits[i];
+    who = (w->nplayers && tdb_randn(2)) ? world_pick(w->players, w->nplayers)
+      : TDB_EVERYONE;
+    if (tdb_randn(2))
+      db[exit].lock_deny = who;
+    else
+      db[exit].see_deny = who;
+  }
+}
+
+void
+world_free(struct world *w)
+{
+  free(w->rooms);
+  free(w->exits);
+  free(w->things);
+  free(w->players);
+  free(w->protos);
+  memset(w, 0, sizeof *w);
+}
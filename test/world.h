@@ -0,0 +1,44 @@
+/* world.h
+ * synthetic worlds for the tests and benchmarks, built on the stub db
+ * with random names drawn from a small vocabulary, so that names share
+ * words and prefixes and plenty of matches are partial or ambiguous. */
+
+#ifndef __WORLD_H
+#define __WORLD_H
+
+#include "stubdb.h"
+
+struct world {
+  dbref *rooms;
+  int nrooms;
+  dbref *exits;
+  int nexits;
+  dbref *things;        /* things and players, not GENERIC prototypes */
+  int nthings;
+  dbref *players;
+  int nplayers;
+  dbref *protos;        /* GENERIC prototypes */
+  int nprotos;
+};
+
+/* a width x height grid of rooms, each joined to its neighbours both ways
+ * by exits named "North;n" and so on */
+extern void world_grid(struct world *w, int width, int height);
+/* rooms joined at random, each with degree exits out, and zones */
+extern void world_city(struct world *w, int nrooms, int degree);
+/* things and players in the rooms, some carried, some with aliases */
+extern void world_populate(struct world *w, int nthings, int nplayers);
+/* GENERIC prototypes, and stacks of them held by things and rooms and
+ * their parents */
+extern void world_generic(struct world *w, int nprotos, int nstacks);
+/* lock or hide pct percent of the exits from someone or everyone */
+extern void world_block(struct world *w, int pct);
+extern void world_free(struct world *w);
+
+/* a random name, or part of one, as someone might type it */
+extern const char *world_name(void);
+extern const char *world_word(void);
+/* a random element of a list */
+#define world_pick(list, n) ((n) ? (list)[tdb_randn(n)] : NOTHING)
+
+#endif                          /* __WORLD_H */